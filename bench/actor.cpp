@@ -0,0 +1,75 @@
+#include "complex_state_chart.h"
+
+#include "sctl_actor.h"
+
+#include <thread>
+
+/*
+ Throughput of ActorSystem by number of workers. Every actor is complex chart
+ from complex_state_chart.h, Hop event walks it through its cycle of events
+ and is passed on to next actor, so actors of all shards talk to each other.
+*/
+
+using namespace bench;
+
+namespace {
+
+struct Hop {
+  unsigned remaining;
+};
+
+struct Device;
+using System = sctl::ActorSystem<Device, 64, Hop>;
+
+constexpr System::Id actors = 4096;
+// Chains of hops run at once, one per stride actors, so mailbox never fills.
+constexpr System::Id stride = 64;
+constexpr unsigned hops = 4096;
+
+struct Device : ComplexChart {
+  System *system;
+  System::Id next;
+  unsigned step{0};
+
+  Device(System &s, System::Id n) : system{&s}, next{n} { instance.start(); }
+
+  void handle(const std::variant<Hop> &e) {
+    switch (step++ % 9) {
+    case 0: instance.handle(PowerOn{}); break;
+    case 1: instance.handle(Initialized{}); break;
+    case 2: instance.handle(Action{}); break;
+    case 3: instance.handle(Tick{}); break;
+    case 4: instance.handle(Tick{}); break;
+    case 5: instance.handle(Timeout{}); break;
+    case 6: instance.handle(Configure{}); break;
+    case 7: instance.handle(Timeout{}); break;
+    default: instance.handle(Failure{}); break;
+    }
+    const auto remaining = std::get<Hop>(e).remaining;
+    if (remaining > 0) {
+      system->post(next, Hop{remaining - 1});
+    }
+  }
+};
+
+void BM_ActorSystem_Throughput(benchmark::State &state) {
+  System system{static_cast<std::size_t>(state.range(0))};
+  for (System::Id id = 0; id < actors; ++id) {
+    system.spawn(system, (id + 1) % actors);
+  }
+  system.start();
+
+  for (auto _ : state) {
+    for (System::Id id = 0; id < actors; id += stride) {
+      system.post(id, Hop{hops - 1});
+    }
+    system.wait();
+  }
+  state.SetItemsProcessed(state.iterations() * (actors / stride) * hops);
+}
+BENCHMARK(BM_ActorSystem_Throughput)
+    ->RangeMultiplier(2)
+    ->Range(1, std::max(1u, std::thread::hardware_concurrency()))
+    ->UseRealTime();
+
+} // namespace
@@ -0,0 +1,47 @@
+# Reports .text bytes of every object file of OBJECTS, summing .text.*
+# sections of -ffunction-sections builds, as CSV written to OUTPUT and
+# printed. When BASELINE, CSV written earlier, is given, fails if any chart
+# grew.
+#
+# cmake -DSIZE_TOOL=size -DOBJECTS=a.o|b.o -DOUTPUT=out.csv
+#       [-DBASELINE=baseline.csv] -P code_size.cmake
+
+string(REPLACE "|" ";" OBJECTS "${OBJECTS}")
+set(csv "chart,text_bytes\n")
+foreach(object IN LISTS OBJECTS)
+  execute_process(COMMAND ${SIZE_TOOL} -A ${object}
+                  OUTPUT_VARIABLE sections RESULT_VARIABLE failed)
+  if(failed)
+    message(FATAL_ERROR "${SIZE_TOOL} failed on ${object}")
+  endif()
+  string(REGEX MATCHALL "\n\\.text[^ \t\n]*[ \t]+[0-9]+" texts "${sections}")
+  set(total 0)
+  foreach(text IN LISTS texts)
+    string(REGEX MATCH "[0-9]+$" bytes "${text}")
+    math(EXPR total "${total} + ${bytes}")
+  endforeach()
+  get_filename_component(chart ${object} NAME_WE)
+  string(APPEND csv "${chart},${total}\n")
+  set(size_${chart} ${total})
+endforeach()
+
+file(WRITE ${OUTPUT} "${csv}")
+message("${csv}")
+
+if(BASELINE)
+  file(STRINGS ${BASELINE} lines)
+  set(grown "")
+  foreach(line IN LISTS lines)
+    if(line MATCHES "^([^,]+),([0-9]+)$")
+      set(chart ${CMAKE_MATCH_1})
+      set(baseline ${CMAKE_MATCH_2})
+      if(DEFINED size_${chart} AND size_${chart} GREATER baseline)
+        string(APPEND grown
+               "${chart} grew from ${baseline} to ${size_${chart}} bytes\n")
+      endif()
+    endif()
+  endforeach()
+  if(grown)
+    message(FATAL_ERROR "${grown}")
+  endif()
+endif()
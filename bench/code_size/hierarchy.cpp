@@ -0,0 +1,125 @@
+// Nested states with start states, enter() redirects and handlers choosing
+// target at runtime, same shape as test/complex_state_chart.h.
+
+#include <sctl.h>
+
+#include <variant>
+
+namespace hierarchy {
+
+struct PowerOn {};
+struct PowerOff {};
+struct Initialized {};
+struct Failure {};
+struct Action {};
+struct Timeout {};
+struct Configure {};
+struct Tick {};
+
+namespace {
+
+struct Off;
+struct OffInternal;
+struct Error;
+struct On;
+struct Init;
+struct Ready;
+struct Busy;
+struct Config;
+struct Processing;
+struct Waiting;
+
+volatile unsigned entered;
+volatile unsigned exited;
+
+struct StateBase {
+  void enter() { entered = entered + 1; }
+  void exit() { exited = exited + 1; }
+};
+
+struct Off : StateBase {
+  using StartState = OffInternal;
+  auto handle(const PowerOn &) { return sctl::State<On>{}; }
+};
+struct OffInternal : StateBase {
+  using ParentState = Off;
+  void handle(const Tick &) { entered = entered + 1; }
+};
+struct On : StateBase {
+  using StartState = Init;
+  auto handle(const PowerOff &) { return sctl::State<Off>{}; }
+  auto handle(const Failure &) { return sctl::State<Error>{}; }
+};
+struct Error : StateBase {
+  auto enter() {
+    StateBase::enter();
+    return sctl::State<Off>{};
+  }
+};
+struct Init : StateBase {
+  using ParentState = On;
+  auto handle(const Initialized &) { return sctl::State<Ready>{}; }
+};
+struct Ready : StateBase {
+  using ParentState = On;
+  auto handle(const Action &) { return sctl::State<Busy>{}; }
+  auto handle(const Configure &) { return sctl::State<Config>{}; }
+};
+struct Busy : StateBase {
+  using ParentState = On;
+  auto handle(const Timeout &) { return sctl::State<Ready>{}; }
+  auto handle(const Tick &) { return sctl::State<Busy>{}; }
+};
+struct Config : StateBase {
+  using ParentState = On;
+  using StartState = Processing;
+};
+struct Processing : StateBase {
+  using ParentState = Config;
+  std::variant<sctl::State<Waiting>, sctl::KeepState> enter() {
+    StateBase::enter();
+    if (entered % 2) {
+      return sctl::State<Waiting>{};
+    }
+    return sctl::KeepState{};
+  }
+};
+struct Waiting : StateBase {
+  using ParentState = Config;
+  std::variant<sctl::State<Ready>, sctl::KeepState> handle(const Timeout &) {
+    if (exited % 2) {
+      return sctl::State<Ready>{};
+    }
+    return sctl::KeepState{};
+  }
+};
+
+Off off;
+OffInternal off_internal;
+Error error;
+On on;
+Init init;
+Ready ready;
+Busy busy;
+Config config;
+Processing processing;
+Waiting waiting;
+
+sctl::StateChart<Off, OffInternal, Error, On, Init, Ready, Busy, Config,
+                 Processing, Waiting>
+    chart{off,   off_internal, error,  on,         init,
+          ready, busy,         config, processing, waiting};
+
+} // namespace
+
+void start() noexcept { chart.start(true); }
+
+void handle(
+    const std::variant<PowerOn, PowerOff, Initialized, Failure, Action,
+                       Timeout, Configure, Tick> &e) noexcept {
+  chart.handle(e);
+}
+
+bool is_ready() noexcept { return chart.is_active<Ready>(); }
+
+} // namespace hierarchy
@@ -0,0 +1,86 @@
+// Orthogonal regions and deferred events, events are dispatched one
+// alternative at a time.
+
+#include <sctl.h>
+
+#include <variant>
+
+namespace regions {
+
+struct Start {};
+struct Stop {};
+struct Prime {};
+struct Open {};
+struct Order {
+  int id;
+};
+
+namespace {
+
+struct Idle;
+struct Running;
+struct Pump;
+struct PumpOff;
+struct PumpOn;
+struct Valve;
+struct Closed;
+struct Opened;
+
+volatile int last_order;
+
+struct Idle {
+  auto handle(const Start &) { return sctl::State<Running>{}; }
+  void handle(const Order &o) { last_order = o.id; }
+};
+struct Running {
+  using Regions = sctl::Regions<Pump, Valve>;
+  using Deferred = sctl::Deferred<Order>;
+  auto handle(const Stop &) { return sctl::State<Idle>{}; }
+};
+struct Pump {
+  using ParentState = Running;
+  using StartState = PumpOff;
+};
+struct PumpOff {
+  using ParentState = Pump;
+  auto handle(const Prime &) { return sctl::State<PumpOn>{}; }
+};
+struct PumpOn {
+  using ParentState = Pump;
+};
+struct Valve {
+  using ParentState = Running;
+  using StartState = Closed;
+};
+struct Closed {
+  using ParentState = Valve;
+  auto handle(const Open &) { return sctl::State<Opened>{}; }
+};
+struct Opened {
+  using ParentState = Valve;
+};
+
+Idle idle;
+Running running;
+Pump pump;
+PumpOff pump_off;
+PumpOn pump_on;
+Valve valve;
+Closed closed;
+Opened opened;
+
+sctl::StateChart<Idle, Running, Pump, PumpOff, PumpOn, Valve, Closed, Opened>
+    chart{idle, running, pump, pump_off, pump_on, valve, closed, opened};
+
+} // namespace
+
+void start() noexcept { chart.start(); }
+
+void handle(
+    const std::variant<Start, Stop, Prime, Open, Order> &e) noexcept {
+  chart.handle(e);
+}
+
+bool is_opened() noexcept { return chart.is_active<Opened>(); }
+
+} // namespace regions
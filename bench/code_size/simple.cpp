@@ -0,0 +1,38 @@
+// Two state switch, the smallest chart.
+
+#include <sctl.h>
+
+#include <variant>
+
+namespace simple {
+
+struct TurnOn {};
+struct TurnOff {};
+
+namespace {
+
+struct On;
+struct Off;
+
+struct On {
+  auto handle(const TurnOff &) { return sctl::State<Off>{}; }
+};
+struct Off {
+  auto handle(const TurnOn &) { return sctl::State<On>{}; }
+};
+
+On on;
+Off off;
+sctl::StateChart<Off, On> chart{off, on};
+
+} // namespace
+
+void start() noexcept { chart.start(); }
+
+void handle(const std::variant<TurnOn, TurnOff> &e) noexcept {
+  chart.handle(e);
+}
+
+bool is_on() noexcept { return chart.is_active<On>(); }
+
+} // namespace simple
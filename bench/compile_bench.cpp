@@ -0,0 +1,284 @@
+// Generates synthetic state charts of different shapes and sizes, compiles
+// each of them and reports compile time, peak compiler memory and object size
+// as CSV.
+//
+// Usage: sctl_compile_bench <compiler> <include dir> <work dir>
+//                           [sizes] [compiler flags...]
+//
+// sizes is comma separated list of state counts, default 10,30,100,300,1000.
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+namespace {
+
+// Every generated chart has events:
+// E0 - move to next state on the same level,
+// E1 - move to state far away in hierarchy,
+// E2 - handled by root state(s), no transition.
+std::string header(std::size_t states) {
+  std::ostringstream out;
+  out << "#include <sctl.h>\n\n";
+  out << "struct E0 {};\nstruct E1 {};\nstruct E2 {};\n\n";
+  out << "static unsigned counter;\n\n";
+  for (std::size_t i = 0; i < states; ++i) {
+    out << "struct S" << i << ";\n";
+  }
+  out << "\n";
+  return out.str();
+}
+
+std::string actions() {
+  return "  void enter() { ++counter; }\n  void exit() { --counter; }\n";
+}
+
+std::string footer(std::size_t states) {
+  std::ostringstream out;
+  out << "\nusing SC = sctl::StateChart<";
+  for (std::size_t i = 0; i < states; ++i) {
+    out << (i ? ", " : "") << "S" << i;
+  }
+  out << ">;\n\nstruct Instance {\n";
+  for (std::size_t i = 0; i < states; ++i) {
+    out << "  S" << i << " s" << i << ";\n";
+  }
+  out << "  SC chart{";
+  for (std::size_t i = 0; i < states; ++i) {
+    out << (i ? ", " : "") << "s" << i;
+  }
+  out << "};\n};\n\n";
+  out << "unsigned drive(Instance &instance) {\n"
+         "  instance.chart.start(true);\n"
+         "  instance.chart.handle(E0{});\n"
+         "  instance.chart.handle(E1{});\n"
+         "  instance.chart.handle(E2{});\n"
+         "  return counter;\n"
+         "}\n";
+  return out.str();
+}
+
+// N leaf states in a ring.
+std::string flat_chart(std::size_t states) {
+  std::ostringstream out;
+  out << header(states);
+  for (std::size_t i = 0; i < states; ++i) {
+    out << "struct S" << i << " {\n" << actions();
+    out << "  auto handle(const E0 &) { return sctl::State<S"
+        << (i + 1) % states << ">{}; }\n";
+    out << "  auto handle(const E1 &) { return sctl::State<S"
+        << (i + states / 2) % states << ">{}; }\n";
+    out << "  void handle(const E2 &) {}\n";
+    out << "};\n";
+  }
+  out << footer(states);
+  return out.str();
+}
+
+// Nested composite states, each level has composite and leaf state:
+// S0 { S1, S2 { S3, S4 { ... } } }, leaves move one level down and back to
+// top level, root handles E2.
+std::string deep_chart(std::size_t states) {
+  std::ostringstream out;
+  out << header(states);
+  const std::size_t last = states - 1;
+  for (std::size_t i = 0; i < states; ++i) {
+    const bool composite = i % 2 == 0 && i + 1 < states;
+    out << "struct S" << i << " {\n" << actions();
+    if (i > 0) {
+      out << "  using ParentState = S" << (i - 1) / 2 * 2 << ";\n";
+    }
+    if (composite) {
+      out << "  using StartState = S" << i + 1 << ";\n";
+    } else {
+      const std::size_t next = std::min(i + 2, last);
+      out << "  auto handle(const E0 &) { return sctl::State<S" << next
+          << ">{}; }\n";
+      out << "  auto handle(const E1 &) { return sctl::State<S1>{}; }\n";
+    }
+    if (i == 0) {
+      out << "  void handle(const E2 &) {}\n";
+    }
+    out << "};\n";
+  }
+  out << footer(states);
+  return out.str();
+}
+
+// sqrt(N) composite states with sqrt(N) leaves each, leaves move inside
+// their group and to the next group.
+std::string wide_chart(std::size_t states) {
+  std::ostringstream out;
+  out << header(states);
+  const auto group = std::max<std::size_t>(
+      2, static_cast<std::size_t>(std::sqrt(static_cast<double>(states))));
+  for (std::size_t i = 0; i < states; ++i) {
+    const std::size_t begin = i / group * group;
+    const std::size_t end = std::min(begin + group, states);
+    out << "struct S" << i << " {\n" << actions();
+    if (i == begin) {
+      if (end - begin > 1) {
+        out << "  using StartState = S" << i + 1 << ";\n";
+      }
+      out << "  void handle(const E2 &) {}\n";
+    } else {
+      const std::size_t next = i + 1 < end ? i + 1 : begin + 1;
+      const std::size_t other = end < states ? end : 0;
+      out << "  using ParentState = S" << begin << ";\n";
+      out << "  auto handle(const E0 &) { return sctl::State<S" << next
+          << ">{}; }\n";
+      out << "  auto handle(const E1 &) { return sctl::State<S" << other
+          << ">{}; }\n";
+    }
+    out << "};\n";
+  }
+  out << footer(states);
+  return out.str();
+}
+
+// sqrt(N) composite states with sqrt(N) leaves each, composite states handle
+// moves to other groups for all their leaves, leaves move inside group.
+std::string grouped_chart(std::size_t states) {
+  std::ostringstream out;
+  out << header(states);
+  const auto group = std::max<std::size_t>(
+      2, static_cast<std::size_t>(std::sqrt(static_cast<double>(states))));
+  const std::size_t groups = (states + group - 1) / group;
+  for (std::size_t i = 0; i < states; ++i) {
+    const std::size_t begin = i / group * group;
+    const std::size_t end = std::min(begin + group, states);
+    out << "struct S" << i << " {\n" << actions();
+    if (i == begin) {
+      const std::size_t g = i / group;
+      if (end - begin > 1) {
+        out << "  using StartState = S" << i + 1 << ";\n";
+      }
+      out << "  auto handle(const E0 &) { return sctl::State<S"
+          << (g + 1) % groups * group << ">{}; }\n";
+      out << "  auto handle(const E1 &) { return sctl::State<S"
+          << (g + groups / 2) % groups * group << ">{}; }\n";
+    } else {
+      const std::size_t next = i + 1 < end ? i + 1 : begin + 1;
+      out << "  using ParentState = S" << begin << ";\n";
+      out << "  auto handle(const E2 &) { return sctl::State<S" << next
+          << ">{}; }\n";
+    }
+    out << "};\n";
+  }
+  out << footer(states);
+  return out.str();
+}
+
+struct Measurement {
+  bool ok;
+  double seconds;
+  long peak_rss_kb;
+  std::uintmax_t object_bytes;
+};
+
+Measurement compile(const std::vector<std::string> &command,
+                    const std::filesystem::path &object) {
+  std::vector<char *> argv;
+  for (const auto &arg : command) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  const auto begin = std::chrono::steady_clock::now();
+  pid_t pid;
+  if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ)) {
+    return {false, 0, 0, 0};
+  }
+  int status = 0;
+  rusage usage{};
+  pid_t waited;
+  do {
+    waited = wait4(pid, &status, 0, &usage);
+  } while (waited < 0 && errno == EINTR);
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - begin;
+  if (waited != pid) {
+    return {false, elapsed.count(), 0, 0};
+  }
+
+  const bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  return {ok, elapsed.count(), usage.ru_maxrss,
+          ok ? std::filesystem::file_size(object) : 0};
+}
+
+std::vector<std::size_t> parse_sizes(const std::string &list) {
+  std::vector<std::size_t> sizes;
+  std::istringstream in{list};
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    sizes.push_back(std::stoul(item));
+  }
+  return sizes;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 4) {
+    std::cerr << "usage: " << argv[0]
+              << " <compiler> <include dir> <work dir> [sizes] [flags...]\n";
+    return 1;
+  }
+  const std::string compiler = argv[1];
+  const std::string include = argv[2];
+  const std::filesystem::path work = argv[3];
+  const auto sizes = parse_sizes(argc > 4 ? argv[4] : "10,30,100,300,1000");
+  std::vector<std::string> flags{argv + std::min(argc, 5), argv + argc};
+  if (flags.empty()) {
+    flags = {"-std=c++20", "-O2"};
+  }
+
+  std::filesystem::create_directories(work);
+
+  struct Shape {
+    const char *name;
+    std::string (*generate)(std::size_t);
+  };
+  const Shape shapes[] = {
+      {"flat", flat_chart},
+      {"deep", deep_chart},
+      {"wide", wide_chart},
+      {"grouped", grouped_chart}};
+
+  std::cout << "shape,states,compile_seconds,peak_rss_kb,object_bytes\n";
+  for (const auto &shape : shapes) {
+    for (const auto states : sizes) {
+      const auto name = std::string{shape.name} + "_" + std::to_string(states);
+      const auto source = work / (name + ".cpp");
+      const auto object = work / (name + ".o");
+      std::ofstream{source} << shape.generate(states);
+
+      std::vector<std::string> command{compiler, "-I" + include};
+      command.insert(command.end(), flags.begin(), flags.end());
+      command.insert(command.end(),
+                     {"-c", source.string(), "-o", object.string()});
+
+      const auto m = compile(command, object);
+      std::cout << shape.name << "," << states << ",";
+      if (m.ok) {
+        std::cout << m.seconds << "," << m.peak_rss_kb << "," << m.object_bytes
+                  << "\n";
+      } else {
+        std::cout << "failed,,\n";
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "sctl.h"
+
+#include <benchmark/benchmark.h>
+
+/*
+ Complex State Chart, same as test/complex_state_chart.h but with plain
+ counters instead of mocks, so that only library overhead is measured.
+*/
+
+namespace bench {
+
+struct Off;
+struct OffInternal;
+struct Error;
+struct On;
+struct Init;
+struct Ready;
+struct Busy;
+struct Config;
+struct Processing;
+struct Waiting;
+
+struct PowerOn {};
+struct PowerOff {};
+struct Initialized {};
+struct Failure {};
+struct Action {};
+struct Timeout {};
+struct Configure {};
+struct Tick {};
+
+struct StateBase {
+  unsigned entered{0};
+  unsigned exited{0};
+
+  void enter() { benchmark::DoNotOptimize(++entered); }
+  void exit() { benchmark::DoNotOptimize(++exited); }
+};
+
+struct Off : StateBase {
+  using StartState = OffInternal;
+  auto handle(const PowerOn &) { return sctl::State<On>{}; }
+};
+struct OffInternal : StateBase {
+  using ParentState = Off;
+  unsigned ticks{0};
+  void handle(const Tick &) { benchmark::DoNotOptimize(++ticks); }
+};
+struct On : StateBase {
+  using StartState = Init;
+  auto handle(const PowerOff &) { return sctl::State<Off>{}; }
+  auto handle(const Failure &) { return sctl::State<Error>{}; }
+};
+struct Error : StateBase {
+  auto enter() {
+    StateBase::enter();
+    return sctl::State<Off>{};
+  }
+};
+struct Init : StateBase {
+  using ParentState = On;
+  auto handle(const Initialized &) { return sctl::State<Ready>{}; }
+};
+struct Ready : StateBase {
+  using ParentState = On;
+  auto handle(const Action &) { return sctl::State<Busy>{}; }
+  auto handle(const Configure &) { return sctl::State<Config>{}; }
+};
+struct Busy : StateBase {
+  using ParentState = On;
+  auto handle(const Timeout &) { return sctl::State<Ready>{}; }
+  auto handle(const Tick &) { return sctl::State<Busy>{}; }
+};
+struct Config : StateBase {
+  using ParentState = On;
+  using StartState = Processing;
+};
+struct Processing : StateBase {
+  using ParentState = Config;
+  std::variant<sctl::State<Waiting>, sctl::KeepState> enter() {
+    StateBase::enter();
+    return sctl::State<Waiting>{};
+  }
+};
+struct Waiting : StateBase {
+  using ParentState = Config;
+  std::variant<sctl::State<Ready>, sctl::KeepState> handle(const Timeout &) {
+    return sctl::State<Ready>{};
+  }
+};
+
+using SC = sctl::StateChart<Off, OffInternal, Error, On, Init, Ready, Busy,
+                            Config, Processing, Waiting>;
+
+struct ComplexChart {
+  Off off;
+  OffInternal off_internal;
+  Error error;
+  On on;
+  Init init;
+  Ready ready;
+  Busy busy;
+  Config config;
+  Processing processing;
+  Waiting waiting;
+
+  SC instance{off,   off_internal, error,  on,         init,
+              ready, busy,         config, processing, waiting};
+};
+
+} // namespace bench
@@ -0,0 +1,125 @@
+#include "sctl.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ Many connection charts handling events in random order: every chart with
+ own state objects, holding connection data, versus charts with context,
+ which are only connection data and active state.
+*/
+
+namespace {
+
+struct Connect {};
+struct Data {
+  std::uint32_t bytes;
+};
+struct Reset {};
+
+struct Stats {
+  std::uint64_t received{0};
+  std::uint32_t packets{0};
+};
+
+namespace own {
+
+struct Closed;
+struct Open;
+
+struct Closed {
+  auto handle(const Connect &) { return sctl::State<Open>{}; }
+};
+struct Open {
+  Stats stats;
+  void handle(const Data &d) {
+    stats.received += d.bytes;
+    ++stats.packets;
+  }
+  auto handle(const Reset &) { return sctl::State<Closed>{}; }
+};
+
+struct Connection {
+  Closed closed;
+  Open open;
+  sctl::StateChart<Closed, Open> chart{closed, open};
+};
+
+} // namespace own
+
+namespace contextual {
+
+struct Closed;
+struct Open;
+
+struct Closed {
+  auto handle(Stats &, const Connect &) { return sctl::State<Open>{}; }
+};
+struct Open {
+  void handle(Stats &s, const Data &d) {
+    s.received += d.bytes;
+    ++s.packets;
+  }
+  auto handle(Stats &, const Reset &) { return sctl::State<Closed>{}; }
+};
+
+using Connection = sctl::StateChart<sctl::WithContext<Stats>, Closed, Open>;
+
+} // namespace contextual
+
+constexpr std::size_t connections = 100'000;
+
+// Fixed pseudo random order of connections, same for both cases.
+std::vector<std::uint32_t> make_order() {
+  std::vector<std::uint32_t> order(1 << 20);
+  std::uint64_t x = 88172645463325252ull;
+  for (auto &id : order) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    id = static_cast<std::uint32_t>(x % connections);
+  }
+  return order;
+}
+
+template <typename Chart>
+void run(benchmark::State &state, std::vector<Chart *> &charts,
+         std::size_t bytes_per_chart) {
+  const auto order = make_order();
+  for (auto *chart : charts) {
+    chart->start();
+    chart->handle(Connect{});
+  }
+  for (auto _ : state) {
+    for (const auto id : order) {
+      charts[id]->handle(Data{64});
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * order.size());
+  state.counters["bytes/chart"] = bytes_per_chart;
+}
+
+void BM_Connections_OwnStates(benchmark::State &state) {
+  std::vector<own::Connection> storage(connections);
+  std::vector<sctl::StateChart<own::Closed, own::Open> *> charts;
+  for (auto &c : storage) {
+    charts.push_back(&c.chart);
+  }
+  run(state, charts, sizeof(own::Connection));
+}
+BENCHMARK(BM_Connections_OwnStates);
+
+void BM_Connections_WithContext(benchmark::State &state) {
+  std::vector<contextual::Connection> storage(connections);
+  std::vector<contextual::Connection *> charts;
+  for (auto &c : storage) {
+    charts.push_back(&c);
+  }
+  run(state, charts, sizeof(contextual::Connection));
+}
+BENCHMARK(BM_Connections_WithContext);
+
+} // namespace
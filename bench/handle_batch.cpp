@@ -0,0 +1,136 @@
+#include "complex_state_chart.h"
+
+#include <benchmark/benchmark.h>
+
+#include <span>
+#include <vector>
+
+using namespace bench;
+
+namespace {
+
+using Event = std::variant<PowerOn, PowerOff, Initialized, Failure, Action,
+                           Timeout, Configure, Tick>;
+
+// Walks through every transition of the chart and comes back to Off state.
+const std::vector<Event> cycle{PowerOn{},   Initialized{}, Action{},
+                               Tick{},      Tick{},        Timeout{},
+                               Configure{}, Timeout{},     Failure{}};
+
+std::vector<Event> mixed_events(std::size_t count) {
+  std::vector<Event> events;
+  while (events.size() < count) {
+    events.insert(events.end(), cycle.begin(), cycle.end());
+  }
+  events.resize(count - count % cycle.size());
+  return events;
+}
+
+void to_busy(ComplexChart &chart) {
+  chart.instance.handle(PowerOn{});
+  chart.instance.handle(Initialized{});
+  chart.instance.handle(Action{});
+}
+
+void BM_HandleLoop_TickNoTransition(benchmark::State &state) {
+  ComplexChart chart;
+  chart.instance.start();
+  const std::vector<Tick> ticks(state.range(0));
+
+  for (auto _ : state) {
+    for (const auto &t : ticks) {
+      chart.instance.handle(t);
+    }
+    benchmark::DoNotOptimize(chart.off_internal.ticks);
+  }
+  state.SetItemsProcessed(state.iterations() * ticks.size());
+}
+BENCHMARK(BM_HandleLoop_TickNoTransition)->Arg(4096);
+
+void BM_HandleBatch_TickNoTransition(benchmark::State &state) {
+  ComplexChart chart;
+  chart.instance.start();
+  const std::vector<Tick> ticks(state.range(0));
+
+  for (auto _ : state) {
+    chart.instance.handle_batch(std::span{ticks});
+    benchmark::DoNotOptimize(chart.off_internal.ticks);
+  }
+  state.SetItemsProcessed(state.iterations() * ticks.size());
+}
+BENCHMARK(BM_HandleBatch_TickNoTransition)->Arg(4096);
+
+void BM_HandleLoop_TickSelfTransition(benchmark::State &state) {
+  ComplexChart chart;
+  chart.instance.start();
+  to_busy(chart);
+  const std::vector<Tick> ticks(state.range(0));
+
+  for (auto _ : state) {
+    for (const auto &t : ticks) {
+      chart.instance.handle(t);
+    }
+    benchmark::DoNotOptimize(chart.busy.entered);
+  }
+  state.SetItemsProcessed(state.iterations() * ticks.size());
+}
+BENCHMARK(BM_HandleLoop_TickSelfTransition)->Arg(4096);
+
+void BM_HandleBatch_TickSelfTransition(benchmark::State &state) {
+  ComplexChart chart;
+  chart.instance.start();
+  to_busy(chart);
+  const std::vector<Tick> ticks(state.range(0));
+
+  for (auto _ : state) {
+    chart.instance.handle_batch(std::span{ticks});
+    benchmark::DoNotOptimize(chart.busy.entered);
+  }
+  state.SetItemsProcessed(state.iterations() * ticks.size());
+}
+BENCHMARK(BM_HandleBatch_TickSelfTransition)->Arg(4096);
+
+void BM_HandleLoop_MixedEvents(benchmark::State &state) {
+  ComplexChart chart;
+  chart.instance.start();
+  const auto events = mixed_events(state.range(0));
+
+  for (auto _ : state) {
+    for (const auto &event : events) {
+      std::visit([&chart](const auto &e) { chart.instance.handle(e); }, event);
+    }
+    benchmark::DoNotOptimize(chart.off.entered);
+  }
+  state.SetItemsProcessed(state.iterations() * events.size());
+}
+BENCHMARK(BM_HandleLoop_MixedEvents)->Arg(4096);
+
+void BM_HandleVariant_MixedEvents(benchmark::State &state) {
+  ComplexChart chart;
+  chart.instance.start();
+  const auto events = mixed_events(state.range(0));
+
+  for (auto _ : state) {
+    for (const auto &event : events) {
+      chart.instance.handle(event);
+    }
+    benchmark::DoNotOptimize(chart.off.entered);
+  }
+  state.SetItemsProcessed(state.iterations() * events.size());
+}
+BENCHMARK(BM_HandleVariant_MixedEvents)->Arg(4096);
+
+void BM_HandleBatch_MixedEvents(benchmark::State &state) {
+  ComplexChart chart;
+  chart.instance.start();
+  const auto events = mixed_events(state.range(0));
+
+  for (auto _ : state) {
+    chart.instance.handle_batch(std::span{events});
+    benchmark::DoNotOptimize(chart.off.entered);
+  }
+  state.SetItemsProcessed(state.iterations() * events.size());
+}
+BENCHMARK(BM_HandleBatch_MixedEvents)->Arg(4096);
+
+} // namespace
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+// Counts user space instructions retired by calling thread from construction
+// until report(). When hardware counters are not available (other platforms,
+// virtual machines, restrictive perf_event_paranoid) only time is reported.
+class InstructionCounter {
+public:
+  InstructionCounter() {
+#if defined(__linux__)
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    _fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+
+  InstructionCounter(const InstructionCounter &) = delete;
+  InstructionCounter &operator=(const InstructionCounter &) = delete;
+
+  ~InstructionCounter() {
+#if defined(__linux__)
+    if (_fd >= 0) {
+      close(_fd);
+    }
+#endif
+  }
+
+  // Reports time/event and, if counted, instructions/event, where events is
+  // number of events handled in single benchmark iteration.
+  void report(benchmark::State &state, std::size_t events) {
+    const auto total = static_cast<double>(state.iterations() * events);
+    state.SetItemsProcessed(state.iterations() * events);
+    state.counters["time/event"] = benchmark::Counter(
+        total, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+#if defined(__linux__)
+    std::uint64_t count;
+    if (_fd >= 0 && read(_fd, &count, sizeof(count)) == sizeof(count)) {
+      state.counters["instructions/event"] = static_cast<double>(count) / total;
+    }
+#endif
+  }
+
+private:
+  int _fd{-1};
+};
+
+} // namespace bench
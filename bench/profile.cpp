@@ -0,0 +1,70 @@
+#include "complex_state_chart.h"
+#include "instruction_counter.h"
+
+#include "sctl_profile.h"
+
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace bench;
+
+namespace {
+
+using Event = std::variant<PowerOn, PowerOff, Initialized, Failure, Action,
+                           Timeout, Configure, Tick>;
+
+const std::vector<Event> cycle{PowerOn{},   Initialized{}, Action{},
+                               Tick{},      Tick{},        Timeout{},
+                               Configure{}, Timeout{},     Failure{}};
+
+using Profiled = sctl::ProfileObserver<PowerOn, PowerOff, Initialized, Failure,
+                                       Action, Timeout, Configure, Tick>;
+using ProfiledSC =
+    sctl::StateChart<sctl::WithObserver<Profiled>, Off, OffInternal, Error, On,
+                     Init, Ready, Busy, Config, Processing, Waiting>;
+
+template <typename Chart>
+void run_cycle(benchmark::State &state, Chart &chart) {
+  chart.start();
+
+  InstructionCounter counter;
+  for (auto _ : state) {
+    for (const auto &event : cycle) {
+      chart.handle(event);
+    }
+  }
+  counter.report(state, cycle.size());
+}
+
+void BM_ComplexChart_Unprofiled(benchmark::State &state) {
+  ComplexChart chart;
+  run_cycle(state, chart.instance);
+}
+BENCHMARK(BM_ComplexChart_Unprofiled);
+
+void BM_ComplexChart_Profiled(benchmark::State &state) {
+  const std::string name = "/sctl_bench_profile_" + std::to_string(getpid());
+  auto segment =
+      sctl::ProfileSegment::create<ProfiledSC, PowerOn, PowerOff, Initialized,
+                                   Failure, Action, Timeout, Configure, Tick>(
+          name, 1);
+  ComplexChart c;
+  ProfiledSC chart{Profiled{segment},
+                   c.off,
+                   c.off_internal,
+                   c.error,
+                   c.on,
+                   c.init,
+                   c.ready,
+                   c.busy,
+                   c.config,
+                   c.processing,
+                   c.waiting};
+  run_cycle(state, chart);
+  sctl::ProfileSegment::remove(name);
+}
+BENCHMARK(BM_ComplexChart_Profiled);
+
+} // namespace
@@ -0,0 +1,80 @@
+#include "complex_state_chart.h"
+
+#include "sctl_record.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+/*
+ Cost of recording events of complex chart to event log, and replaying
+ recorded log as fast as possible.
+*/
+
+using namespace bench;
+
+namespace {
+
+using Event = std::variant<PowerOn, PowerOff, Initialized, Failure, Action,
+                           Timeout, Configure, Tick>;
+
+const std::vector<Event> cycle{PowerOn{},   Initialized{}, Action{},
+                               Tick{},      Tick{},        Timeout{},
+                               Configure{}, Timeout{},     Failure{}};
+
+using Recorder = sctl::EventRecorder<SC, PowerOn, PowerOff, Initialized,
+                                     Failure, Action, Timeout, Configure, Tick>;
+using Replayer = sctl::EventReplayer<SC, PowerOn, PowerOff, Initialized,
+                                     Failure, Action, Timeout, Configure, Tick>;
+
+std::string log_path() {
+  return "/tmp/sctl_bench_record_" + std::to_string(getpid()) + ".log";
+}
+
+void BM_ComplexChart_Recorded(benchmark::State &state) {
+  const std::string path = log_path();
+  ComplexChart chart;
+  chart.instance.start();
+  {
+    Recorder recorder{chart.instance, path};
+    for (auto _ : state) {
+      for (const auto &event : cycle) {
+        std::visit([&recorder](const auto &e) { recorder.handle(e); }, event);
+      }
+    }
+  }
+  std::remove(path.c_str());
+  state.SetItemsProcessed(state.iterations() * cycle.size());
+}
+BENCHMARK(BM_ComplexChart_Recorded);
+
+void BM_ComplexChart_Replayed(benchmark::State &state) {
+  const std::string path = log_path();
+  {
+    ComplexChart chart;
+    chart.instance.start();
+    Recorder recorder{chart.instance, path};
+    for (int i = 0; i < 1000; ++i) {
+      for (const auto &event : cycle) {
+        std::visit([&recorder](const auto &e) { recorder.handle(e); }, event);
+      }
+    }
+  }
+  const sctl::EventLog log{path};
+  sctl::ReplayReport report;
+  for (auto _ : state) {
+    ComplexChart chart;
+    chart.instance.start();
+    report = Replayer{chart.instance}.replay(log);
+  }
+  std::remove(path.c_str());
+  state.counters["p50_ns"] = report.latency_p50;
+  state.counters["p99_ns"] = report.latency_p99;
+  state.counters["mismatches"] = report.mismatches;
+  state.SetItemsProcessed(state.iterations() * log.size());
+}
+BENCHMARK(BM_ComplexChart_Replayed);
+
+} // namespace
@@ -0,0 +1,86 @@
+#include "complex_state_chart.h"
+#include "instruction_counter.h"
+
+#include "sctl_parser.h"
+#include "sctl_runtime.h"
+
+#include <vector>
+
+/*
+ The same complex chart and cycle of events as in switch_baseline.cpp, run by
+ compiled chart and by runtime::Machine built from its ParseResult, so that
+ difference is the cost of interpreting chart from data.
+*/
+
+using namespace bench;
+
+namespace {
+
+using Event = std::variant<PowerOn, PowerOff, Initialized, Failure, Action,
+                           Timeout, Configure, Tick>;
+
+const std::vector<Event> cycle{PowerOn{},   Initialized{}, Action{},
+                               Tick{},      Tick{},        Timeout{},
+                               Configure{}, Timeout{},     Failure{}};
+
+using ComplexParser = sctl::parser::Parser<SC, PowerOn, PowerOff, Initialized,
+                                           Failure, Action, Timeout, Configure,
+                                           Tick>;
+
+void BM_Compiled_ComplexChart(benchmark::State &state) {
+  ComplexChart chart;
+  chart.instance.start();
+
+  InstructionCounter counter;
+  for (auto _ : state) {
+    for (const auto &event : cycle) {
+      chart.instance.handle(event);
+    }
+  }
+  benchmark::DoNotOptimize(chart.off.entered);
+  counter.report(state, cycle.size());
+}
+BENCHMARK(BM_Compiled_ComplexChart);
+
+void BM_Runtime_ComplexChart(benchmark::State &state) {
+  const sctl::runtime::Program program{ComplexParser{}()};
+
+  // Every state counts its enters and exits, as StateBase does.
+  std::vector<StateBase> states(program.states());
+  sctl::runtime::Registry registry{program};
+  for (sctl::runtime::Id s = 0; s < program.states(); ++s) {
+    const auto name = program.state_name(s);
+    registry.on_enter(name, {[](void *c, const void *) -> std::size_t {
+                               static_cast<StateBase *>(c)->enter();
+                               return 0;
+                             },
+                             &states[s]});
+    registry.on_exit(
+        name, {[](void *c) { static_cast<StateBase *>(c)->exit(); }, &states[s]});
+  }
+
+  std::vector<sctl::runtime::Id> events;
+  for (const auto &event : cycle) {
+    events.push_back(std::visit(
+        [&program](const auto &e) {
+          return program.event(
+              sctl::details::type_name<std::decay_t<decltype(e)>>());
+        },
+        event));
+  }
+
+  sctl::runtime::Machine machine{program, registry};
+  machine.start();
+
+  InstructionCounter counter;
+  for (auto _ : state) {
+    for (const auto event : events) {
+      machine.handle(event);
+    }
+  }
+  benchmark::DoNotOptimize(states.front().entered);
+  counter.report(state, events.size());
+}
+BENCHMARK(BM_Runtime_ComplexChart);
+
+} // namespace
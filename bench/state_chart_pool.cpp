@@ -0,0 +1,144 @@
+#include "sctl_pool.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Connect {};
+struct Established {};
+struct Data {};
+struct Reset {};
+
+struct Idle;
+struct Online;
+struct Connecting;
+struct Connected;
+
+struct Idle {
+  constexpr auto handle(const Connect &) { return sctl::State<Online>{}; }
+};
+struct Online {
+  using StartState = Connecting;
+  constexpr auto handle(const Reset &) { return sctl::State<Idle>{}; }
+};
+struct Connecting {
+  using ParentState = Online;
+  constexpr auto handle(const Established &) {
+    return sctl::State<Connected>{};
+  }
+};
+struct Connected {
+  using ParentState = Online;
+  unsigned received{0};
+  void handle(const Data &) { ++received; }
+};
+
+using Pool = sctl::StateChartPool<Idle, Online, Connecting, Connected>;
+
+struct Instance {
+  Idle idle;
+  Online online;
+  Connecting connecting;
+  Connected connected;
+  sctl::StateChart<Idle, Online, Connecting, Connected> chart{
+      idle, online, connecting, connected};
+};
+
+void BM_Pool_BroadcastStatic(benchmark::State &state) {
+  Pool pool(state.range(0));
+  pool.start();
+
+  for (auto _ : state) {
+    pool.broadcast(Connect{});
+    pool.broadcast(Reset{});
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * 2 * pool.size());
+}
+BENCHMARK(BM_Pool_BroadcastStatic)->Arg(1 << 20);
+
+void BM_Charts_BroadcastStatic(benchmark::State &state) {
+  const std::size_t size = state.range(0);
+  auto instances = std::make_unique<Instance[]>(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    instances[i].chart.start();
+  }
+
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < size; ++i) {
+      instances[i].chart.handle(Connect{});
+    }
+    for (std::size_t i = 0; i < size; ++i) {
+      instances[i].chart.handle(Reset{});
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * 2 * size);
+}
+BENCHMARK(BM_Charts_BroadcastStatic)->Arg(1 << 20);
+
+void BM_Pool_BroadcastMixed(benchmark::State &state) {
+  Pool pool(state.range(0));
+  pool.start();
+  pool.broadcast(Connect{});
+  std::vector<Pool::Id> half;
+  for (Pool::Id id = 0; id < pool.size(); id += 2) {
+    half.push_back(id);
+  }
+  pool.handle(std::span<const Pool::Id>{half}, Established{});
+
+  for (auto _ : state) {
+    pool.broadcast(Data{});
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * pool.size());
+}
+BENCHMARK(BM_Pool_BroadcastMixed)->Arg(1 << 20);
+
+void BM_Charts_BroadcastMixed(benchmark::State &state) {
+  const std::size_t size = state.range(0);
+  auto instances = std::make_unique<Instance[]>(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    instances[i].chart.start();
+    instances[i].chart.handle(Connect{});
+    if (i % 2 == 0) {
+      instances[i].chart.handle(Established{});
+    }
+  }
+
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < size; ++i) {
+      instances[i].chart.handle(Data{});
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_Charts_BroadcastMixed)->Arg(1 << 20);
+
+void BM_Pool_HandleRandomIds(benchmark::State &state) {
+  Pool pool(state.range(0));
+  pool.start();
+  std::vector<Pool::Id> ids(pool.size() / 16);
+  std::mt19937 gen{42};
+  std::uniform_int_distribution<Pool::Id> dist(0, pool.size() - 1);
+  for (auto &id : ids) {
+    id = dist(gen);
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+  for (auto _ : state) {
+    pool.handle(std::span<const Pool::Id>{ids}, Connect{});
+    pool.handle(std::span<const Pool::Id>{ids}, Reset{});
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * 2 * ids.size());
+}
+BENCHMARK(BM_Pool_HandleRandomIds)->Arg(1 << 20);
+
+} // namespace
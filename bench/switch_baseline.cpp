@@ -0,0 +1,485 @@
+#include "complex_state_chart.h"
+#include "instruction_counter.h"
+
+#include <vector>
+
+/*
+ Every sctl chart below has equivalent hand-written enum + switch state
+ machine calling the same enter/exit actions in the same order, so that
+ difference in time/event and instructions/event is the cost of the library.
+*/
+
+using namespace bench;
+
+namespace {
+
+// Simple FSM, same shape as test/simple_fsm.cpp.
+
+struct TurnOn {};
+struct TurnOff {};
+
+struct SimpleOn;
+struct SimpleOff;
+
+struct SimpleOn : StateBase {
+  auto handle(const TurnOff &) { return sctl::State<SimpleOff>{}; }
+};
+struct SimpleOff : StateBase {
+  auto handle(const TurnOn &) { return sctl::State<SimpleOn>{}; }
+};
+
+struct SimpleChart {
+  SimpleOn on;
+  SimpleOff off;
+  sctl::StateChart<SimpleOff, SimpleOn> instance{off, on};
+};
+
+struct SimpleSwitch {
+  enum class Id { Off, On };
+
+  StateBase on;
+  StateBase off;
+  Id current{Id::Off};
+
+  void handle(const TurnOn &) {
+    switch (current) {
+    case Id::Off:
+      off.exit();
+      on.enter();
+      current = Id::On;
+      break;
+    case Id::On:
+      break;
+    }
+  }
+  void handle(const TurnOff &) {
+    switch (current) {
+    case Id::On:
+      on.exit();
+      off.enter();
+      current = Id::Off;
+      break;
+    case Id::Off:
+      break;
+    }
+  }
+};
+
+void BM_Sctl_SimpleFsm(benchmark::State &state) {
+  SimpleChart chart;
+  chart.instance.start();
+
+  InstructionCounter counter;
+  for (auto _ : state) {
+    chart.instance.handle(TurnOn{});
+    chart.instance.handle(TurnOff{});
+  }
+  benchmark::DoNotOptimize(chart.off.entered);
+  counter.report(state, 2);
+}
+BENCHMARK(BM_Sctl_SimpleFsm);
+
+void BM_Switch_SimpleFsm(benchmark::State &state) {
+  SimpleSwitch chart;
+
+  InstructionCounter counter;
+  for (auto _ : state) {
+    chart.handle(TurnOn{});
+    chart.handle(TurnOff{});
+  }
+  benchmark::DoNotOptimize(chart.off.entered);
+  counter.report(state, 2);
+}
+BENCHMARK(BM_Switch_SimpleFsm);
+
+// Complex chart from complex_state_chart.h, driven by variant events.
+
+using Event = std::variant<PowerOn, PowerOff, Initialized, Failure, Action,
+                           Timeout, Configure, Tick>;
+
+// Walks through every transition of the chart and comes back to Off state.
+const std::vector<Event> cycle{PowerOn{},   Initialized{}, Action{},
+                               Tick{},      Tick{},        Timeout{},
+                               Configure{}, Timeout{},     Failure{}};
+
+struct ComplexSwitch {
+  enum class Id { OffInternal, Init, Ready, Busy, Waiting };
+  enum class EventId {
+    PowerOn,
+    PowerOff,
+    Initialized,
+    Failure,
+    Action,
+    Timeout,
+    Configure,
+    Tick
+  };
+
+  StateBase off, off_internal, error, on, init, ready, busy, config,
+      processing, waiting;
+  unsigned ticks{0};
+  Id current{Id::OffInternal};
+
+  void handle(EventId e) {
+    switch (current) {
+    case Id::OffInternal:
+      switch (e) {
+      case EventId::Tick:
+        benchmark::DoNotOptimize(++ticks);
+        break;
+      case EventId::PowerOn:
+        off_internal.exit();
+        off.exit();
+        on.enter();
+        init.enter();
+        current = Id::Init;
+        break;
+      default:
+        break;
+      }
+      break;
+    case Id::Init:
+      if (e == EventId::Initialized) {
+        init.exit();
+        ready.enter();
+        current = Id::Ready;
+      } else {
+        handle_on(e, init);
+      }
+      break;
+    case Id::Ready:
+      switch (e) {
+      case EventId::Action:
+        ready.exit();
+        busy.enter();
+        current = Id::Busy;
+        break;
+      case EventId::Configure:
+        ready.exit();
+        config.enter();
+        processing.enter();
+        processing.exit();
+        waiting.enter();
+        current = Id::Waiting;
+        break;
+      default:
+        handle_on(e, ready);
+        break;
+      }
+      break;
+    case Id::Busy:
+      switch (e) {
+      case EventId::Timeout:
+        busy.exit();
+        ready.enter();
+        current = Id::Ready;
+        break;
+      case EventId::Tick:
+        busy.exit();
+        busy.enter();
+        break;
+      default:
+        handle_on(e, busy);
+        break;
+      }
+      break;
+    case Id::Waiting:
+      if (e == EventId::Timeout) {
+        waiting.exit();
+        config.exit();
+        ready.enter();
+        current = Id::Ready;
+      } else {
+        handle_on(e, waiting, &config);
+      }
+      break;
+    }
+  }
+
+  // Events handled by On state, leaving it from given leaf.
+  void handle_on(EventId e, StateBase &leaf, StateBase *parent = nullptr) {
+    if (e != EventId::PowerOff && e != EventId::Failure) {
+      return;
+    }
+    leaf.exit();
+    if (parent) {
+      parent->exit();
+    }
+    on.exit();
+    if (e == EventId::Failure) {
+      error.enter();
+      error.exit();
+    }
+    off.enter();
+    off_internal.enter();
+    current = Id::OffInternal;
+  }
+};
+
+void BM_Sctl_ComplexChart(benchmark::State &state) {
+  ComplexChart chart;
+  chart.instance.start();
+
+  InstructionCounter counter;
+  for (auto _ : state) {
+    for (const auto &event : cycle) {
+      chart.instance.handle(event);
+    }
+  }
+  benchmark::DoNotOptimize(chart.off.entered);
+  counter.report(state, cycle.size());
+}
+BENCHMARK(BM_Sctl_ComplexChart);
+
+void BM_Switch_ComplexChart(benchmark::State &state) {
+  ComplexSwitch chart;
+  std::vector<ComplexSwitch::EventId> events;
+  for (const auto &event : cycle) {
+    events.push_back(static_cast<ComplexSwitch::EventId>(event.index()));
+  }
+
+  InstructionCounter counter;
+  for (auto _ : state) {
+    for (const auto event : events) {
+      chart.handle(event);
+    }
+  }
+  benchmark::DoNotOptimize(chart.off.entered);
+  counter.report(state, events.size());
+}
+BENCHMARK(BM_Switch_ComplexChart);
+
+// Two branches four levels deep, Swap handled by top of each branch moves to
+// the deepest state of the other one: four exits and four enters.
+
+struct Swap {};
+
+struct Root;
+struct A1;
+struct A2;
+struct A3;
+struct A4;
+struct B1;
+struct B2;
+struct B3;
+struct B4;
+
+struct Root : StateBase {
+  using StartState = A1;
+};
+struct A1 : StateBase {
+  using ParentState = Root;
+  using StartState = A2;
+  auto handle(const Swap &) { return sctl::State<B4>{}; }
+};
+struct A2 : StateBase {
+  using ParentState = A1;
+  using StartState = A3;
+};
+struct A3 : StateBase {
+  using ParentState = A2;
+  using StartState = A4;
+};
+struct A4 : StateBase {
+  using ParentState = A3;
+};
+struct B1 : StateBase {
+  using ParentState = Root;
+  using StartState = B2;
+  auto handle(const Swap &) { return sctl::State<A4>{}; }
+};
+struct B2 : StateBase {
+  using ParentState = B1;
+  using StartState = B3;
+};
+struct B3 : StateBase {
+  using ParentState = B2;
+  using StartState = B4;
+};
+struct B4 : StateBase {
+  using ParentState = B3;
+};
+
+struct DeepChart {
+  Root root;
+  A1 a1;
+  A2 a2;
+  A3 a3;
+  A4 a4;
+  B1 b1;
+  B2 b2;
+  B3 b3;
+  B4 b4;
+  sctl::StateChart<Root, A1, A2, A3, A4, B1, B2, B3, B4> instance{
+      root, a1, a2, a3, a4, b1, b2, b3, b4};
+};
+
+struct DeepSwitch {
+  enum class Id { A4, B4 };
+
+  StateBase a1, a2, a3, a4, b1, b2, b3, b4;
+  Id current{Id::A4};
+
+  void handle(const Swap &) {
+    switch (current) {
+    case Id::A4:
+      a4.exit();
+      a3.exit();
+      a2.exit();
+      a1.exit();
+      b1.enter();
+      b2.enter();
+      b3.enter();
+      b4.enter();
+      current = Id::B4;
+      break;
+    case Id::B4:
+      b4.exit();
+      b3.exit();
+      b2.exit();
+      b1.exit();
+      a1.enter();
+      a2.enter();
+      a3.enter();
+      a4.enter();
+      current = Id::A4;
+      break;
+    }
+  }
+};
+
+void BM_Sctl_DeepHierarchy(benchmark::State &state) {
+  DeepChart chart;
+  chart.instance.start();
+
+  InstructionCounter counter;
+  for (auto _ : state) {
+    chart.instance.handle(Swap{});
+  }
+  benchmark::DoNotOptimize(chart.a4.entered);
+  counter.report(state, 1);
+}
+BENCHMARK(BM_Sctl_DeepHierarchy);
+
+void BM_Switch_DeepHierarchy(benchmark::State &state) {
+  DeepSwitch chart;
+
+  InstructionCounter counter;
+  for (auto _ : state) {
+    chart.handle(Swap{});
+  }
+  benchmark::DoNotOptimize(chart.a4.entered);
+  counter.report(state, 1);
+}
+BENCHMARK(BM_Switch_DeepHierarchy);
+
+// Go enters R0 which redirects from enter() through R1 and R2 to R3, Back
+// returns to Idle.
+
+struct Go {};
+struct Back {};
+
+struct Idle;
+struct R0;
+struct R1;
+struct R2;
+struct R3;
+
+struct Idle : StateBase {
+  auto handle(const Go &) { return sctl::State<R0>{}; }
+};
+struct R0 : StateBase {
+  auto enter() {
+    StateBase::enter();
+    return sctl::State<R1>{};
+  }
+};
+struct R1 : StateBase {
+  auto enter() {
+    StateBase::enter();
+    return sctl::State<R2>{};
+  }
+};
+struct R2 : StateBase {
+  auto enter() {
+    StateBase::enter();
+    return sctl::State<R3>{};
+  }
+};
+struct R3 : StateBase {
+  auto handle(const Back &) { return sctl::State<Idle>{}; }
+};
+
+struct RedirectChart {
+  Idle idle;
+  R0 r0;
+  R1 r1;
+  R2 r2;
+  R3 r3;
+  sctl::StateChart<Idle, R0, R1, R2, R3> instance{idle, r0, r1, r2, r3};
+};
+
+struct RedirectSwitch {
+  enum class Id { Idle, R3 };
+
+  StateBase idle, r0, r1, r2, r3;
+  Id current{Id::Idle};
+
+  void handle(const Go &) {
+    switch (current) {
+    case Id::Idle:
+      idle.exit();
+      r0.enter();
+      r0.exit();
+      r1.enter();
+      r1.exit();
+      r2.enter();
+      r2.exit();
+      r3.enter();
+      current = Id::R3;
+      break;
+    case Id::R3:
+      break;
+    }
+  }
+  void handle(const Back &) {
+    switch (current) {
+    case Id::R3:
+      r3.exit();
+      idle.enter();
+      current = Id::Idle;
+      break;
+    case Id::Idle:
+      break;
+    }
+  }
+};
+
+void BM_Sctl_EnterRedirects(benchmark::State &state) {
+  RedirectChart chart;
+  chart.instance.start();
+
+  InstructionCounter counter;
+  for (auto _ : state) {
+    chart.instance.handle(Go{});
+    chart.instance.handle(Back{});
+  }
+  benchmark::DoNotOptimize(chart.r3.entered);
+  counter.report(state, 2);
+}
+BENCHMARK(BM_Sctl_EnterRedirects);
+
+void BM_Switch_EnterRedirects(benchmark::State &state) {
+  RedirectSwitch chart;
+
+  InstructionCounter counter;
+  for (auto _ : state) {
+    chart.handle(Go{});
+    chart.handle(Back{});
+  }
+  benchmark::DoNotOptimize(chart.r3.entered);
+  counter.report(state, 2);
+}
+BENCHMARK(BM_Switch_EnterRedirects);
+
+} // namespace
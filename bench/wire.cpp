@@ -0,0 +1,115 @@
+#include "sctl_wire.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <vector>
+
+/*
+ Events read from buffer of (wire id, payload) records, as written by
+ producer into shared memory: copied into struct before handle() versus
+ handled in place by handle_raw().
+*/
+
+namespace {
+
+struct Sample {
+  static constexpr std::uint32_t wire_id = 1;
+  std::uint64_t values[8];
+};
+struct Reset {
+  static constexpr std::uint32_t wire_id = 2;
+  std::uint64_t base;
+};
+
+struct Summing {
+  std::uint64_t sum{0};
+  void handle(const Sample &s) {
+    for (const auto v : s.values) {
+      sum += v;
+    }
+  }
+  void handle(const Reset &r) { sum = r.base; }
+};
+
+using SumSC = sctl::StateChart<Summing>;
+using Wire = sctl::WireEvents<Sample, Reset>;
+
+struct Record {
+  std::uint32_t id;
+  std::uint32_t size;
+  std::size_t offset;
+};
+
+struct Buffer {
+  std::vector<std::uint64_t> storage;
+  std::vector<Record> records;
+
+  template <typename Event> void append(const Event &e) {
+    const std::size_t offset = storage.size() * sizeof(std::uint64_t);
+    storage.resize(storage.size() + sizeof(Event) / sizeof(std::uint64_t));
+    std::memcpy(reinterpret_cast<std::byte *>(storage.data()) + offset, &e,
+                sizeof(Event));
+    records.push_back({Event::wire_id, sizeof(Event), offset});
+  }
+
+  std::span<const std::byte> payload(const Record &r) const {
+    return {reinterpret_cast<const std::byte *>(storage.data()) + r.offset,
+            r.size};
+  }
+};
+
+Buffer make_buffer() {
+  Buffer buffer;
+  for (std::uint64_t i = 0; i < 1024; ++i) {
+    if (i % 16 == 0) {
+      buffer.append(Reset{i});
+    } else {
+      buffer.append(Sample{{i, i, i, i, i, i, i, i}});
+    }
+  }
+  return buffer;
+}
+
+void BM_Wire_CopyThenHandle(benchmark::State &state) {
+  const Buffer buffer = make_buffer();
+  Summing summing;
+  SumSC chart{summing};
+  chart.start();
+
+  for (auto _ : state) {
+    for (const auto &r : buffer.records) {
+      const auto bytes = buffer.payload(r);
+      if (r.id == Sample::wire_id && r.size == sizeof(Sample)) {
+        Sample s;
+        std::memcpy(&s, bytes.data(), sizeof(s));
+        chart.handle(s);
+      } else if (r.id == Reset::wire_id && r.size == sizeof(Reset)) {
+        Reset e;
+        std::memcpy(&e, bytes.data(), sizeof(e));
+        chart.handle(e);
+      }
+    }
+  }
+  benchmark::DoNotOptimize(summing.sum);
+  state.SetItemsProcessed(state.iterations() * buffer.records.size());
+}
+BENCHMARK(BM_Wire_CopyThenHandle);
+
+void BM_Wire_HandleRaw(benchmark::State &state) {
+  const Buffer buffer = make_buffer();
+  Summing summing;
+  SumSC chart{summing};
+  chart.start();
+
+  for (auto _ : state) {
+    for (const auto &r : buffer.records) {
+      chart.handle_raw<Wire>(r.id, buffer.payload(r));
+    }
+  }
+  benchmark::DoNotOptimize(summing.sum);
+  state.SetItemsProcessed(state.iterations() * buffer.records.size());
+}
+BENCHMARK(BM_Wire_HandleRaw);
+
+} // namespace
@@ -1,8 +1,27 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <string_view>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 #include <variant>
 
+// Public functions of state chart are noexcept when built without exceptions
+// (-fno-exceptions), e.g. for firmware. Otherwise exceptions thrown by
+// handlers, enter() and exit() pass through.
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+#define SCTL_NOEXCEPT
+#else
+#define SCTL_NOEXCEPT noexcept
+#endif
+
 namespace sctl {
 
 template <typename S> struct State {
@@ -13,6 +32,144 @@ template <typename S> struct State {
 struct NoAction {};
 struct KeepState : State<NoAction> {};
 
+// Observer notified by StateChart about handled events and performed
+// transitions, before exit() and enter() of states are called. Calls of
+// state handle(), exit() and enter() go through around_* callbacks, which
+// have to invoke given function and return its result. State index is
+// position of state in StateChart parameters.
+// This one does nothing, derive from it to implement only some callbacks.
+struct NoObserver {
+  template <typename Event> void on_event(const Event &) {}
+  template <typename S> void on_exit(std::size_t) {}
+  template <typename S> void on_enter(std::size_t) {}
+  template <typename From, typename To>
+  void on_transition(std::size_t, std::size_t) {}
+  // Deferred event that did not fit in storage of deferred events.
+  template <typename Event> void on_defer_overflow(const Event &) {}
+
+  template <typename S, typename Event, typename Handle>
+  decltype(auto) around_handle(std::size_t, const Event &, Handle &&handle) {
+    return handle();
+  }
+  template <typename S, typename Exit>
+  void around_exit(std::size_t, Exit &&exit) {
+    exit();
+  }
+  template <typename S, typename Enter>
+  decltype(auto) around_enter(std::size_t, Enter &&enter) {
+    return enter();
+  }
+};
+
+// Observer notifying each of Observers in order, so that chart can have
+// more of them, e.g. timers and tracing. around_* callbacks are nested, first
+// observer outermost. Observers have distinct types, get<O>() returns one.
+template <typename... Observers> class CompositeObserver {
+public:
+  explicit CompositeObserver(Observers... observers)
+      : _observers{std::move(observers)...} {}
+
+  template <typename O> O &get() { return std::get<O>(_observers); }
+
+  template <typename Event> void on_event(const Event &e) {
+    std::apply([&e](auto &...o) { (o.on_event(e), ...); }, _observers);
+  }
+  template <typename S> void on_exit(std::size_t index) {
+    std::apply([index](auto &...o) { (o.template on_exit<S>(index), ...); },
+               _observers);
+  }
+  template <typename S> void on_enter(std::size_t index) {
+    std::apply([index](auto &...o) { (o.template on_enter<S>(index), ...); },
+               _observers);
+  }
+  template <typename From, typename To>
+  void on_transition(std::size_t from, std::size_t to) {
+    std::apply(
+        [from, to](auto &...o) {
+          (o.template on_transition<From, To>(from, to), ...);
+        },
+        _observers);
+  }
+  template <typename Event> void on_defer_overflow(const Event &e) {
+    std::apply([&e](auto &...o) { (o.on_defer_overflow(e), ...); },
+               _observers);
+  }
+
+  template <typename S, typename Event, typename Handle>
+  decltype(auto) around_handle(std::size_t index, const Event &e,
+                               Handle &&handle) {
+    return around_handle_from<0, S>(index, e, handle);
+  }
+  template <typename S, typename Exit>
+  void around_exit(std::size_t index, Exit &&exit) {
+    around_exit_from<0, S>(index, exit);
+  }
+  template <typename S, typename Enter>
+  decltype(auto) around_enter(std::size_t index, Enter &&enter) {
+    return around_enter_from<0, S>(index, enter);
+  }
+
+private:
+  template <std::size_t I, typename S, typename Event, typename Handle>
+  decltype(auto) around_handle_from(std::size_t index, const Event &e,
+                                    Handle &handle) {
+    if constexpr (I == sizeof...(Observers)) {
+      return handle();
+    } else {
+      return std::get<I>(_observers).template around_handle<S>(
+          index, e, [this, index, &e, &handle]() -> decltype(auto) {
+            return around_handle_from<I + 1, S>(index, e, handle);
+          });
+    }
+  }
+  template <std::size_t I, typename S, typename Exit>
+  void around_exit_from(std::size_t index, Exit &exit) {
+    if constexpr (I == sizeof...(Observers)) {
+      exit();
+    } else {
+      std::get<I>(_observers).template around_exit<S>(
+          index, [this, index, &exit] { around_exit_from<I + 1, S>(index, exit); });
+    }
+  }
+  template <std::size_t I, typename S, typename Enter>
+  decltype(auto) around_enter_from(std::size_t index, Enter &enter) {
+    if constexpr (I == sizeof...(Observers)) {
+      return enter();
+    } else {
+      return std::get<I>(_observers).template around_enter<S>(
+          index, [this, index, &enter]() -> decltype(auto) {
+            return around_enter_from<I + 1, S>(index, enter);
+          });
+    }
+  }
+
+  std::tuple<Observers...> _observers;
+};
+
+// Passed as first StateChart parameter to install observer.
+template <typename Observer> struct WithObserver {};
+
+// Passed as first StateChart parameter to let handle() and enter() of states
+// return sctl::Task from sctl_task.h, transition continues when task
+// completes and events handled meanwhile are queued until then.
+template <typename Observer = NoObserver> struct Async {};
+
+// Passed as first StateChart parameter to make chart instance only active
+// state and Context object. States have to be empty, all data of chart is in
+// context, which they get as first argument of handle(), enter() and exit().
+template <typename Context, typename Observer = NoObserver>
+struct WithContext {};
+
+// Declared as `using Regions = sctl::Regions<R...>` by composite state that
+// has orthogonal regions instead of StartState. Every region is a sub state,
+// its sub states belong to that region.
+template <typename... R> struct Regions {};
+
+// Declared as `using Deferred = sctl::Deferred<Events...>` by state that
+// postpones Events, unless state below it in parent chain handles them.
+// Deferred events are dispatched again, in order, when active state changes.
+template <typename... Events> struct Deferred {};
+
 namespace details {
 
 template <typename state> concept Substate = requires {
@@ -21,228 +178,2148 @@ template <typename state> concept Substate = requires {
 template <typename state> concept HasStartState = requires {
   typename state::StartState;
 };
+template <typename state> concept HasRegions = requires {
+  typename state::Regions;
+};
+template <typename state> concept HasDeferred = requires {
+  typename state::Deferred;
+};
+template <typename state> concept RegionRoot =
+    Substate<state> && HasRegions<typename state::ParentState>;
 
 template <typename state> concept HasEntryAction = requires {
   state{}.enter();
 };
 
+template <typename state> concept HasEnter = requires(state &s) { s.enter(); };
+template <typename state> concept HasExit = requires(state &s) { s.exit(); };
+
+// Actions of states of chart with context take it as first argument, Context
+// is void for other charts.
+template <typename S, typename E, typename Context> concept CanHandle =
+    (std::is_void<Context>::value &&
+     requires(S &s, const E &e) { s.handle(e); }) ||
+    requires(S &s, Context &c, const E &e) { s.handle(c, e); };
+template <typename S, typename Context> concept CanEnter =
+    (std::is_void<Context>::value && HasEnter<S>) ||
+    requires(S &s, Context &c) { s.enter(c); };
+template <typename S, typename Context> concept CanExit =
+    (std::is_void<Context>::value && HasExit<S>) ||
+    requires(S &s, Context &c) { s.exit(c); };
+
 template <typename state, typename action> concept HasHandler = requires {
   state{}.handle(action{});
 };
 
+// Handler that can be evaluated at compile time, so it has no side effects
+// other than returned value.
+template <typename state, typename action> concept HasConstantHandler =
+    requires {
+  typename std::integral_constant<bool,
+                                  (state{}.handle(action{}), true)>;
+};
+
 template <typename T>
 concept IsStateWrapper = std::is_same<State<typename T::type>, T>::value;
 
-} // namespace details
+template <typename T> struct IsVariantType : std::false_type {};
+template <typename... Ts>
+struct IsVariantType<std::variant<Ts...>> : std::true_type {};
+template <typename T> concept IsVariant = IsVariantType<T>::value;
+
+// Variant left valueless by exception holds no event. Like std::visit it
+// throws std::bad_variant_access then, without exceptions event is ignored.
+template <typename... Events>
+bool holds_event(const std::variant<Events...> &e) {
+  if (!e.valueless_by_exception()) {
+    return true;
+  }
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+  throw std::bad_variant_access{};
+#else
+  return false;
+#endif
+}
+
+// Type list that is cheap to instantiate regardless of length, unlike
+// std::tuple. Element lookup goes through base class deduction instead of
+// recursive templates.
+template <std::size_t I, typename T> struct Indexed {};
+
+template <std::size_t I, typename T> std::type_identity<T> pick(Indexed<I, T>);
+
+template <typename T, std::size_t I>
+constexpr std::size_t position(Indexed<I, T>) {
+  return I;
+}
+
+template <typename Sequence, typename... Ts> struct IndexedList;
+template <std::size_t... I, typename... Ts>
+struct IndexedList<std::index_sequence<I...>, Ts...> : Indexed<I, Ts>... {};
+
+template <typename... Ts> struct TypeList;
+
+// Concatenation, for use in unevaluated fold expressions only.
+template <typename... A, typename... B>
+TypeList<A..., B...> operator+(TypeList<A...>, TypeList<B...>);
+
+template <typename... Ts> struct TypeList {
+  static constexpr std::size_t size = sizeof...(Ts);
+
+  using indexed = IndexedList<std::index_sequence_for<Ts...>, Ts...>;
+
+  template <typename T> using append = TypeList<Ts..., T>;
+  template <std::size_t I>
+  using at = typename decltype(pick<I>(indexed{}))::type;
+
+  template <typename T> static constexpr bool contains() {
+    return requires { position<T>(indexed{}); };
+  }
+  template <typename T> static constexpr std::size_t index_of() {
+    return position<T>(indexed{});
+  }
+};
+
+template <typename T> struct RegionList { using type = TypeList<>; };
+template <HasRegions S> struct RegionList<S> {
+  using type = decltype([]<typename... R>(Regions<R...>) {
+    return TypeList<R...>{};
+  }(typename S::Regions{}));
+};
 
-template <typename... States> class StateChart {
+// Region sub state S belongs to, void outside of regions.
+template <typename S> struct RegionOf { using type = void; };
+template <Substate S>
+struct RegionOf<S> : RegionOf<typename S::ParentState> {};
+template <RegionRoot S> struct RegionOf<S> { using type = S; };
+
+// State with regions that S is part of, void outside of regions.
+template <typename S> struct OrthogonalOf {
+  using type = typename RegionOf<S>::type::ParentState;
+};
+template <typename S>
+requires std::is_void<typename RegionOf<S>::type>::value
+struct OrthogonalOf<S> { using type = void; };
+
+template <typename S> struct DeferredList { using type = TypeList<>; };
+template <HasDeferred S> struct DeferredList<S> {
+  using type = decltype([]<typename... E>(Deferred<E...>) {
+    return TypeList<E...>{};
+  }(typename S::Deferred{}));
+};
+
+template <typename S, typename E>
+concept Defers = DeferredList<S>::type::template contains<E>();
+
+// List without repeated types, first occurrence is kept.
+template <typename Unique, typename... Ts> struct UniqueList {
+  using type = Unique;
+};
+template <typename... U, typename T, typename... Ts>
+struct UniqueList<TypeList<U...>, T, Ts...>
+    : UniqueList<typename std::conditional<
+                     TypeList<U...>::template contains<T>(), TypeList<U...>,
+                     TypeList<U..., T>>::type,
+                 Ts...> {};
+template <typename List> struct Unique;
+template <typename... Ts> struct Unique<TypeList<Ts...>> {
+  using type = typename UniqueList<TypeList<>, Ts...>::type;
+};
+
+// Task returned from handle() or enter(), see sctl_task.h. Its task_result
+// is usual handle() or enter() result it completes with.
+template <typename T> concept IsTask = requires {
+  typename T::task_result;
+};
+
+template <typename T> struct RedirectTargets { using type = std::tuple<>; };
+template <IsTask T>
+struct RedirectTargets<T> : RedirectTargets<typename T::task_result> {};
+template <typename S> struct RedirectTargets<State<S>> {
+  using type = std::tuple<State<S>>;
+};
+template <> struct RedirectTargets<State<NoAction>> {
+  using type = std::tuple<>;
+};
+template <> struct RedirectTargets<KeepState> { using type = std::tuple<>; };
+template <typename... Alternatives>
+struct RedirectTargets<std::variant<Alternatives...>> {
+  using type = decltype(std::tuple_cat(
+      typename RedirectTargets<Alternatives>::type{}...));
+};
+
+template <std::size_t Max> struct SmallestIndex {
+  using type = std::conditional<
+      Max <= 0xff, std::uint8_t,
+      typename std::conditional<Max <= 0xffff, std::uint16_t,
+                                std::uint32_t>::type>::type;
+};
+
+// Name of type as spelled by compiler in signature of this function.
+template <typename T> constexpr std::string_view spelled_type_name() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  constexpr std::string_view signature = __FUNCSIG__;
+  constexpr std::string_view prefix = "spelled_type_name<";
+  constexpr std::string_view suffix = ">(void)";
+#else
+  constexpr std::string_view signature = __PRETTY_FUNCTION__;
+  constexpr std::string_view prefix = "T = ";
+  constexpr std::string_view suffix =
+      signature.find(';', signature.find(prefix)) == std::string_view::npos
+          ? "]"
+          : ";";
+#endif
+  constexpr std::size_t begin = signature.find(prefix) + prefix.size();
+  return signature.substr(begin, signature.find(suffix, begin) - begin);
+}
+
+// Copies name to out (when not null) leaving out "struct ", "class ", "enum "
+// and "union " that MSVC puts before every class type, template arguments
+// included. Returns length of result.
+constexpr std::size_t strip_elaborated(std::string_view name, char *out) {
+  constexpr std::string_view keywords[] = {"struct ", "class ", "enum ",
+                                           "union "};
+  const auto identifier = [](char c) {
+    return c == '_' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+           (c >= 'A' && c <= 'Z');
+  };
+  std::size_t size = 0;
+  for (std::size_t i = 0; i < name.size();) {
+    if (i == 0 || !identifier(name[i - 1])) {
+      const auto *keyword = std::find_if(
+          std::begin(keywords), std::end(keywords),
+          [&](std::string_view k) { return name.substr(i).starts_with(k); });
+      if (keyword != std::end(keywords)) {
+        i += keyword->size();
+        continue;
+      }
+    }
+    if (out) {
+      out[size] = name[i];
+    }
+    ++size;
+    ++i;
+  }
+  return size;
+}
+
+template <typename T> struct StrippedTypeName {
+  static constexpr std::string_view spelled = spelled_type_name<T>();
+  static constexpr auto value = [] {
+    std::array<char, strip_elaborated(spelled, nullptr)> name{};
+    strip_elaborated(spelled, name.data());
+    return name;
+  }();
+};
+
+// Name of type without elaborated type specifiers, e.g. "sctl::NoAction", the
+// same on every compiler for types that are not templates.
+template <typename T> constexpr std::string_view type_name() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  constexpr const auto &name = StrippedTypeName<T>::value;
+  return {name.data(), name.size()};
+#else
+  return spelled_type_name<T>();
+#endif
+}
+
+// 64-bit FNV-1a.
+constexpr std::uint64_t hash(std::string_view text,
+                             std::uint64_t h = 0xcbf29ce484222325) {
+  for (const char c : text) {
+    h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+  }
+  return h;
+}
+
+// Fixed capacity FIFO of events of any of Events types, stored one after
+// another in single buffer, each one preceded by tag holding position of its
+// type in Events. Room for Records events of the largest type.
+template <std::size_t Records, typename List> class DeferredArena;
+template <std::size_t Records> class DeferredArena<Records, TypeList<>> {
 public:
-  StateChart(States &...states) : _states{states...} {}
+  static constexpr std::size_t capacity = 0;
 
-  void start(bool call_entry = false) {
-    using StartingState =
-        typename std::tuple_element<0, std::tuple<States...>>::type;
-    using DestinationState = typename resolve_start_state<StartingState>::type;
-    using StartChain = typename parent_chain<DestinationState>::type;
+  struct Image {};
+  void save(Image &) const {}
+  bool load(const Image &) { return true; }
+};
+template <std::size_t Records, typename... Events>
+class DeferredArena<Records, TypeList<Events...>> {
+  using Tag = typename SmallestIndex<sizeof...(Events)>::type;
 
-    if (call_entry) {
-      const auto [from, to] = std::apply(
-          [this](auto &&...args) {
-            return call_enter_on_chain_exit_when_return(args...);
-          },
-          StartChain{});
+  static constexpr std::size_t align =
+      std::max({alignof(Tag), alignof(Events)...});
+  template <typename E>
+  static constexpr std::size_t offset =
+      (sizeof(Tag) + alignof(E) - 1) / alignof(E) * alignof(E);
+  template <typename E>
+  static constexpr std::size_t stride =
+      (offset<E> + sizeof(E) + align - 1) / align * align;
 
-      _current = from == to ? to : transition(from, to);
-    } else {
-      _current = State<DestinationState>{};
+public:
+  static constexpr std::size_t capacity =
+      Records * std::max({stride<Events>...});
+
+  DeferredArena() = default;
+  DeferredArena(const DeferredArena &) = delete;
+  DeferredArena &operator=(const DeferredArena &) = delete;
+  ~DeferredArena() {
+    while (_count) {
+      pop([](const auto &) {});
     }
   }
 
-  template <typename Event> void handle(const Event &e) {
-    const auto transition_to = std::visit(
-        [this, &e](auto &&state) -> StateActionVariant {
-          using CurrentState = std::decay<decltype(state)>::type::type;
-          return call_handle_on_chain<CurrentState>(e);
-        },
-        _current);
+  std::size_t size() const { return _count; }
+  bool empty() const { return _count == 0; }
+
+  // Copy of stored events, taken and loaded by plain copy of bytes, so events
+  // have to be trivially copyable.
+  struct Image {
+    std::uint32_t count;
+    std::uint32_t size;
+    alignas(align) std::byte bytes[capacity];
+  };
+
+  void save(Image &image) const {
+    static_assert((std::is_trivially_copyable<Events>::value && ...),
+                  "deferred events have to be trivially copyable to be saved");
+    image.count = static_cast<std::uint32_t>(_count);
+    image.size = static_cast<std::uint32_t>(_end - _begin);
+    std::memcpy(image.bytes, _bytes + _begin, _end - _begin);
+    std::memset(image.bytes + image.size, 0, capacity - image.size);
+  }
+
+  // Replaces stored events, returns false leaving them unchanged when image
+  // is corrupt.
+  bool load(const Image &image) {
+    static_assert((std::is_trivially_copyable<Events>::value && ...),
+                  "deferred events have to be trivially copyable to be loaded");
+    static constexpr std::array<std::size_t, sizeof...(Events)> strides{
+        stride<Events>...};
+    std::size_t at = 0;
+    std::size_t count = 0;
+    while (at < image.size && at + sizeof(Tag) <= capacity) {
+      Tag tag;
+      std::memcpy(&tag, image.bytes + at, sizeof(Tag));
+      if (tag >= sizeof...(Events)) {
+        return false;
+      }
+      at += strides[tag];
+      ++count;
+    }
+    if (at != image.size || at > capacity || count != image.count) {
+      return false;
+    }
+    std::memcpy(_bytes, image.bytes, image.size);
+    _begin = 0;
+    _end = image.size;
+    _count = image.count;
+    return true;
+  }
+
+  // Returns false when there is no room left for event.
+  template <typename E> bool push(const E &e) {
+    if (_end + stride<E> > capacity) {
+      compact();
+      if (_end + stride<E> > capacity) {
+        return false;
+      }
+    }
+    const Tag tag = TypeList<Events...>::template index_of<E>();
+    std::memcpy(_bytes + _end, &tag, sizeof(Tag));
+    new (_bytes + _end + offset<E>) E(e);
+    _end += stride<E>;
+    ++_count;
+    return true;
+  }
 
-    _current = transition(_current, transition_to);
+  // Removes oldest event and passes it to f, f can push and pop.
+  template <typename F> void pop(F &&f) {
+    using Take = void (*)(DeferredArena &, F &);
+    static constexpr std::array<Take, sizeof...(Events)> table{
+        &take<Events, F>...};
+    table[tag_at(_begin)](*this, f);
   }
 
 private:
-  using StateActionVariant = std::variant<KeepState, State<States>...>;
-
-  std::tuple<States &...> _states;
-  StateActionVariant _current{KeepState{}};
-
-  StateActionVariant transition(const StateActionVariant &from_state,
-                                const StateActionVariant &to_state) {
-    const auto [from, to] = std::visit(
-        [this](auto &&from,
-               auto &&to) -> std::pair<StateActionVariant, StateActionVariant> {
-          using StateFrom = std::decay<decltype(from)>::type::type;
-          using StateTo = std::decay<decltype(to)>::type::type;
-          using StateToResolved = typename resolve_start_state<StateTo>::type;
-
-          if constexpr (std::is_same<StateTo, NoAction>::value) {
-            return {from, from};
-          } else {
-            return transition_step<StateFrom, StateToResolved>();
-          }
-        },
-        from_state, to_state);
-    if (from == to) {
-      return to;
+  Tag tag_at(std::size_t at) const {
+    Tag tag;
+    std::memcpy(&tag, _bytes + at, sizeof(Tag));
+    return tag;
+  }
+
+  template <typename E> E *event_at(std::size_t at) {
+    return std::launder(reinterpret_cast<E *>(_bytes + at + offset<E>));
+  }
+
+  template <typename E, typename F>
+  static void take(DeferredArena &arena, F &f) {
+    E *stored = arena.event_at<E>(arena._begin);
+    const E event{std::move(*stored)};
+    stored->~E();
+    arena._begin += stride<E>;
+    if (!--arena._count) {
+      arena._begin = arena._end = 0;
+    }
+    f(event);
+  }
+
+  // Moves events to beginning of buffer, making room freed by pop() usable.
+  void compact() {
+    if constexpr ((std::is_trivially_copyable<Events>::value && ...)) {
+      std::memmove(_bytes, _bytes + _begin, _end - _begin);
     } else {
-      return transition(from, to);
+      using Move = void (*)(DeferredArena &, std::size_t, std::size_t);
+      static constexpr std::array<Move, sizeof...(Events)> table{
+          &move_down<Events>...};
+      static constexpr std::array<std::size_t, sizeof...(Events)> strides{
+          stride<Events>...};
+      for (std::size_t at = _begin; at < _end;) {
+        const Tag tag = tag_at(at);
+        table[tag](*this, at, at - _begin);
+        at += strides[tag];
+      }
     }
+    _end -= _begin;
+    _begin = 0;
+  }
+
+  // Source and destination may overlap, so event is moved through temporary.
+  template <typename E>
+  static void move_down(DeferredArena &arena, std::size_t from,
+                        std::size_t to) {
+    E *stored = arena.event_at<E>(from);
+    E event{std::move(*stored)};
+    stored->~E();
+    std::memmove(arena._bytes + to, arena._bytes + from, sizeof(Tag));
+    new (arena._bytes + to + offset<E>) E(std::move(event));
+  }
+
+  alignas(align) std::byte _bytes[capacity];
+  std::size_t _begin{0};
+  std::size_t _end{0};
+  std::size_t _count{0};
+};
+
+template <typename S, typename Context> struct EnterResult {
+  using type = void;
+};
+template <typename S, typename Context>
+requires(std::is_void<Context>::value && HasEnter<S>)
+struct EnterResult<S, Context> {
+  using type = decltype(std::declval<S &>().enter());
+};
+template <typename S, typename Context>
+requires requires(S &s, Context &c) { s.enter(c); }
+struct EnterResult<S, Context> {
+  using type = decltype(std::declval<S &>().enter(std::declval<Context &>()));
+};
+
+template <typename S, typename E, typename Context> struct HandleResult {
+  using type = KeepState;
+};
+template <typename S, typename E, typename Context>
+requires(std::is_void<Context>::value &&
+         requires(S &s, const E &e) { s.handle(e); })
+struct HandleResult<S, E, Context> {
+  using type = decltype(std::declval<S &>().handle(std::declval<const E &>()));
+};
+template <typename S, typename E, typename Context>
+requires requires(S &s, Context &c, const E &e) { s.handle(c, e); }
+struct HandleResult<S, E, Context> {
+  using type = decltype(std::declval<S &>().handle(std::declval<Context &>(),
+                                                   std::declval<const E &>()));
+};
+
+template <typename S, typename Leaf> constexpr bool in_chain() {
+  if constexpr (std::is_same<S, Leaf>::value) {
+    return true;
+  } else if constexpr (Substate<Leaf>) {
+    return in_chain<S, typename Leaf::ParentState>();
+  } else {
+    return false;
   }
+}
 
-  template <typename StateFrom, typename StateTo>
-  std::pair<StateActionVariant, StateActionVariant> transition_step() {
-    using FromChain = typename parent_chain<StateFrom>::type;
-    using ToChain = typename parent_chain<StateTo>::type;
+template <typename S, typename E, typename Context> struct HandlerOnChain {
+  using type = S;
+};
+template <Substate S, typename E, typename Context>
+requires(!RegionRoot<S> && !CanHandle<S, E, Context>)
+struct HandlerOnChain<S, E, Context>
+    : HandlerOnChain<typename S::ParentState, E, Context> {};
 
-    using Chains = reduce_common_starting_types<FromChain, ToChain>;
+template <typename S> struct ResolveStartState { using type = S; };
+template <HasStartState S>
+struct ResolveStartState<S> : ResolveStartState<typename S::StartState> {};
 
-    using ExitChain = tuple_or<typename Chains::type_a, State<StateFrom>>::type;
-    using EnterChain = tuple_or<typename Chains::type_b, State<StateTo>>::type;
+// True if there are targets and none of them is Owner or its substate.
+template <typename Owner, typename Targets> struct TargetsOutside {
+  static constexpr bool value = false;
+};
+template <typename Owner, typename... T>
+struct TargetsOutside<Owner, std::tuple<State<T>...>> {
+  static constexpr bool value =
+      sizeof...(T) > 0 &&
+      (!in_chain<Owner, typename ResolveStartState<T>::type>() && ...);
+};
 
-    ExitChain exit_chain{};
-    EnterChain enter_chain{};
+// Parent of S, void for top level state.
+template <typename S> struct ParentOf { using type = void; };
+template <Substate S> struct ParentOf<S> {
+  using type = typename S::ParentState;
+};
 
-    std::apply(
-        [this](auto &&...args) {
-          // ugly trick to call tuple args in reverse order
-          int dummy;
-          ((call_exit(args), dummy) = ... = 0);
-        },
-        exit_chain);
+// Number of parents of S.
+template <typename S> struct Depth : std::integral_constant<std::size_t, 0> {};
+template <Substate S>
+struct Depth<S>
+    : std::integral_constant<std::size_t,
+                             Depth<typename S::ParentState>::value + 1> {};
 
-    return std::apply(
-        [this](auto &&...args) {
-          return call_enter_on_chain_exit_when_return(args...);
-        },
-        enter_chain);
+// S is below Stop on parent chain of S, void Stop is above top level states.
+template <typename S, typename Stop>
+concept Below = !std::is_void<S>::value &&
+                (std::is_void<Stop>::value ||
+                 Depth<S>::value > Depth<Stop>::value);
+
+// Lowest state that is A or parent of A and also B or parent of B, void when
+// there is none.
+template <typename A, typename B> constexpr auto common_parent() {
+  if constexpr (std::is_same<A, B>::value) {
+    return std::type_identity<A>{};
+  } else if constexpr (Depth<A>::value > Depth<B>::value) {
+    return common_parent<typename A::ParentState, B>();
+  } else if constexpr (Depth<B>::value > Depth<A>::value) {
+    return common_parent<A, typename B::ParentState>();
+  } else if constexpr (Substate<A>) {
+    return common_parent<typename A::ParentState, typename B::ParentState>();
+  } else {
+    return std::type_identity<void>{};
   }
+}
 
-  template <typename S, typename... Rest>
-  std::pair<StateActionVariant, StateActionVariant>
-  call_enter_on_chain_exit_when_return(S &&s, Rest &&...rest) {
-    if constexpr (requires {
-                    { convert_to_variant(call_enter(std::forward<S>(s))) }
-                    ->std::convertible_to<StateActionVariant>;
-                  }) {
-      const auto new_state = call_enter(std::forward<S>(s));
-      using NewStateType = std::decay<decltype(new_state)>::type;
+// Transition from From to To exits states from ExitFrom up to, without,
+// ExitStop, innermost first, and enters states below EnterStop down to
+// EnterTo, outermost first. State with regions that is exited or entered as
+// a whole exits or enters its regions, states in them are not on the way.
+template <typename From, typename To> struct TransitionBounds {
+  using Common = typename decltype(common_parent<From, To>())::type;
+  using ExitStop =
+      typename std::conditional<std::is_same<Common, From>::value,
+                                typename ParentOf<From>::type, Common>::type;
+  using Above =
+      typename std::conditional<std::is_same<Common, To>::value,
+                                typename ParentOf<To>::type, Common>::type;
 
-      if constexpr (details::IsStateWrapper<NewStateType>) {
-        if constexpr (!std::is_same<NewStateType, KeepState>::value) {
-          return {s, new_state};
-        }
+  using FromOrthogonal = typename OrthogonalOf<From>::type;
+  using ToOrthogonal = typename OrthogonalOf<To>::type;
+  static_assert(
+      std::is_void<ToOrthogonal>::value ||
+          !std::is_same<FromOrthogonal, ToOrthogonal>::value ||
+          std::is_same<typename RegionOf<From>::type,
+                       typename RegionOf<To>::type>::value,
+      "transition between orthogonal regions of the same state");
+
+  // Exited state with regions is entered again as a whole.
+  static constexpr bool reenter =
+      Below<ToOrthogonal, ExitStop> && in_chain<ToOrthogonal, From>();
+
+  using ExitFrom = typename std::conditional<
+      Below<FromOrthogonal, ExitStop>, FromOrthogonal,
+      typename std::conditional<std::is_same<FromOrthogonal, To>::value,
+                                ExitStop, From>::type>::type;
+  using EnterStop = typename std::conditional<
+      reenter, typename ParentOf<ToOrthogonal>::type, Above>::type;
+  using EnterTo =
+      typename std::conditional<reenter || Below<ToOrthogonal, Above>,
+                                ToOrthogonal, To>::type;
+};
+
+// True if state from S up to, without, Stop has exit() or enter().
+template <typename Context, typename S, typename Stop> struct PathActions {
+  using Up = PathActions<Context, typename ParentOf<S>::type, Stop>;
+  static constexpr bool exit = CanExit<S, Context> || Up::exit;
+  static constexpr bool enter = CanEnter<S, Context> || Up::enter;
+};
+template <typename Context, typename Stop>
+struct PathActions<Context, Stop, Stop> {
+  static constexpr bool exit = false;
+  static constexpr bool enter = false;
+};
+
+template <typename S, typename Context>
+using EnterTargets =
+    typename RedirectTargets<typename EnterResult<S, Context>::type>::type;
+
+// enter() of S only runs actions, entering S needs no other states.
+template <typename S, typename Context>
+concept PlainEnter =
+    !HasRegions<S> && !IsTask<typename EnterResult<S, Context>::type> &&
+    std::tuple_size<EnterTargets<S, Context>>::value == 0;
+
+// Lowest state from S up to, without, Stop that is not PlainEnter, void when
+// there is none.
+template <typename Context, typename S, typename Stop>
+struct LowestEntered
+    : LowestEntered<Context, typename ParentOf<S>::type, Stop> {};
+template <typename Context, typename Stop>
+struct LowestEntered<Context, Stop, Stop> {
+  using type = void;
+};
+template <typename Context, typename S, typename Stop>
+requires(!std::is_same<S, Stop>::value && !PlainEnter<S, Context>)
+struct LowestEntered<Context, S, Stop> {
+  using type = S;
+};
+
+// States below Stop down to S that are not PlainEnter, outermost first.
+// LocalEngine enters them itself and leaves plain states between them to
+// StateCode.
+template <typename Context, typename S, typename Stop> struct EngineEntered {
+  using Lowest = typename LowestEntered<Context, S, Stop>::type;
+  using type = decltype(typename EngineEntered<
+                            Context, typename ParentOf<Lowest>::type,
+                            Stop>::type{} +
+                        TypeList<Lowest>{});
+};
+template <typename Context, typename S, typename Stop>
+requires std::is_void<typename LowestEntered<Context, S, Stop>::type>::value
+struct EngineEntered<Context, S, Stop> {
+  using type = TypeList<>;
+};
+
+// Handler lookup goes up parent chain, up to region for states in region.
+// Event deferred on the way counts as handled.
+template <typename S, typename E, typename Context>
+constexpr bool handled_on_chain() {
+  if constexpr (CanHandle<S, E, Context> || Defers<S, E>) {
+    return true;
+  } else if constexpr (Substate<S> && !RegionRoot<S>) {
+    return handled_on_chain<typename S::ParentState, E, Context>();
+  } else {
+    return false;
+  }
+}
+
+// True if state on parent chain defers E before any state handles it.
+template <typename S, typename E, typename Context>
+constexpr bool deferred_on_chain() {
+  if constexpr (CanHandle<S, E, Context>) {
+    return false;
+  } else if constexpr (Defers<S, E>) {
+    return true;
+  } else if constexpr (Substate<S> && !RegionRoot<S>) {
+    return deferred_on_chain<typename S::ParentState, E, Context>();
+  } else {
+    return false;
+  }
+}
+
+template <typename Access>
+constexpr bool observed = !std::is_same<
+    std::remove_cvref_t<decltype(std::declval<Access &>().observer())>,
+    NoObserver>::value;
+
+// States, with repetitions, whose indexes code of transition, dispatch or
+// start in LocalEngine uses: bounds of transitions, states entered on the way
+// that are not PlainEnter and states of transitions their enter() redirects
+// to. Visited states are not followed again, cycles of enter() redirects are
+// reported by BasicEngine.
+template <typename Context, typename From, typename To, typename... Visited>
+struct TransitionStates;
+
+template <typename Context, typename Entered, typename To,
+          typename... Visited>
+struct ChainEnterStates;
+
+// Entering region R towards To enters To or start state of region.
+template <typename Context, typename R, typename To, typename... Visited>
+struct RegionEnterStates {
+  using Target = typename std::conditional<
+      std::is_same<typename RegionOf<To>::type, R>::value, To,
+      typename ResolveStartState<R>::type>::type;
+  using Entered =
+      typename EngineEntered<Context, Target, typename R::ParentState>::type;
+  using type = decltype(TypeList<Target>{} + Entered{} +
+                        typename ChainEnterStates<Context, Entered, Target,
+                                                  Visited...>::type{});
+};
+
+template <typename Context, typename S, typename To, typename... Visited>
+struct EnterStates {
+  template <typename... T>
+  static auto redirects(std::tuple<State<T>...>)
+      -> decltype((TypeList<>{} + ... +
+                   typename TransitionStates<
+                       Context, S, typename ResolveStartState<T>::type, S,
+                       Visited...>::type{}));
+  template <typename... R>
+  static auto regions(TypeList<R...>)
+      -> decltype((TypeList<>{} + ... +
+                   typename RegionEnterStates<Context, R, To, S,
+                                              Visited...>::type{}));
+
+  using type = decltype(redirects(EnterTargets<S, Context>{}) +
+                        regions(typename RegionList<S>::type{}));
+};
+template <typename Context, typename S, typename To, typename... Visited>
+requires(std::is_same<S, Visited>::value || ...)
+struct EnterStates<Context, S, To, Visited...> {
+  using type = TypeList<>;
+};
+
+template <typename Context, typename... S, typename To, typename... Visited>
+struct ChainEnterStates<Context, TypeList<S...>, To, Visited...> {
+  using type = decltype((TypeList<>{} + ... +
+                         typename EnterStates<Context, S, To,
+                                              Visited...>::type{}));
+};
+
+template <typename Context, typename From, typename To, typename... Visited>
+struct TransitionStates {
+  using Bounds = TransitionBounds<From, To>;
+  using Entered =
+      typename EngineEntered<Context, typename Bounds::EnterTo,
+                             typename Bounds::EnterStop>::type;
+  using type = decltype(TypeList<From, To, typename Bounds::ExitFrom,
+                                 typename Bounds::EnterTo>{} +
+                        Entered{} +
+                        typename ChainEnterStates<Context, Entered, To,
+                                                  Visited...>::type{});
+};
+
+template <typename Context, typename To> struct StartStates {
+  using Entered = typename EngineEntered<Context, To, void>::type;
+  using type = decltype(TypeList<To>{} + Entered{} +
+                        typename ChainEnterStates<Context, Entered,
+                                                  To>::type{});
+};
+
+// Handler inherited from Owner may transition from S or from Owner, see
+// LocalEngine::inherited_transition().
+template <typename Context, typename S, typename Event> struct DispatchStates {
+  using Owner = typename HandlerOnChain<S, Event, Context>::type;
+
+  template <typename From, typename T>
+  using TransitionTo =
+      typename TransitionStates<Context, From,
+                                typename ResolveStartState<T>::type>::type;
+
+  template <typename... T>
+  static auto targets(std::tuple<State<T>...>)
+      -> decltype((TypeList<>{} + ... +
+                   (TransitionTo<S, T>{} + TransitionTo<Owner, T>{})));
+
+  using type = decltype(TypeList<S, Owner>{} +
+                        targets(typename RedirectTargets<typename HandleResult<
+                                    Owner, Event, Context>::type>::type{}));
+};
+
+// Index map of LocalEngine: state S has index I, region R has slot K among
+// regions of all states. Lookup goes through base class deduction.
+template <typename S, std::size_t I> struct Slot {};
+template <typename R, std::size_t K> struct RegionSlot {};
+template <typename... Entries> struct Slots : Entries... {};
+
+template <typename S, std::size_t I>
+constexpr std::size_t slot_index(const Slot<S, I> *) {
+  return I;
+}
+template <typename R, std::size_t K>
+constexpr std::size_t region_slot_index(const RegionSlot<R, K> *) {
+  return K;
+}
+
+template <typename Source, typename S> struct RegionSlotOf {
+  using type = TypeList<>;
+};
+template <typename Source, RegionRoot S> struct RegionSlotOf<Source, S> {
+  using type = TypeList<RegionSlot<S, Source::template region_slot<S>()>>;
+};
+
+template <typename List> struct SlotsFromList;
+template <typename... Entries> struct SlotsFromList<TypeList<Entries...>> {
+  using type = Slots<Entries...>;
+};
+
+template <typename... S>
+auto with_regions(TypeList<S...>)
+    -> decltype(TypeList<S...>{} +
+                (TypeList<>{} + ... + typename RegionList<S>::type{}));
+
+template <std::size_t N>
+constexpr std::array<std::size_t, N>
+sorted_unique(std::array<std::size_t, N> indexes) {
+  std::sort(indexes.begin(), indexes.end());
+  std::fill(std::unique(indexes.begin(), indexes.end()), indexes.end(), 0);
+  return indexes;
+}
+
+template <std::size_t N>
+constexpr std::size_t unique_count(const std::array<std::size_t, N> &sorted) {
+  return std::find(sorted.begin(), sorted.end(), 0) - sorted.begin();
+}
+
+// Slots of states of List and of regions of those states, ordered by
+// index, so that the same states give the same Slots. Source has
+// index_of<S>() and region_slot<R>() of them, states without index are left
+// out.
+template <typename Source, typename List,
+          typename Listed = decltype(with_regions(List{}))>
+struct SlotsOf;
+template <typename Source, typename List, typename... S>
+struct SlotsOf<Source, List, TypeList<S...>> {
+  static constexpr std::array<std::size_t, sizeof...(S)> listed{
+      Source::template index_of<S>()...};
+  static constexpr auto indexes = sorted_unique(listed);
+
+  // Position in List of state of given index.
+  static constexpr std::size_t position(std::size_t index) {
+    return std::find(listed.begin(), listed.end(), index) - listed.begin();
+  }
+
+  template <std::size_t J>
+  using StateAt = typename TypeList<S...>::template at<position(indexes[J])>;
+
+  template <std::size_t... J>
+  static auto entries(std::index_sequence<J...>)
+      -> decltype(TypeList<Slot<StateAt<J>, indexes[J]>...>{} +
+                  (TypeList<>{} + ... +
+                   typename RegionSlotOf<Source, StateAt<J>>::type{}));
+
+  using type = typename SlotsFromList<decltype(entries(
+      std::make_index_sequence<unique_count(indexes)>{}))>::type;
+};
+
+// Transition is performed as sequence of steps, each step exits and enters
+// states between two states and points to next step when one of entered
+// states returned new state from enter(). Length of such sequence is known
+// at compile time, see BasicEngine::max_enter_redirects.
+template <typename StateIndex, typename Access> struct Step {
+  StateIndex state;
+  Step (*next)(Access &);
+};
+
+// Actions of state S with observer notifications, shared by all LocalEngine
+// that use S. Index of S is passed in and parents of S are reached through
+// `access.parent(index)`, so that code does not depend on other states.
+template <typename Context, typename S> struct StateCode {
+  // Task gets its own copy of event, see Task::keeping.
+  template <typename Access, typename E>
+  static decltype(auto) call_handle(Access &access, std::size_t index,
+                                    const E &e) {
+    auto &state = access.template get<S>(index);
+    if constexpr (std::is_void<Context>::value) {
+      using Result = decltype(state.handle(e));
+      if constexpr (IsTask<Result>) {
+        return Result::keeping(
+            [&state](const E &event) { return state.handle(event); }, e);
       } else {
-        const auto new_state_variant = convert_to_variant(new_state);
-        if (!std::get_if<KeepState>(&new_state_variant)) {
-          return {s, new_state_variant};
-        }
+        return state.handle(e);
       }
     } else {
-      call_enter(std::forward<S>(s));
+      return state.handle(access.context(), e);
     }
+  }
 
-    if constexpr (sizeof...(Rest) > 0) {
-      return call_enter_on_chain_exit_when_return<Rest...>(
-          std::forward<Rest>(rest)...);
+  template <typename Access, typename E>
+  static auto handle(Access &access, std::size_t index, const E &e) {
+    if constexpr (CanHandle<S, E, Context>) {
+      return access.observer().template around_handle<S>(
+          index - 1, e,
+          [&access, index, &e] { return call_handle(access, index, e); });
     } else {
-      return {s, s};
+      return KeepState{};
     }
   }
 
-  template <typename S, typename E>
-  StateActionVariant call_handle_on_chain(const E &e) {
-    constexpr bool can_handle = requires(S & st, const E &ev) {
-      st.handle(ev);
-    };
+  template <typename Access>
+  static void exit(Access &access, std::size_t index) {
+    access.observer().template on_exit<S>(index - 1);
+    if constexpr (CanExit<S, Context>) {
+      access.observer().template around_exit<S>(index - 1, [&access, index] {
+        if constexpr (std::is_void<Context>::value) {
+          access.template get<S>(index).exit();
+        } else {
+          access.template get<S>(index).exit(access.context());
+        }
+      });
+    }
+  }
 
-    constexpr bool can_return = requires(S & st, const E &ev) {
-      { convert_to_variant(st.handle(ev)) }
-      ->std::convertible_to<StateActionVariant>;
-    };
+  template <typename Access>
+  static auto enter(Access &access, std::size_t index) {
+    access.observer().template on_enter<S>(index - 1);
+    if constexpr (CanEnter<S, Context>) {
+      return access.observer().template around_enter<S>(
+          index - 1, [&access, index] {
+            if constexpr (std::is_void<Context>::value) {
+              return access.template get<S>(index).enter();
+            } else {
+              return access.template get<S>(index).enter(access.context());
+            }
+          });
+    }
+  }
 
-    if constexpr (can_handle) {
-      if constexpr (can_return) {
-        return convert_to_variant(std::get<S &>(_states).handle(e));
-      } else {
-        std::get<S &>(_states).handle(e);
-        return KeepState{};
-      }
-    } else if constexpr (details::Substate<S>) {
-      return call_handle_on_chain<typename S::ParentState>(e);
+  // Exits S and its parents up to, without, Stop.
+  template <typename Stop, typename Access>
+  static void exit_up(Access &access, std::size_t index) {
+    exit(access, index);
+    if constexpr (!std::is_same<typename ParentOf<S>::type, Stop>::value) {
+      StateCode<Context, typename S::ParentState>::template exit_up<Stop>(
+          access, access.parent(index));
+    }
+  }
+
+  // Enters parents of S below Stop and S, outermost first, all of them
+  // PlainEnter.
+  template <typename Stop, typename Access>
+  static void enter_down(Access &access, std::size_t index) {
+    if constexpr (!std::is_same<typename ParentOf<S>::type, Stop>::value) {
+      StateCode<Context, typename S::ParentState>::template enter_down<Stop>(
+          access, access.parent(index));
+    }
+    enter(access, index);
+  }
+};
+
+// Dispatch and transition code of single state, see BasicEngine. It knows
+// indexes of only states it uses, listed in Map of Slots, instead of all
+// states of chart, so that code instantiated per state, e.g. entries of
+// dispatch tables, has names of constant length. States between them are
+// exited and entered by StateCode. Transitions inherited from parent go to
+// LocalEngine of states of that transition, shared by substates.
+template <typename Context, typename StateIndex, std::size_t MaxRedirects,
+          typename Map>
+class LocalEngine {
+  template <typename, typename, std::size_t, typename>
+  friend class LocalEngine;
+
+public:
+  template <typename S> static consteval StateIndex index_of() {
+    if constexpr (std::is_same<S, NoAction>::value) {
+      return 0;
     } else {
-      return KeepState{};
+      return slot_index<S>(static_cast<const Map *>(nullptr));
+    }
+  }
+
+  template <typename R> static consteval std::size_t region_slot() {
+    return region_slot_index<R>(static_cast<const Map *>(nullptr));
+  }
+
+  template <typename S, typename Access, typename Event>
+  static StateIndex dispatch(Access &access, const Event &e) {
+    if constexpr (std::is_same<S, NoAction>::value) {
+      return 0;
+    } else {
+      access.observer().on_event(e);
+      return handle_on_chain<S>(access, e);
     }
   }
 
-  template <typename StateWrapper> void call_exit(StateWrapper) {
-    using S = StateWrapper::type;
-    constexpr bool can_exit = requires(S & s) { s.exit(); };
-    if constexpr (can_exit) {
-      std::get<S &>(_states).exit();
+  // Handles events from front of span as long as active state stays the same,
+  // consumed events are removed from span.
+  template <typename S, typename Access, typename Event>
+  static StateIndex dispatch_batch(Access &access,
+                                   std::span<const Event> &events) {
+    constexpr StateIndex same = index_of<S>();
+
+    while (!events.empty()) {
+      const auto next = dispatch<S>(access, events.front());
+      events = events.subspan(1);
+      if (next != same) {
+        return next;
+      }
     }
+    return same;
+  }
+
+  template <typename S, typename Access, std::size_t I, typename... Events>
+  static StateIndex
+  dispatch_alternative(Access &access, const std::variant<Events...> &e) {
+    return dispatch<S>(access, *std::get_if<I>(&e));
   }
 
-  template <typename StateWrapper> auto call_enter(StateWrapper) {
-    using S = StateWrapper::type;
-    constexpr bool can_enter = requires(S & s) { s.enter(); };
-    if constexpr (can_enter) {
-      return std::get<S &>(_states).enter();
+  template <typename S, typename Access, typename Event>
+  static StateIndex handle_on_chain(Access &access, const Event &e) {
+    using Result = decltype(call_handle_on_chain<S>(access, e));
+    if constexpr (deferred_on_chain<S, Event, Context>()) {
+      access.defer(e);
+      return index_of<S>();
+    } else if constexpr (IsTask<Result>) {
+      return suspend(access, call_handle_on_chain<S>(access, e), index_of<S>(),
+                     &finish_handle<S, Access, typename Result::task_result>);
+    } else if constexpr (inherited_transition<S, Event, Access>()) {
+      using Owner = typename HandlerOnChain<S, Event, Context>::type;
+      const auto next =
+          redirect<Owner, Access, true>(call_handle_on_chain<S>(access, e));
+      if (!next) {
+        return index_of<S>();
+      }
+      Code<S>::template exit_up<Owner>(access, index_of<S>());
+      return run(access, Step<StateIndex, Access>{index_of<Owner>(), next});
+    } else if constexpr (requires {
+                    take_transition<S>(access,
+                                       call_handle_on_chain<S>(access, e));
+                  }) {
+      return take_transition<S>(access, call_handle_on_chain<S>(access, e));
+    } else {
+      call_handle_on_chain<S>(access, e);
+      return index_of<S>();
     }
   }
 
-  template <typename... StatesSubset>
-  constexpr StateActionVariant
-  convert_to_variant(std::variant<StatesSubset...> v) {
-    return std::visit([](auto &&arg) -> StateActionVariant { return arg; }, v);
+  // Enters states from top level state down to To.
+  template <typename To, typename Access>
+  static StateIndex start(Access &access) {
+    Step<StateIndex, Access> step{};
+    enter_down<To, void, To, To>(access, step);
+    return run(access, step);
   }
 
-  template <typename S>
-  constexpr StateActionVariant convert_to_variant(State<S> state) {
-    return state;
+private:
+  template <typename List>
+  using Local = LocalEngine<Context, StateIndex, MaxRedirects,
+                            typename SlotsOf<LocalEngine, List>::type>;
+
+  template <typename S> using Code = StateCode<Context, S>;
+
+  // True when handler of Event is inherited by S from parent state and all
+  // its targets are outside of that parent. Exits and enters are then the
+  // same as of transition from the parent after exiting states below it,
+  // so transition code is instantiated once per parent and target instead
+  // of once per substate. Observed charts are told about transition from S
+  // and charts with regions track active states of regions on the way, they
+  // take transition from S.
+  template <typename S, typename Event, typename Access>
+  static constexpr bool inherited_transition() {
+    using Owner = typename HandlerOnChain<S, Event, Context>::type;
+    if constexpr (std::is_same<Owner, S>::value || Access::region_count > 0 ||
+                  observed<Access> || !CanHandle<Owner, Event, Context>) {
+      return false;
+    } else {
+      using Result = typename HandleResult<Owner, Event, Context>::type;
+      return TargetsOutside<Owner,
+                            typename RedirectTargets<Result>::type>::value;
+    }
   }
 
-  template <typename state> struct resolve_start_state { using type = state; };
-  template <details::HasStartState state>
-  struct resolve_start_state<state>
-      : resolve_start_state<typename state::StartState> {};
+  template <typename Access, typename... R>
+  static void exit_regions(Access &access, TypeList<R...>) {
+    (exit_region<R>(access), ...);
+  }
 
-  template <typename... state> struct parent_chain;
-  template <details::Substate curr, typename... tail>
-  struct parent_chain<curr, tail...>
-      : parent_chain<typename curr::ParentState, curr, tail...> {};
-  template <typename curr, typename... tail>
-  struct parent_chain<curr, tail...> {
-    using type = std::tuple<State<curr>, State<tail>...>;
-  };
+  template <typename R, typename Access>
+  static void exit_region(Access &access) {
+    auto &leaf = access.region(region_slot<R>());
+    if (leaf) {
+      access.exit_region(leaf);
+      leaf = 0;
+    }
+  }
 
-  template <typename T1, typename T2> struct reduce_common_starting_types;
-  template <typename Common, typename... A, typename... B>
-  struct reduce_common_starting_types<std::tuple<Common, A...>,
-                                      std::tuple<Common, B...>>
-      : reduce_common_starting_types<std::tuple<A...>, std::tuple<B...>> {};
-  template <typename... A, typename... B>
-  struct reduce_common_starting_types<std::tuple<A...>, std::tuple<B...>> {
-    using type_a = std::tuple<A...>;
-    using type_b = std::tuple<B...>;
-  };
+  // Enters every region of O, down to To in its region and to start state
+  // in others. Regions still active, when O is entered from inside, are
+  // exited first.
+  template <typename O, typename To, typename Access>
+  static void enter_regions(Access &access) {
+    exit_regions(access, typename RegionList<O>::type{});
+    [&access]<typename... R>(TypeList<R...>) {
+      ((access.region(region_slot<R>()) = enter_region<R, To>(access)), ...);
+    }(typename RegionList<O>::type{});
+  }
 
-  template <typename T, typename Or> struct tuple_or;
-  template <typename... Ts, typename Or>
-  struct tuple_or<std::tuple<Ts...>, Or> {
-    using type = std::tuple<Ts...>;
-  };
-  template <typename Or> struct tuple_or<std::tuple<>, Or> {
-    using type = std::tuple<Or>;
-  };
+  template <typename R, typename To, typename Access>
+  static StateIndex enter_region(Access &access) {
+    using Target = typename std::conditional<
+        std::is_same<typename RegionOf<To>::type, R>::value, To,
+        typename ResolveStartState<R>::type>::type;
+    Step<StateIndex, Access> step{};
+    enter_down<Target, typename R::ParentState, Target, Target>(access, step);
+    return run(access, step);
+  }
+
+  template <typename StateFrom, typename Access, typename StateTo>
+  static StateIndex take_transition(Access &access, State<StateTo> to) {
+    if constexpr (std::is_same<StateTo, NoAction>::value) {
+      return index_of<StateFrom>();
+    } else {
+      return run(access, Step<StateIndex, Access>{
+                             index_of<StateFrom>(),
+                             redirect<StateFrom, Access>(to)});
+    }
+  }
+
+  template <typename StateFrom, typename Access, typename... Alternatives>
+  static StateIndex take_transition(Access &access,
+                                    const std::variant<Alternatives...> &v) {
+    using Take = StateIndex (*)(Access &);
+    static constexpr std::array<Take, sizeof...(Alternatives)> table{
+        [](Access &a) { return take_transition<StateFrom>(a, Alternatives{}); }...};
+    return table[v.index()](access);
+  }
+
+  template <typename Access>
+  static StateIndex run(Access &access, Step<StateIndex, Access> step) {
+    for (std::size_t i = 0; i <= MaxRedirects && step.next; ++i) {
+      step = step.next(access);
+    }
+    return step.state;
+  }
+
+  template <typename StateFrom, typename StateTo, typename Access>
+  static Step<StateIndex, Access> transition_step(Access &access) {
+    using Bounds = TransitionBounds<StateFrom, StateTo>;
+
+    access.observer().template on_transition<StateFrom, StateTo>(
+        index_of<StateFrom>() - 1, index_of<StateTo>() - 1);
+    exit_up<typename Bounds::ExitFrom, typename Bounds::ExitStop>(access);
+    Step<StateIndex, Access> step{};
+    enter_down<typename Bounds::EnterTo, typename Bounds::EnterStop,
+               typename Bounds::EnterTo, StateTo>(access, step);
+    return step;
+  }
+
+  // Exits regions of S, then S and its parents up to, without, Stop.
+  template <typename S, typename Stop, typename Access>
+  static void exit_up(Access &access) {
+    if constexpr (!std::is_same<S, Stop>::value) {
+      exit_regions(access, typename RegionList<S>::type{});
+      Code<S>::template exit_up<Stop>(access, index_of<S>());
+    }
+  }
+
+  // Enters states below Stop down to S, outermost first, until one of them
+  // redirects from enter(). States of EngineEntered are entered here, plain
+  // states between them by StateCode. State returning task enters states
+  // after it, down to Last, when task completes. To is destination of
+  // transition, used to choose states entered in regions.
+  template <typename S, typename Stop, typename Last, typename To,
+            typename Access>
+  static bool enter_down(Access &access, Step<StateIndex, Access> &step) {
+    using Parent = typename ParentOf<S>::type;
+    if constexpr (!std::is_same<Parent, Stop>::value) {
+      using Above = typename LowestEntered<Context, Parent, Stop>::type;
+      if constexpr (!std::is_void<Above>::value) {
+        if (!enter_down<Above, Stop, Last, To>(access, step)) {
+          return false;
+        }
+      }
+      if constexpr (!std::is_same<Parent, Above>::value) {
+        Code<Parent>::template enter_down<typename std::conditional<
+            std::is_void<Above>::value, Stop, Above>::type>(
+            access, access.parent(index_of<S>()));
+      }
+    }
+    return enter_state<S, Last, To>(access, step);
+  }
+
+  template <typename S, typename Last, typename To, typename Access>
+  static bool enter_state(Access &access, Step<StateIndex, Access> &step) {
+    using Result = typename EnterResult<S, Context>::type;
+    step.state = index_of<S>();
+    if constexpr (IsTask<Result>) {
+      step.state = suspend(
+          access, Code<S>::enter(access, index_of<S>()), index_of<S>(),
+          &finish_enter<S, Last, To, Access, typename Result::task_result>);
+      return false;
+    } else if constexpr (requires {
+                           redirect<S, Access>(
+                               Code<S>::enter(access, index_of<S>()));
+                         }) {
+      step.next = redirect<S, Access>(Code<S>::enter(access, index_of<S>()));
+    } else {
+      Code<S>::enter(access, index_of<S>());
+    }
+    if constexpr (HasRegions<S>) {
+      if (!step.next) {
+        enter_regions<S, To>(access);
+      }
+    }
+    return !step.next;
+  }
+
+  // Task returned by handle() or enter() is started by Access, which calls
+  // finish with its result when it completes, right away or later. Until
+  // then, index of state that returned task is active one.
+  template <typename Access, typename Task, typename Result>
+  static StateIndex suspend(Access &access, Task &&task, StateIndex current,
+                            StateIndex (*finish)(Access &, Result &&)) {
+    static_assert(
+        requires(Task t) { access.suspend(std::move(t), current, finish); },
+        "states returning sctl::Task need sctl::StateChart<sctl::Async<>, "
+        "States...>");
+    return access.suspend(std::move(task), current, finish);
+  }
+
+  template <typename S, typename Access, typename Result>
+  static StateIndex finish_handle(Access &access, Result &&result) {
+    return take_transition<S>(access, result);
+  }
+
+  // Redirects from enter() of S or enters states after it down to Last.
+  template <typename S, typename Last, typename To, typename Access,
+            typename Result>
+  static StateIndex finish_enter(Access &access, Result &&result) {
+    Step<StateIndex, Access> step{index_of<S>(), redirect<S, Access>(result)};
+    if (!step.next) {
+      if constexpr (HasRegions<S>) {
+        enter_regions<S, To>(access);
+      }
+      if constexpr (!std::is_same<S, Last>::value) {
+        step = {};
+        enter_down<Last, S, Last, To>(access, step);
+      }
+    }
+    return run(access, step);
+  }
+
+  // Shared steps are taken by LocalEngine of transition states, others by
+  // this one, which has states of transitions of its own states.
+  template <typename StateFrom, typename Access, bool Shared = false,
+            typename StateTo>
+  static constexpr auto redirect(State<StateTo>)
+      -> Step<StateIndex, Access> (*)(Access &) {
+    if constexpr (std::is_same<StateTo, NoAction>::value) {
+      return nullptr;
+    } else if constexpr (Shared) {
+      using To = typename ResolveStartState<StateTo>::type;
+      return &Local<typename TransitionStates<Context, StateFrom, To>::type>::
+          template transition_step<StateFrom, To, Access>;
+    } else {
+      return &transition_step<StateFrom,
+                              typename ResolveStartState<StateTo>::type,
+                              Access>;
+    }
+  }
+
+  template <typename StateFrom, typename Access, bool Shared = false,
+            typename... Alternatives>
+  static constexpr auto redirect(const std::variant<Alternatives...> &v)
+      -> Step<StateIndex, Access> (*)(Access &) {
+    constexpr std::array<Step<StateIndex, Access> (*)(Access &),
+                         sizeof...(Alternatives)>
+        table{redirect<StateFrom, Access, Shared>(Alternatives{})...};
+    return table[v.index()];
+  }
+
+  // Handler is looked up on parent chain, KeepState when there is none.
+  template <typename S, typename Access, typename E>
+  static auto call_handle_on_chain(Access &access, const E &e) {
+    using Owner = typename HandlerOnChain<S, E, Context>::type;
+    return Code<Owner>::handle(access, index_of<Owner>(), e);
+  }
+};
+
+// Tables and loops of state chart. State objects are reached through Access
+// object, `access.template get<S>(index)` returns reference to S state of
+// given index, `access.parent(index)` index of its parent, see parent_table,
+// and `access.observer()` observer to notify. Active state is represented by
+// its index, that is position in States plus one, 0 stands for KeepState (not
+// started chart). When state with regions is active, active state of every
+// its region is kept in `access.region(slot)`, slot being position of region
+// among regions of all States, and `access.exit_region(leaf)` calls entry of
+// region_exit_table. Deferred events are passed to `access.defer(e)`. Unless
+// Context is void, actions of states get `access.context()` as first
+// argument. Entries of tables are code of LocalEngine, which does not depend
+// on States.
+template <typename Context, typename... States> class BasicEngine {
+public:
+  static constexpr std::size_t table_stride = sizeof...(States) + 1;
+
+  using StateIndex = SmallestIndex<table_stride - 1>::type;
+
+  using AllRegions = decltype((TypeList<>{} + ... +
+                               typename RegionList<States>::type{}));
+  static constexpr std::size_t region_count = AllRegions::size;
+
+  using DeferredEvents = typename Unique<decltype((
+      TypeList<>{} + ... + typename DeferredList<States>::type{}))>::type;
+
+  // Key of snapshots, differs for charts of different states, regions or
+  // deferred events, including their order. Stable for given compiler.
+  static constexpr std::uint64_t layout = hash(
+      type_name<TypeList<TypeList<States...>, AllRegions, DeferredEvents>>());
+
+  static_assert(((!HasRegions<States> ||
+                  std::is_void<typename RegionOf<States>::type>::value) &&
+                 ...),
+                "states with regions can not be nested in regions");
+
+  template <typename S> static constexpr StateIndex index_of() {
+    if constexpr (TypeList<States...>::template contains<S>()) {
+      return TypeList<States...>::template index_of<S>() + 1;
+    } else {
+      return 0;
+    }
+  }
+
+  template <typename R> static constexpr std::size_t region_slot() {
+    return AllRegions::template index_of<R>();
+  }
+
+  // Index of parent of state at given index, 0 for top level states.
+  static constexpr std::array<StateIndex, table_stride> parent_table{
+      0, index_of<typename ParentOf<States>::type>()...};
+
+  static constexpr std::size_t redirect_cycle = ~std::size_t{0};
+
+  static constexpr std::size_t chain_depth(std::size_t depth) {
+    return depth == redirect_cycle ? depth : depth + 1;
+  }
+
+  // Longest chain of enter() redirects starting at S, following every state
+  // entered on the way to redirect destination.
+  template <typename S, typename... Visited>
+  static constexpr std::size_t redirect_depth() {
+    if constexpr ((std::is_same<S, Visited>::value || ...)) {
+      return redirect_cycle;
+    } else {
+      return std::apply(
+          []<typename... Targets>(State<Targets>...) {
+            std::size_t depth = 0;
+            ((depth = std::max(
+                  depth,
+                  chain_depth(redirect_depth_through<
+                              S, typename ResolveStartState<Targets>::type,
+                              S, Visited...>()))),
+             ...);
+            return depth;
+          },
+          EnterTargets<S, Context>{});
+    }
+  }
+
+  // Plain states entered on the way redirect nowhere.
+  template <typename From, typename To, typename... Visited>
+  static constexpr std::size_t redirect_depth_through() {
+    using Bounds = TransitionBounds<From, To>;
+    return []<typename... Entered>(TypeList<Entered...>) {
+      std::size_t depth = 0;
+      ((depth = std::max(depth, redirect_depth<Entered, Visited...>())), ...);
+      return depth;
+    }(typename EngineEntered<Context, typename Bounds::EnterTo,
+                             typename Bounds::EnterStop>::type{});
+  }
+
+  static constexpr std::size_t max_enter_redirects =
+      std::max({std::size_t{0}, redirect_depth<States>()...});
+
+  static_assert(max_enter_redirects != redirect_cycle,
+                "enter() redirects of states form a cycle");
+
+  // LocalEngine of states of List.
+  template <typename List>
+  using Local = LocalEngine<Context, StateIndex, max_enter_redirects,
+                            typename SlotsOf<BasicEngine, List>::type>;
+
+  // LocalEngine dispatching Event in S.
+  template <typename S, typename Event>
+  using DispatchNode = Local<typename DispatchStates<Context, S, Event>::type>;
+
+  template <typename Access>
+  static StateIndex start(Access &access, bool call_entry) {
+    using StartingState = typename TypeList<States...>::template at<0>;
+    using DestinationState =
+        typename ResolveStartState<StartingState>::type;
+
+    if (call_entry) {
+      return Local<typename StartStates<Context, DestinationState>::type>::
+          template start<DestinationState>(access);
+    } else {
+      if constexpr (HasRegions<DestinationState>) {
+        [&access]<typename... R>(TypeList<R...>) {
+          ((access.region(region_slot<R>()) =
+                index_of<typename ResolveStartState<R>::type>()),
+           ...);
+        }(typename RegionList<DestinationState>::type{});
+      }
+      return index_of<DestinationState>();
+    }
+  }
+
+  // Dispatches event to active state of every region of active state that
+  // handles it, active state gets it when no region did. Regions without
+  // handler for event are skipped at compile time.
+  template <typename Access, typename Event>
+  static StateIndex dispatch_event(Access &access, StateIndex current,
+                                   const Event &e) {
+    if constexpr (!(region_handles<States, Event>() || ...)) {
+      return dispatch_table<Access, Event>[current](access, e);
+    } else {
+      StateIndex next = current;
+      bool handled = false;
+      [&]<typename... R>(TypeList<R...>) {
+        (dispatch_region<R>(access, e, next, handled) && ...);
+      }(AllRegions{});
+      return handled ? next
+                     : dispatch_table<Access, Event>[current](access, e);
+    }
+  }
+
+  // Per event table indexed by active state, every entry
+  // resolves handler on parent chain and performs exit/enter sequence for
+  // destination types known from handler return type.
+  template <typename Access, typename Event>
+  using Dispatch = StateIndex (*)(Access &, const Event &);
+
+  template <typename Access, typename Event>
+  static constexpr std::array<Dispatch<Access, Event>, table_stride>
+      dispatch_table{
+          &Local<TypeList<>>::template dispatch<NoAction, Access, Event>,
+          &DispatchNode<States, Event>::template dispatch<States, Access,
+                                                          Event>...};
+
+  template <typename Access, typename... Events>
+  using VariantDispatch = StateIndex (*)(Access &,
+                                         const std::variant<Events...> &);
+
+  template <typename Access, typename... Events>
+  static StateIndex dispatch_variant(Access &access, StateIndex current,
+                                     const std::variant<Events...> &e) {
+    if (!details::holds_event(e)) {
+      return current;
+    }
+    const auto cell = variant_dispatch_table<
+        Access, Events...>[e.index() * table_stride + current];
+    return cell ? cell(access, e) : current;
+  }
+
+  // Handles events from front of span as long as active state stays the same,
+  // consumed events are removed from span.
+  template <typename Access, typename Event>
+  using BatchDispatch = StateIndex (*)(Access &, std::span<const Event> &);
+
+  template <typename Access, typename Event>
+  static constexpr std::array<BatchDispatch<Access, Event>, table_stride>
+      batch_table{
+          &Local<TypeList<>>::template dispatch_batch<NoAction, Access, Event>,
+          &DispatchNode<States, Event>::template dispatch_batch<States, Access,
+                                                                Event>...};
+
+  // Index of state active after handling Event in S, when that is known at
+  // compile time: handler is stateless and evaluable at compile time, and no
+  // exit or enter action is on the way. Otherwise table_stride.
+  template <typename S, typename Event>
+  static constexpr std::size_t static_destination() {
+    if constexpr (std::is_same<S, NoAction>::value) {
+      return 0;
+    } else if constexpr (!handled_on_chain<S, Event, Context>()) {
+      return index_of<S>();
+    } else {
+      using Handler = HandlerOnChain<S, Event, Context>::type;
+      if constexpr (std::is_void<Context>::value &&
+                    std::is_empty<Handler>::value &&
+                    HasConstantHandler<Handler, Event>) {
+        using Ret = decltype(std::declval<Handler &>().handle(Event{}));
+        if constexpr (std::is_void<Ret>::value ||
+                      std::is_base_of<State<NoAction>, Ret>::value) {
+          return index_of<S>();
+        } else if constexpr (IsStateWrapper<Ret>) {
+          using To = typename ResolveStartState<typename Ret::type>::type;
+          using Bounds = TransitionBounds<S, To>;
+          if constexpr (!PathActions<Context, typename Bounds::ExitFrom,
+                                     typename Bounds::ExitStop>::exit &&
+                        !PathActions<Context, typename Bounds::EnterTo,
+                                     typename Bounds::EnterStop>::enter) {
+            return index_of<To>();
+          }
+        }
+      }
+      return table_stride;
+    }
+  }
+
+  // Tells if S is active when state at given index is active, that is if it
+  // is that state or one of its parents.
+  template <typename S> static constexpr bool is_active(std::size_t current) {
+    constexpr std::array<bool, table_stride> table{false,
+                                                   in_chain<S, States>()...};
+    return table[current];
+  }
+
+  // Tells if active state and active states of regions, e.g. read from
+  // snapshot, are configuration chart can be in. Active state is 0 or state
+  // without start state outside regions. Every region of active state holds
+  // state of that region without start state, other regions hold 0.
+  static constexpr bool
+  valid_configuration(std::size_t current,
+                      const std::array<StateIndex, region_count> &regions) {
+    constexpr std::array<bool, table_stride> leaf{
+        true, (!HasStartState<States> &&
+               std::is_void<typename RegionOf<States>::type>::value)...};
+    if (current >= table_stride || !leaf[current]) {
+      return false;
+    }
+    return [&]<typename... R>(TypeList<R...>) {
+      return (valid_region<R>(current, regions[region_slot<R>()]) && ...);
+    }(AllRegions{});
+  }
+
+  template <typename Access>
+  using RegionExit = void (*)(Access &, std::size_t);
+
+  template <typename S, typename Access>
+  static constexpr RegionExit<Access> region_exit_cell() {
+    if constexpr (std::is_void<typename RegionOf<S>::type>::value) {
+      return nullptr;
+    } else {
+      return &StateCode<Context, S>::template exit_up<
+          typename OrthogonalOf<S>::type, Access>;
+    }
+  }
+
+  // Exits states from state at given index up to its region.
+  template <typename Access>
+  static constexpr std::array<RegionExit<Access>, table_stride>
+      region_exit_table{nullptr, region_exit_cell<States, Access>()...};
+
+  // Table of chart with regions.
+  template <typename Access>
+  static constexpr const RegionExit<Access> *region_exits() {
+    if constexpr (region_count > 0) {
+      return region_exit_table<Access>.data();
+    } else {
+      return nullptr;
+    }
+  }
+
+private:
+  template <typename S> static constexpr std::size_t region_slot_of() {
+    if constexpr (std::is_void<typename RegionOf<S>::type>::value) {
+      return region_count;
+    } else {
+      return region_slot<typename RegionOf<S>::type>();
+    }
+  }
+
+  // Region slot of state at given index, region_count outside of regions.
+  static constexpr std::array<std::size_t, table_stride> region_slot_table{
+      region_count, region_slot_of<States>()...};
+
+  template <typename R>
+  static constexpr bool valid_region(std::size_t current, std::size_t leaf) {
+    constexpr std::array<bool, table_stride> region_leaf{
+        false, !HasStartState<States>...};
+    if (!is_active<typename R::ParentState>(current)) {
+      return leaf == 0;
+    }
+    return leaf < table_stride && region_leaf[leaf] &&
+           region_slot_table[leaf] == region_slot<R>();
+  }
+
+  // True if S is region root which has state handling or deferring E.
+  template <typename S, typename E> static constexpr bool region_handles() {
+    if constexpr (RegionRoot<S>) {
+      return ((std::is_same<typename RegionOf<States>::type, S>::value &&
+               (CanHandle<States, E, Context> ||
+                Defers<States, E>)) ||
+              ...);
+    } else {
+      return false;
+    }
+  }
+
+  template <typename Access, typename Event>
+  using RegionDispatch = StateIndex (*)(Access &, const Event &);
+
+  template <typename S, typename Access, typename Event>
+  static constexpr RegionDispatch<Access, Event> region_cell() {
+    if constexpr (!std::is_void<typename RegionOf<S>::type>::value &&
+                  handled_on_chain<S, Event, Context>()) {
+      return &DispatchNode<S, Event>::template handle_on_chain<S, Access,
+                                                               Event>;
+    } else {
+      return nullptr;
+    }
+  }
+
+  template <typename Access, typename Event>
+  static constexpr std::array<RegionDispatch<Access, Event>, table_stride>
+      region_dispatch_table{nullptr, region_cell<States, Access, Event>()...};
+
+  // Returns false when transition left state owning region, so that
+  // remaining regions are not dispatched.
+  template <typename R, typename Access, typename Event>
+  static bool dispatch_region(Access &access, const Event &e,
+                              StateIndex &next, bool &handled) {
+    if constexpr (region_handles<R, Event>()) {
+      constexpr std::size_t slot = region_slot<R>();
+      const auto cell =
+          region_dispatch_table<Access, Event>[access.region(slot)];
+      if (cell) {
+        if (!handled) {
+          access.observer().on_event(e);
+          handled = true;
+        }
+        const auto result = cell(access, e);
+        if (region_slot_table[result] != slot) {
+          next = result;
+          return false;
+        }
+        access.region(slot) = result;
+      }
+    }
+    return true;
+  }
+
+  // Unhandled events are dispatched anyway when observed, to be reported.
+  template <typename S, typename Access, std::size_t I, typename... Events>
+  static constexpr VariantDispatch<Access, Events...> variant_cell() {
+    using Event = std::variant_alternative_t<I, std::variant<Events...>>;
+    if constexpr (handled_on_chain<S, Event, Context>() || observed<Access>) {
+      return &DispatchNode<S, Event>::template dispatch_alternative<
+          S, Access, I, Events...>;
+    } else {
+      return nullptr;
+    }
+  }
+
+  template <typename Access, std::size_t I, typename... Events>
+  static constexpr void fill_variant_row(
+      std::array<VariantDispatch<Access, Events...>,
+                 sizeof...(Events) * table_stride> &table) {
+    std::size_t j = I * table_stride + 1;
+    ((table[j++] = variant_cell<States, Access, I, Events...>()), ...);
+  }
+
+  template <typename Access, typename... Events>
+  static constexpr auto make_variant_dispatch_table() {
+    std::array<VariantDispatch<Access, Events...>,
+               sizeof...(Events) * table_stride>
+        table{};
+    [&table]<std::size_t... I>(std::index_sequence<I...>) {
+      (fill_variant_row<Access, I, Events...>(table), ...);
+    }(std::index_sequence_for<Events...>{});
+    return table;
+  }
+
+  template <typename Access, typename... Events>
+  static constexpr auto variant_dispatch_table =
+      make_variant_dispatch_table<Access, Events...>();
+};
+
+template <typename... States> using Engine = BasicEngine<void, States...>;
+
+// Observer, whether tasks are allowed and context, from first StateChart
+// parameter.
+template <typename Policy> struct ChartPolicy {
+  using observer = Policy;
+  using context = void;
+  static constexpr bool async = false;
+};
+template <typename Observer> struct ChartPolicy<Async<Observer>> {
+  using observer = Observer;
+  using context = void;
+  static constexpr bool async = true;
+};
+template <typename Context, typename Observer>
+struct ChartPolicy<WithContext<Context, Observer>> {
+  using observer = Observer;
+  using context = Context;
+  static constexpr bool async = false;
+};
+
+struct NoContext {};
+
+// Active states of regions of chart. std::array<T, 0> takes a byte, so chart
+// without regions keeps empty object converting to it instead.
+template <typename T, std::size_t N> struct RegionStates {
+  using type = std::array<T, N>;
+};
+template <typename T> struct RegionStates<T, 0> {
+  struct type {
+    type() = default;
+    type(const std::array<T, 0> &) {}
+    operator std::array<T, 0>() const { return {}; }
+    const T *begin() const { return nullptr; }
+    const T *end() const { return nullptr; }
+  };
+};
+
+// Number of deferred events of the largest type that fit in storage of
+// chart.
+inline constexpr std::size_t max_deferred = 16;
+
+// Data of state chart. Depends on number of states, not on states, so that
+// code of single state is the same in charts of different states. Objects
+// are pointers to state objects given to chart, or states of chart with
+// context, which are empty.
+template <typename Observer, typename Context, typename StateIndex,
+          typename Objects, std::size_t Regions, typename DeferredEvents,
+          bool Async>
+class ChartData {
+public:
+  using ContextData =
+      typename std::conditional<std::is_void<Context>::value, NoContext,
+                                Context>::type;
+  using Deferred = DeferredArena<max_deferred, DeferredEvents>;
+
+  // Access of engine to chart, made for every call together with tables of
+  // chart, so that those take no space in chart.
+  class Access {
+  public:
+    static constexpr std::size_t region_count = Regions;
+
+    using RegionExit = void (*)(Access &, std::size_t);
+
+    // Parent index of every state, region exits by state index and
+    // completion of pending task.
+    struct Tables {
+      const StateIndex *parents;
+      const RegionExit *region_exits;
+      void (*complete)(void *);
+    };
+
+    Access(ChartData &data, const Tables &tables)
+        : _data{data}, _tables{tables} {}
+
+    template <typename S> S &get(std::size_t index) {
+      if constexpr (std::is_void<Context>::value) {
+        return *static_cast<S *>(_data._states[index - 1]);
+      } else {
+        return std::get<S>(_data._states);
+      }
+    }
+    ContextData &context() { return _data._context; }
+    Observer &observer() { return _data._observer; }
+    StateIndex &region(std::size_t slot) { return _data._regions[slot]; }
+    std::size_t parent(std::size_t index) const {
+      return _tables.parents[index];
+    }
+    void exit_region(std::size_t leaf) {
+      _tables.region_exits[leaf](*this, leaf);
+    }
+    template <typename Event> void defer(const Event &e) {
+      if (!_data._deferred.push(e)) {
+        _data._observer.on_defer_overflow(e);
+      }
+    }
+
+    // Starts task, or keeps it pending with finish to be called with its
+    // result on completion.
+    template <typename Task, typename Result>
+    requires Async StateIndex suspend(Task task, StateIndex current,
+                                      StateIndex (*finish)(Access &,
+                                                           Result &&)) {
+      if (task.start(_tables.complete, &_data)) {
+        return finish(*this, task.result());
+      }
+      auto &pending = _data._pending;
+      pending.task = task.release();
+      pending.destroy = &Task::destroy;
+      pending.finish = reinterpret_cast<void (*)()>(finish);
+      pending.resume = &resume<Task, Result>;
+      return current;
+    }
+
+  private:
+    // Finishes pending task that completed.
+    template <typename Task, typename Result>
+    static StateIndex resume(Access &access) {
+      auto &pending = access._data._pending;
+      Task task = Task::adopt(std::exchange(pending.task, nullptr));
+      const auto finish = reinterpret_cast<StateIndex (*)(Access &, Result &&)>(
+          pending.finish);
+      return finish(access, task.result());
+    }
+
+    ChartData &_data;
+    const Tables &_tables;
+  };
+
+  ChartData(Objects states, ContextData context, Observer observer)
+      : _states{states}, _context{std::move(context)},
+        _observer{std::move(observer)} {}
+
+  ~ChartData() {
+    if constexpr (Async) {
+      if (_pending.task) {
+        _pending.destroy(_pending.task);
+      }
+      while (Queued *queued = pop_queued()) {
+        queued->take(queued, nullptr);
+      }
+    }
+  }
+
+protected:
+  // Event handled while task was pending, takes ownership of itself and
+  // handles event by chart, or only deletes itself without chart.
+  struct Queued {
+    Queued *next{nullptr};
+    void (*take)(Queued *, ChartData *){nullptr};
+  };
+
+  template <typename Event> struct QueuedEvent : Queued {
+    Event event;
+  };
+
+  struct Pending {
+    Pending() = default;
+    Pending(const Pending &) = delete;
+    Pending &operator=(const Pending &) = delete;
+
+    void *task{nullptr};
+    void (*destroy)(void *){nullptr};
+    void (*finish)(){nullptr};
+    StateIndex (*resume)(Access &){nullptr};
+    Queued *head{nullptr};
+    Queued *tail{nullptr};
+  };
+  struct NotPending {};
+
+  Queued *pop_queued() {
+    Queued *queued = _pending.head;
+    if (queued) {
+      _pending.head = queued->next;
+      if (!_pending.head) {
+        _pending.tail = nullptr;
+      }
+    }
+    return queued;
+  }
+
+  [[no_unique_address]] Objects _states;
+  [[no_unique_address]] ContextData _context;
+  StateIndex _current{0};
+  [[no_unique_address]]
+  typename RegionStates<StateIndex, Regions>::type _regions{};
+  [[no_unique_address]] Deferred _deferred;
+  [[no_unique_address]]
+  typename std::conditional<Async, Pending, NotPending>::type _pending;
+  [[no_unique_address]] Observer _observer;
+};
+
+template <typename Policy, typename... States> struct ChartDataOf {
+  using Context = typename ChartPolicy<Policy>::context;
+  using Engine = BasicEngine<Context, States...>;
+  using type = ChartData<
+      typename ChartPolicy<Policy>::observer, Context,
+      typename Engine::StateIndex,
+      typename std::conditional<std::is_void<Context>::value,
+                                std::array<void *, sizeof...(States)>,
+                                std::tuple<States...>>::type,
+      Engine::region_count, typename Engine::DeferredEvents,
+      ChartPolicy<Policy>::async>;
+};
+
+} // namespace details
+
+// State chart notifying Observer, see NoObserver for its interface. Policy is
+// observer or sctl::Async<Observer>. Use StateChart unless observer is
+// needed.
+template <typename Policy, typename... States>
+class BasicStateChart
+    : private details::ChartDataOf<Policy, States...>::type {
+  using ContextParameter = typename details::ChartPolicy<Policy>::context;
+  using Engine = details::BasicEngine<ContextParameter, States...>;
+  using StateIndex = typename Engine::StateIndex;
+  using Data = typename details::ChartDataOf<Policy, States...>::type;
+  using Access = typename Data::Access;
+  using Observer = typename details::ChartPolicy<Policy>::observer;
+  static constexpr bool async = details::ChartPolicy<Policy>::async;
+  static constexpr bool contextual = !std::is_void<ContextParameter>::value;
+
+  static_assert(!async || Engine::region_count == 0,
+                "asynchronous state chart does not support regions");
+  static_assert(!contextual || ((std::is_empty<States>::value &&
+                                 std::is_default_constructible<States>::value) &&
+                                ...),
+                "states of chart with context have to be empty, data of "
+                "chart belongs to context");
+
+public:
+  using Context = typename std::conditional<contextual, ContextParameter,
+                                            details::NoContext>::type;
+
+  BasicStateChart(States &...states) SCTL_NOEXCEPT requires(!contextual)
+      : Data{{std::addressof(states)...}, {}, {}} {}
+  BasicStateChart(Observer observer, States &...states) SCTL_NOEXCEPT
+      requires(!contextual)
+      : Data{{std::addressof(states)...}, {}, std::move(observer)} {}
+
+  explicit BasicStateChart(Context context = {}) SCTL_NOEXCEPT
+      requires contextual
+      : Data{{}, std::move(context), {}} {}
+  BasicStateChart(Observer observer, Context context) SCTL_NOEXCEPT
+      requires contextual
+      : Data{{}, std::move(context), std::move(observer)} {}
+
+  void start(bool call_entry = false) SCTL_NOEXCEPT {
+    auto access = this->access();
+    _current = Engine::start(access, call_entry);
+  }
+
+  template <typename Event> void handle(const Event &e) SCTL_NOEXCEPT {
+    if constexpr (async) {
+      if (_pending.task) {
+        queue(e);
+        return;
+      }
+    }
+    auto access = this->access();
+    if constexpr (defers) {
+      const auto before = configuration();
+      _current = Engine::dispatch_event(access, _current, e);
+      if (!_deferred.empty() && configuration() != before) {
+        recall_deferred();
+      }
+    } else {
+      _current = Engine::dispatch_event(access, _current, e);
+    }
+  }
+
+  // Dispatches alternative held by variant through single (event, state)
+  // table, cells where no state in parent chain handles event are empty
+  // unless chart is observed. Charts with regions, deferred events or tasks
+  // pick handle() of alternative from table indexed by variant instead.
+  template <typename... Events>
+  void handle(const std::variant<Events...> &e) SCTL_NOEXCEPT {
+    if constexpr (Engine::region_count > 0 || defers || async) {
+      handle_alternative(e, std::index_sequence_for<Events...>{});
+    } else {
+      auto access = this->access();
+      _current = Engine::dispatch_variant(access, _current, e);
+    }
+  }
+
+  // Handles events in order, span of std::variant of events is dispatched by
+  // alternative held by each element.
+  template <typename Event, std::size_t Extent>
+  void handle_batch(std::span<Event, Extent> events) SCTL_NOEXCEPT {
+    using E = typename std::remove_cv<Event>::type;
+    auto access = this->access();
+    StateIndex current = _current;
+
+    if constexpr (Engine::region_count > 0 || defers || async) {
+      for (const auto &event : events) {
+        handle(event);
+      }
+      return;
+    } else if constexpr (details::IsVariant<E>) {
+      for (const auto &event : events) {
+        current = Engine::dispatch_variant(access, current, event);
+      }
+    } else {
+      std::span<const E> rest{events};
+      while (!rest.empty()) {
+        current =
+            Engine::template batch_table<Access, E>[current](access, rest);
+      }
+    }
+
+    _current = current;
+  }
+
+  // Position of active state in States, sizeof...(States) before start().
+  std::size_t active_state() const SCTL_NOEXCEPT {
+    return _current ? _current - 1 : sizeof...(States);
+  }
+
+  // Handles event received as wire id and bytes of event, Wire is
+  // sctl::WireEvents from sctl_wire.h. Returns false for unknown id or size.
+  template <typename Wire>
+  bool handle_raw(std::uint32_t id,
+                  std::span<const std::byte> bytes) SCTL_NOEXCEPT {
+    return Wire::handle(*this, id, bytes);
+  }
+
+  // True if S is active state or parent of active state, in any region.
+  template <typename S> bool is_active() const SCTL_NOEXCEPT {
+    return Engine::template is_active<S>(_current) ||
+           std::any_of(_regions.begin(), _regions.end(), [](StateIndex r) {
+             return Engine::template is_active<S>(r);
+           });
+  }
+
+  Observer &observer() SCTL_NOEXCEPT { return _observer; }
+
+  Context &context() SCTL_NOEXCEPT requires contextual { return _context; }
+  const Context &context() const SCTL_NOEXCEPT requires contextual {
+    return _context;
+  }
+
+  static constexpr std::size_t max_enter_redirects =
+      Engine::max_enter_redirects;
+
+  // Number of deferred events of the largest type that fit in storage.
+  static constexpr std::size_t max_deferred = details::max_deferred;
+
+private:
+  using Deferred = typename Data::Deferred;
+
+public:
+  // Active state, active states of regions and deferred events, trivially
+  // copyable, with padding zeroed.
+  struct SnapshotRecord {
+    StateIndex current;
+    [[no_unique_address]] std::array<StateIndex, Engine::region_count> regions;
+    [[no_unique_address]] typename Deferred::Image deferred;
+  };
+  struct Snapshot {
+    std::uint64_t layout;
+    SnapshotRecord record;
+  };
+
+  // Hash of States, their regions and deferred events, key of snapshots.
+  static constexpr std::uint64_t snapshot_layout() { return Engine::layout; }
+
+  static constexpr std::size_t state_count() { return sizeof...(States); }
+
+  // Deferred events have to be trivially copyable.
+  Snapshot snapshot() const SCTL_NOEXCEPT {
+    static_assert(!async, "asynchronous state chart can not be snapshot");
+    Snapshot s;
+    std::memset(&s, 0, sizeof(s));
+    s.layout = Engine::layout;
+    s.record.current = _current;
+    s.record.regions = _regions;
+    _deferred.save(s.record.deferred);
+    return s;
+  }
+
+  // Brings chart to configuration of snapshot without calling exit(),
+  // enter() or observer, e.g. when standby takes over from failed instance.
+  // Returns false, leaving chart unchanged, when snapshot was taken from
+  // chart of other layout or is corrupt, also when its active states are
+  // not configuration chart can be in.
+  bool restore(const Snapshot &s) SCTL_NOEXCEPT {
+    static_assert(!async, "asynchronous state chart can not be restored");
+    if (s.layout != Engine::layout ||
+        !Engine::valid_configuration(s.record.current, s.record.regions) ||
+        !_deferred.load(s.record.deferred)) {
+      return false;
+    }
+    _current = s.record.current;
+    _regions = s.record.regions;
+    return true;
+  }
+
+private:
+  using typename Data::Queued;
+  using Data::_context;
+  using Data::_current;
+  using Data::_deferred;
+  using Data::_observer;
+  using Data::_pending;
+  using Data::_regions;
+
+  static constexpr bool defers = Engine::DeferredEvents::size > 0;
+
+  using Configuration = std::pair<StateIndex,
+                                  std::array<StateIndex, Engine::region_count>>;
+  Configuration configuration() const { return {_current, _regions}; }
+
+  template <typename Variant, std::size_t... I>
+  void handle_alternative(const Variant &e, std::index_sequence<I...>) {
+    using Handle = void (*)(BasicStateChart &, const Variant &);
+    static constexpr std::array<Handle, sizeof...(I)> table{
+        [](BasicStateChart &chart, const Variant &v) {
+          chart.handle(*std::get_if<I>(&v));
+        }...};
+    if (details::holds_event(e)) {
+      table[e.index()](*this, e);
+    }
+  }
+
+  // Dispatches every deferred event once more, oldest first. Events deferred
+  // again are kept for next change of active state.
+  void recall_deferred() {
+    for (std::size_t n = _deferred.size(); n > 0 && !_deferred.empty(); --n) {
+      _deferred.pop([this](const auto &event) { handle(event); });
+    }
+  }
+
+  template <typename Event> void queue(const Event &e) {
+    using Own = typename Data::template QueuedEvent<Event>;
+    auto *queued = new Own{{}, e};
+    queued->take = [](Queued *q, Data *data) {
+      auto *own = static_cast<Own *>(q);
+      const Event event{std::move(own->event)};
+      delete own;
+      if (data) {
+        static_cast<BasicStateChart *>(data)->handle(event);
+      }
+    };
+    (_pending.tail ? _pending.tail->next : _pending.head) = queued;
+    _pending.tail = queued;
+  }
+
+  // Called by task that was pending when it completes, continues transition,
+  // recalls deferred events when configuration changed and handles queued
+  // events until next task is pending.
+  static void complete(void *data) {
+    auto &self = static_cast<BasicStateChart &>(*static_cast<Data *>(data));
+    auto access = self.access();
+    const auto before = self.configuration();
+    self._current = self._pending.resume(access);
+    if constexpr (defers) {
+      if (!self._deferred.empty() && self.configuration() != before) {
+        self.recall_deferred();
+      }
+    }
+    while (!self._pending.task) {
+      Queued *queued = self.pop_queued();
+      if (!queued) {
+        break;
+      }
+      queued->take(queued, &self);
+    }
+  }
+
+  Access access() {
+    static constexpr typename Access::Tables tables{
+        Engine::parent_table.data(),
+        Engine::template region_exits<Access>(),
+        []() -> void (*)(void *) {
+          if constexpr (async) {
+            return &complete;
+          } else {
+            return nullptr;
+          }
+        }()};
+    return {*this, tables};
+  }
+};
+
+
+// sctl::StateChart<sctl::WithObserver<Observer>, States...> installs
+// observer, sctl::StateChart<States...> has none.
+template <typename... States>
+class StateChart : public BasicStateChart<NoObserver, States...> {
+public:
+  using BasicStateChart<NoObserver, States...>::BasicStateChart;
+};
+
+template <typename Observer, typename... States>
+class StateChart<WithObserver<Observer>, States...>
+    : public BasicStateChart<Observer, States...> {
+public:
+  using BasicStateChart<Observer, States...>::BasicStateChart;
+};
+
+// sctl::StateChart<sctl::WithContext<Context, Observer>, States...> is active
+// state and context, its empty states are kept in chart.
+template <typename Context, typename Observer, typename... States>
+class StateChart<WithContext<Context, Observer>, States...>
+    : public BasicStateChart<WithContext<Context, Observer>, States...> {
+public:
+  using BasicStateChart<WithContext<Context, Observer>,
+                        States...>::BasicStateChart;
+};
+
+// sctl::StateChart<sctl::Async<Observer>, States...> lets states return
+// sctl::Task, see sctl_task.h.
+template <typename Observer, typename... States>
+class StateChart<Async<Observer>, States...>
+    : public BasicStateChart<Async<Observer>, States...> {
+public:
+  using BasicStateChart<Async<Observer>, States...>::BasicStateChart;
 };
 
 } // namespace sctl
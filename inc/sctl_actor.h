@@ -0,0 +1,229 @@
+#pragma once
+
+#include <sctl_queue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace sctl {
+
+// Many independent actors, e.g. structs holding state objects and their
+// StateChart, run by pool of worker threads. Every actor has own mailbox,
+// EventQueue of Capacity events, and is handled by at most one worker at a
+// time, so its events are handled in order of posting and actor needs no
+// locking. Actor is sharded to worker by its id, worker without ready
+// actors of its own steals them from other shards. Actor has to have
+// handle(const std::variant<Events...> &), as StateChart has. Idle workers
+// and wait() sleep on atomic wait instead of spinning.
+template <typename Actor, std::size_t Capacity, typename... Events>
+class ActorSystem {
+public:
+  using Id = std::uint32_t;
+
+  // Events handled in one go before actor is put back to ready queue, so
+  // busy actor does not starve others of its shard.
+  static constexpr std::size_t batch = 64;
+
+  explicit ActorSystem(
+      std::size_t workers = std::max(1u, std::thread::hardware_concurrency()))
+      : _shards(std::max<std::size_t>(workers, 1)) {}
+
+  ActorSystem(const ActorSystem &) = delete;
+  ActorSystem &operator=(const ActorSystem &) = delete;
+
+  ~ActorSystem() { stop(); }
+
+  // Constructs actor from args, before start().
+  template <typename... Args> Id spawn(Args &&...args) {
+    _slots.push_back(std::make_unique<Slot>(std::forward<Args>(args)...));
+    return static_cast<Id>(_slots.size() - 1);
+  }
+
+  std::size_t size() const { return _slots.size(); }
+  std::size_t workers() const { return _shards.size(); }
+
+  // Actor can be accessed while system is not running or after wait().
+  Actor &actor(Id id) { return _slots[id]->actor; }
+
+  // Queues event to actor, from any thread, including workers handling
+  // other actors or this one. Returns false when mailbox is full, event is
+  // dropped then.
+  template <typename Event> bool post(Id id, const Event &e) {
+    Slot &slot = *_slots[id];
+    _pending.fetch_add(1, std::memory_order_relaxed);
+    if (!slot.mailbox.post(e)) {
+      if (_pending.fetch_sub(1, std::memory_order_release) == 1) {
+        _pending.notify_all();
+      }
+      return false;
+    }
+    // First event queued to idle actor schedules it.
+    if (slot.queued.fetch_add(1, std::memory_order_acq_rel) == 0) {
+      schedule(id);
+    }
+    return true;
+  }
+
+  void start() {
+    for (std::size_t w = 0; w < _shards.size(); ++w) {
+      _threads.emplace_back(
+          [this, w](std::stop_token stop) { work(stop, w); });
+    }
+  }
+
+  // Blocks until every posted event, including ones posted by handlers, is
+  // handled. System has to be started.
+  void wait() const {
+    for (auto pending = _pending.load(std::memory_order_acquire); pending;
+         pending = _pending.load(std::memory_order_acquire)) {
+      _pending.wait(pending, std::memory_order_acquire);
+    }
+  }
+
+  // Handles remaining events and joins workers.
+  void stop() {
+    if (!_threads.empty()) {
+      wait();
+      for (auto &thread : _threads) {
+        thread.request_stop();
+      }
+      _wake.fetch_add(1, std::memory_order_release);
+      _wake.notify_all();
+      _threads.clear();
+    }
+  }
+
+private:
+  static constexpr std::size_t cache_line = 64;
+
+  struct Slot {
+    template <typename... Args>
+    explicit Slot(Args &&...args) : actor{std::forward<Args>(args)...} {}
+
+    Actor actor;
+    EventQueue<Actor, Capacity, Events...> mailbox{actor};
+    std::atomic<std::size_t> queued{0};
+  };
+
+  // Ready actors of one worker.
+  struct alignas(cache_line) Shard {
+    std::mutex mutex;
+    std::deque<Id> ready;
+    std::atomic<std::size_t> size{0};
+  };
+
+  // Wakes one sleeping worker, if any, which takes actor from its shard or
+  // steals it.
+  void schedule(Id id) {
+    Shard &shard = _shards[id % _shards.size()];
+    {
+      const std::lock_guard lock{shard.mutex};
+      shard.ready.push_back(id);
+      shard.size.store(shard.ready.size(), std::memory_order_seq_cst);
+    }
+    if (_sleeping.load(std::memory_order_seq_cst) > 0) {
+      _wake.fetch_add(1, std::memory_order_release);
+      _wake.notify_one();
+    }
+  }
+
+  // Called with lock of shard held.
+  static bool pop(Shard &shard, bool front, Id &id) {
+    if (shard.ready.empty()) {
+      return false;
+    }
+    if (front) {
+      id = shard.ready.front();
+      shard.ready.pop_front();
+    } else {
+      id = shard.ready.back();
+      shard.ready.pop_back();
+    }
+    shard.size.store(shard.ready.size(), std::memory_order_seq_cst);
+    return true;
+  }
+
+  // Own shard is taken from front, in order of scheduling, other shards
+  // from back, skipping empty and contended ones.
+  bool next(std::size_t w, Id &id) {
+    Shard &own = _shards[w];
+    {
+      const std::lock_guard lock{own.mutex};
+      if (pop(own, true, id)) {
+        return true;
+      }
+    }
+    for (std::size_t i = 1; i < _shards.size(); ++i) {
+      Shard &other = _shards[(w + i) % _shards.size()];
+      if (other.size.load(std::memory_order_relaxed) == 0) {
+        continue;
+      }
+      const std::unique_lock lock{other.mutex, std::try_to_lock};
+      if (lock && pop(other, false, id)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Actor stays scheduled while it has counted events, at most that many
+  // are handled, so event handled before its producer counts it can not
+  // leave count at zero and let producer schedule actor twice.
+  void run(Id id) {
+    Slot &slot = *_slots[id];
+    const std::size_t counted = slot.queued.load(std::memory_order_acquire);
+    const std::size_t handled = slot.mailbox.drain(std::min(counted, batch));
+    if (_pending.fetch_sub(handled, std::memory_order_release) == handled) {
+      _pending.notify_all();
+    }
+    if (slot.queued.fetch_sub(handled, std::memory_order_acq_rel) != handled) {
+      schedule(id);
+    }
+  }
+
+  bool idle() const {
+    return std::all_of(_shards.begin(), _shards.end(), [](const Shard &s) {
+      return s.size.load(std::memory_order_seq_cst) == 0;
+    });
+  }
+
+  // Worker without work sleeps until actor is scheduled or system stops.
+  // It counts itself sleeping before checking that every shard is empty and
+  // schedule() stores shard size before reading that count, so either
+  // worker sees the actor or schedule() wakes it. Wake count is read before
+  // that, so wake after it makes wait() return at once. Workers that lost
+  // stealing to contention do not sleep, shard is not empty then.
+  void work(std::stop_token stop, std::size_t w) {
+    while (!stop.stop_requested()) {
+      Id id;
+      if (next(w, id)) {
+        run(id);
+        continue;
+      }
+      const auto seen = _wake.load(std::memory_order_acquire);
+      _sleeping.fetch_add(1, std::memory_order_seq_cst);
+      if (idle() && !stop.stop_requested()) {
+        _wake.wait(seen, std::memory_order_acquire);
+      }
+      _sleeping.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  std::vector<std::unique_ptr<Slot>> _slots;
+  std::vector<Shard> _shards;
+  alignas(cache_line) std::atomic<std::size_t> _pending{0};
+  alignas(cache_line) std::atomic<std::uint32_t> _wake{0};
+  std::atomic<std::uint32_t> _sleeping{0};
+  std::vector<std::jthread> _threads;
+};
+
+} // namespace sctl
@@ -2,17 +2,17 @@
 
 #include <sctl.h>
 
-#include <iterator>
+#include <array>
+#include <cstddef>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <tuple>
-#include <typeinfo>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
-// This is GCC specific!
-#include <cxxabi.h>
-
 namespace sctl::parser {
 
 struct State {
@@ -30,6 +30,92 @@ struct Transition {
 struct ParseResult {
   std::vector<State> states;
   std::vector<Transition> transitions;
+  std::vector<std::string> events;
+};
+
+// Index standing for no state or event.
+inline constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+// State as seen at compile time, parent and start_state are indexes of
+// states in chart or none.
+struct StaticState {
+  std::string_view name;
+  std::size_t parent;
+  std::size_t start_state;
+};
+
+// Result of handler or enter(), state is index of state in chart or none for
+// sctl::NoAction.
+struct StaticTarget {
+  std::string_view name;
+  std::size_t state;
+};
+
+// Handler of event, or enter() when event is none, with target_count targets
+// starting at first_target.
+struct StaticTransition {
+  std::size_t from;
+  std::size_t event;
+  std::size_t first_target;
+  std::size_t target_count;
+};
+
+// Sub states of every state of ParseResult, linked in one pass over parent
+// links. Roots and children of each state keep order of states.
+class Hierarchy {
+public:
+  explicit Hierarchy(const ParseResult &result)
+      : _first_child(result.states.size(), none),
+        _next_sibling(result.states.size(), none) {
+    std::unordered_map<std::string_view, std::size_t> index;
+    index.reserve(result.states.size());
+    for (std::size_t s = 0; s < result.states.size(); ++s) {
+      index.emplace(result.states[s].name, s);
+    }
+
+    std::vector<std::size_t> last_child(result.states.size(), none);
+    std::size_t last_root = none;
+    for (std::size_t s = 0; s < result.states.size(); ++s) {
+      const auto &parent = result.states[s].parent;
+      const auto found = parent ? index.find(*parent) : index.end();
+      if (found == index.end()) {
+        link(_first_root, last_root, s);
+      } else {
+        link(_first_child[found->second], last_child[found->second], s);
+      }
+    }
+  }
+
+  bool has_children(std::size_t state) const {
+    return _first_child[state] != none;
+  }
+
+  // Visits states depth first, enter(state, depth) before and
+  // leave(state, depth) after sub states.
+  template <typename Enter, typename Leave>
+  void walk(Enter &&enter, Leave &&leave) const {
+    walk(_first_root, 0, enter, leave);
+  }
+
+private:
+  void link(std::size_t &first, std::size_t &last, std::size_t state) {
+    (last == none ? first : _next_sibling[last]) = state;
+    last = state;
+  }
+
+  template <typename Enter, typename Leave>
+  void walk(std::size_t first, std::size_t depth, Enter &enter,
+            Leave &leave) const {
+    for (std::size_t s = first; s != none; s = _next_sibling[s]) {
+      enter(s, depth);
+      walk(_first_child[s], depth + 1, enter, leave);
+      leave(s, depth);
+    }
+  }
+
+  std::vector<std::size_t> _first_child;
+  std::vector<std::size_t> _next_sibling;
+  std::size_t _first_root{none};
 };
 
 namespace details {
@@ -42,128 +128,240 @@ template <typename S> struct ActionReturnStates<sctl::State<S>> {
 template <typename... S> struct ActionReturnStates<std::variant<S...>> {
   using type = std::tuple<S...>;
 };
+template <> struct ActionReturnStates<sctl::KeepState> {
+  using type = std::tuple<>;
+};
+template <sctl::details::IsTask T>
+struct ActionReturnStates<T> : ActionReturnStates<typename T::task_result> {};
 
-// This is GCC specific!
-template <typename T> static constexpr std::string get_typename() {
-  int status;
-  char *tname = abi::__cxa_demangle(typeid(T).name(), 0, 0, &status);
-  std::string r{tname};
-  free(tname);
-  return r;
-}
 
-template <typename S>
-static constexpr std::string get_statename(sctl::State<S>) {
-  return get_typename<S>();
+template <typename S> std::type_identity<S> target_of(sctl::State<S>);
+template <typename T> using TargetOf = typename decltype(target_of(T{}))::type;
+
+// Actions of states of chart with context take it as first argument,
+// Context is void for other charts.
+template <typename S, typename Context> struct EnterTargets {
+  using type = std::tuple<>;
+};
+template <sctl::details::HasEntryAction S>
+struct EnterTargets<S, void>
+    : ActionReturnStates<decltype(std::declval<S>().enter())> {};
+template <typename S, typename Context>
+requires requires(S &s, Context &c) { s.enter(c); }
+struct EnterTargets<S, Context>
+    : ActionReturnStates<decltype(std::declval<S &>().enter(
+          std::declval<Context &>()))> {};
+
+template <typename S, typename A, typename Context> struct HandleTargets {
+  using type = std::tuple<>;
+};
+template <typename S, typename A>
+requires sctl::details::HasHandler<S, A>
+struct HandleTargets<S, A, void>
+    : ActionReturnStates<decltype(std::declval<S>().handle(A{}))> {};
+template <typename S, typename A, typename Context>
+requires requires(S &s, Context &c, const A &a) { s.handle(c, a); }
+struct HandleTargets<S, A, Context>
+    : ActionReturnStates<decltype(std::declval<S &>().handle(
+          std::declval<Context &>(), std::declval<const A &>()))> {};
+
+template <typename List, typename S> constexpr std::size_t index_in() {
+  if constexpr (List::template contains<S>()) {
+    return List::template index_of<S>();
+  } else {
+    return none;
+  }
 }
 
-template <typename S> static constexpr std::optional<std::string> get_parent() {
+template <typename List, typename S> constexpr std::size_t parent_index() {
   if constexpr (sctl::details::Substate<S>) {
-    return get_typename<typename S::ParentState>();
+    return index_in<List, typename S::ParentState>();
   } else {
-    return {};
+    return none;
   }
 }
-template <typename S>
-static constexpr std::optional<std::string> get_start_state() {
+
+template <typename List, typename S> constexpr std::size_t start_index() {
   if constexpr (sctl::details::HasStartState<S>) {
-    return get_typename<typename S::StartState>();
+    return index_in<List, typename S::StartState>();
   } else {
-    return {};
+    return none;
   }
 }
-template <typename S> static constexpr State get_state(sctl::State<S>) {
-  return {get_typename<S>(), get_parent<S>(), get_start_state<S>()};
-}
 
-template <typename S, typename RetStates, typename A = void>
-static constexpr std::vector<Transition> gate_state_transitions() {
-  std::optional<std::string> action_str;
-  if constexpr (!std::is_same<A, void>::value) {
-    action_str = get_typename<A>();
-  }
+// Targets of single handler or enter(), T being tuple of its results.
+template <typename List, typename T> struct TargetRow;
+template <typename List, typename... T>
+struct TargetRow<List, std::tuple<T...>> {
+  static constexpr std::array<StaticTarget, sizeof...(T)> targets{
+      StaticTarget{sctl::details::type_name<TargetOf<T>>(),
+                   index_in<List, TargetOf<T>>()}...};
+};
 
-  return std::apply(
-      [&action_str](auto &&...s) -> std::vector<Transition> {
-        if constexpr (sizeof...(s) > 0) {
-          return {{get_typename<S>(), {get_statename(s)...}, action_str}};
-        } else {
-          return {};
-        }
-      },
-      typename details::ActionReturnStates<RetStates>::type{});
-}
+template <std::size_t Transitions, std::size_t Targets> struct Tables {
+  std::array<StaticTransition, Transitions> transitions{};
+  std::array<StaticTarget, Targets> targets{};
+  std::size_t transition_count{0};
+  std::size_t target_count{0};
+};
 
-template <typename S>
-static constexpr std::vector<Transition> get_state_begin_transitions() {
-  if constexpr (sctl::details::HasEntryAction<S>) {
-    return gate_state_transitions<S, decltype(std::declval<S>().enter())>();
-  } else {
-    return {};
+template <typename Row, typename T>
+constexpr void add_row(T &tables, std::size_t from, std::size_t event) {
+  if constexpr (Row::targets.size() > 0) {
+    tables.transitions[tables.transition_count++] = {
+        from, event, tables.target_count, Row::targets.size()};
+    for (const auto &target : Row::targets) {
+      tables.targets[tables.target_count++] = target;
+    }
   }
 }
 
-template <typename S, typename A>
-static constexpr std::vector<Transition> get_state_action_transitions() {
-  if constexpr (sctl::details::HasHandler<S, A>) {
-    return gate_state_transitions<S, decltype(std::declval<S>().handle(A{})),
-                                  A>();
-  } else {
-    return {};
-  }
+template <typename Context, typename List, typename S, typename Events,
+          typename T>
+constexpr void add_state(T &tables) {
+  constexpr std::size_t from = List::template index_of<S>();
+  add_row<TargetRow<List, typename EnterTargets<S, Context>::type>>(
+      tables, from, none);
+  [&tables]<typename... E>(sctl::details::TypeList<E...>) {
+    (add_row<TargetRow<List, typename HandleTargets<S, E, Context>::type>>(
+         tables, from, Events::template index_of<E>()),
+     ...);
+  }(Events{});
 }
 
-static void merge_transitions(std::vector<Transition> &dest,
-                              std::vector<Transition> src) {
-  dest.insert(dest.end(), std::make_move_iterator(src.begin()),
-              std::make_move_iterator(src.end()));
-}
+template <typename List, typename Targets> struct RowSize;
+template <typename List, typename... T>
+struct RowSize<List, std::tuple<T...>> {
+  static constexpr std::size_t targets = sizeof...(T);
+  static constexpr std::size_t transitions = sizeof...(T) > 0;
+};
 
-template <typename A> struct Action {};
-template <typename S, typename... Actions>
-static constexpr std::vector<Transition> get_state_actions_transitions() {
-  return std::apply(
-      []<typename... A>(Action<A> && ...) {
-        std::vector<Transition> r;
-        (merge_transitions(r, get_state_action_transitions<S, A>()), ...);
-        return r;
-      },
-      std::tuple<Action<Actions>...>{});
-}
+template <typename Context, typename List, typename S, typename Events>
+struct StateSize;
+template <typename Context, typename List, typename S, typename... E>
+struct StateSize<Context, List, S, sctl::details::TypeList<E...>> {
+  using Enter = RowSize<List, typename EnterTargets<S, Context>::type>;
+  static constexpr std::size_t targets =
+      (Enter::targets + ... +
+       RowSize<List, typename HandleTargets<S, E, Context>::type>::targets);
+  static constexpr std::size_t transitions =
+      (Enter::transitions + ... +
+       RowSize<List,
+               typename HandleTargets<S, E, Context>::type>::transitions);
+};
 
-template <typename S, typename... Actions>
-static constexpr std::vector<Transition> get_state_transitions() {
-  auto r = get_state_begin_transitions<S>();
-  merge_transitions(r, get_state_actions_transitions<S, Actions...>());
-  return r;
+// State and transition graph of chart, built at compile time.
+template <typename Context, typename List, typename Events> struct Graph;
+template <typename Context, typename... States, typename... Events>
+struct Graph<Context, sctl::details::TypeList<States...>,
+             sctl::details::TypeList<Events...>> {
+  using List = sctl::details::TypeList<States...>;
+  using EventList = sctl::details::TypeList<Events...>;
+
+  static constexpr std::array<StaticState, sizeof...(States)> states{
+      StaticState{sctl::details::type_name<States>(),
+                  parent_index<List, States>(),
+                  start_index<List, States>()}...};
+
+  static constexpr std::array<std::string_view, sizeof...(Events)> events{
+      sctl::details::type_name<Events>()...};
+
+  static constexpr auto tables = []() {
+    Tables<(StateSize<Context, List, States, EventList>::transitions + ... +
+            0),
+           (StateSize<Context, List, States, EventList>::targets + ... + 0)>
+        t;
+    (add_state<Context, List, States, EventList>(t), ...);
+    return t;
+  }();
+};
+
+template <typename States>
+std::optional<std::string> name_at(const States &states, std::size_t index) {
+  if (index == none) {
+    return {};
+  }
+  return std::string{states[index].name};
 }
 
 } // namespace details
 
-template <typename SC, typename... Actions> struct Parser;
-template <typename... States, typename... Actions>
-struct Parser<sctl::StateChart<States...>, Actions...> {
+// Parser of chart of States, whose actions take Context as first argument
+// unless it is void. Use Parser.
+template <typename Context, typename StateList, typename... Actions>
+struct BasicParser;
+template <typename Context, typename... States, typename... Actions>
+struct BasicParser<Context, sctl::details::TypeList<States...>, Actions...> {
+  using Graph = details::Graph<Context, sctl::details::TypeList<States...>,
+                              sctl::details::TypeList<Actions...>>;
+
+  // States in order of chart, indexes are positions in this array.
+  static constexpr const auto &states = Graph::states;
+  // Names of Actions, in order.
+  static constexpr const auto &events = Graph::events;
+  // Transitions of handlers and enter() actions, in order of States and
+  // Actions, enter() first.
+  static constexpr std::span<const StaticTransition> transitions{
+      Graph::tables.transitions};
+  static constexpr std::span<const StaticTarget> targets{
+      Graph::tables.targets};
+
+  static constexpr std::span<const StaticTarget>
+  targets_of(const StaticTransition &t) {
+    return targets.subspan(t.first_target, t.target_count);
+  }
+
   static constexpr std::vector<State> get_states() {
-    return std::apply(
-        [](auto &&...s) {
-          return std::vector<State>{details::get_state(s)...};
-        },
-        std::tuple<sctl::State<States>...>{});
+    std::vector<State> r;
+    for (const auto &s : states) {
+      r.push_back({std::string{s.name}, details::name_at(states, s.parent),
+                   details::name_at(states, s.start_state)});
+    }
+    return r;
   }
 
   static constexpr std::vector<Transition> get_transitions() {
-    return std::apply(
-        []<typename... S>(sctl::State<S> && ...) {
-          std::vector<Transition> r;
-          (details::merge_transitions(
-               r, details::get_state_transitions<S, Actions...>()),
-           ...);
-          return r;
-        },
-        std::tuple<sctl::State<States>...>{});
+    std::vector<Transition> r;
+    for (const auto &t : transitions) {
+      Transition transition{std::string{states[t.from].name}, {}, {}};
+      for (const auto &target : targets_of(t)) {
+        transition.to.emplace_back(target.name);
+      }
+      if (t.event != none) {
+        transition.action = std::string{events[t.event]};
+      }
+      r.push_back(std::move(transition));
+    }
+    return r;
   }
 
-  ParseResult operator()() { return {get_states(), get_transitions()}; };
+  static constexpr std::vector<std::string> get_events() {
+    return {std::string{sctl::details::type_name<Actions>()}...};
+  }
+
+  ParseResult operator()() {
+    return {get_states(), get_transitions(), get_events()};
+  };
 };
 
+template <typename SC, typename... Actions> struct Parser;
+template <typename... States, typename... Actions>
+struct Parser<sctl::StateChart<States...>, Actions...>
+    : BasicParser<void, sctl::details::TypeList<States...>, Actions...> {};
+
+template <typename Observer, typename... States, typename... Actions>
+struct Parser<sctl::StateChart<sctl::WithObserver<Observer>, States...>,
+              Actions...> : Parser<sctl::StateChart<States...>, Actions...> {};
+
+template <typename Observer, typename... States, typename... Actions>
+struct Parser<sctl::StateChart<sctl::Async<Observer>, States...>, Actions...>
+    : Parser<sctl::StateChart<States...>, Actions...> {};
+
+template <typename Context, typename Observer, typename... States,
+          typename... Actions>
+struct Parser<sctl::StateChart<sctl::WithContext<Context, Observer>,
+                               States...>,
+              Actions...>
+    : BasicParser<Context, sctl::details::TypeList<States...>, Actions...> {};
+
 } // namespace sctl::parser
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <sctl_parser.h>
+
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace sctl::parser {
+
+// Prints Graphviz DOT graph of ParseResult. States with sub states are
+// clusters holding point node named after state, transitions to state end
+// at it and it leads to start state.
+struct Dot {
+  ParseResult result;
+  Hierarchy hierarchy;
+
+  Dot(ParseResult r) : result{std::move(r)}, hierarchy{result} {}
+
+  friend std::ostream &operator<<(std::ostream &out, const Dot &d) {
+    const auto &states = d.result.states;
+
+    out << "digraph StateChart {\n"
+           "\tnode [shape=box, style=rounded];\n"
+           "\t\"[*]\" [shape=point];\n";
+    d.hierarchy.walk(
+        [&](std::size_t s, std::size_t depth) {
+          const std::string tabs(depth + 1, '\t');
+          if (d.hierarchy.has_children(s)) {
+            out << tabs << "subgraph " << Quoted{states[s].name, "cluster_"}
+                << " {\n"
+                << tabs << "\tlabel=" << Quoted{states[s].name} << ";\n"
+                << tabs << "\t" << Quoted{states[s].name}
+                << " [shape=point];\n";
+          } else {
+            out << tabs << Quoted{states[s].name} << ";\n";
+          }
+        },
+        [&](std::size_t s, std::size_t depth) {
+          if (d.hierarchy.has_children(s)) {
+            out << std::string(depth + 1, '\t') << "}\n";
+          }
+        });
+
+    if (!states.empty()) {
+      out << "\t\"[*]\" -> " << Quoted{states.front().name} << ";\n";
+    }
+    for (const auto &s : states) {
+      if (s.start_state) {
+        out << "\t" << Quoted{s.name} << " -> "
+            << Quoted{*s.start_state} << ";\n";
+      }
+    }
+    for (const auto &t : d.result.transitions) {
+      for (const auto &to : t.to) {
+        out << "\t" << Quoted{t.from} << " -> "
+            << Quoted{to == "sctl::NoAction" ? t.from : to};
+        if (t.action) {
+          out << " [label=" << Quoted{*t.action} << "]";
+        }
+        out << ";\n";
+      }
+    }
+    out << "}\n";
+    return out;
+  }
+
+private:
+  struct Quoted {
+    std::string_view name;
+    std::string_view prefix{};
+
+    friend std::ostream &operator<<(std::ostream &out, const Quoted &q) {
+      out << '"' << q.prefix;
+      for (const char c : q.name) {
+        if (c == '"' || c == '\\') {
+          out << '\\';
+        }
+        out << c;
+      }
+      return out << '"';
+    }
+  };
+};
+
+} // namespace sctl::parser
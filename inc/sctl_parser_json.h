@@ -0,0 +1,92 @@
+#pragma once
+
+#include <sctl_parser.h>
+
+#include <cstdio>
+#include <ostream>
+#include <string_view>
+
+namespace sctl::parser {
+
+// Prints ParseResult as JSON object with nested "states" (name, start_state
+// and sub states), "transitions" (from, to, event) and "events". Target
+// "sctl::NoAction" stands for handler keeping state.
+struct Json {
+  ParseResult result;
+  Hierarchy hierarchy;
+
+  Json(ParseResult r) : result{std::move(r)}, hierarchy{result} {}
+
+  friend std::ostream &operator<<(std::ostream &out, const Json &j) {
+    const auto &states = j.result.states;
+
+    out << "{\"states\":[";
+    bool comma = false;
+    j.hierarchy.walk(
+        [&](std::size_t s, std::size_t) {
+          out << (comma ? ",{\"name\":" : "{\"name\":")
+              << String{states[s].name};
+          if (states[s].start_state) {
+            out << ",\"start_state\":" << String{*states[s].start_state};
+          }
+          if (j.hierarchy.has_children(s)) {
+            out << ",\"states\":[";
+            comma = false;
+          } else {
+            out << "}";
+            comma = true;
+          }
+        },
+        [&](std::size_t s, std::size_t) {
+          if (j.hierarchy.has_children(s)) {
+            out << "]}";
+            comma = true;
+          }
+        });
+
+    out << "],\"transitions\":[";
+    comma = false;
+    for (const auto &t : j.result.transitions) {
+      out << (comma ? ",{\"from\":" : "{\"from\":") << String{t.from}
+          << ",\"to\":[";
+      for (std::size_t i = 0; i < t.to.size(); ++i) {
+        out << (i ? "," : "") << String{t.to[i]};
+      }
+      out << "]";
+      if (t.action) {
+        out << ",\"event\":" << String{*t.action};
+      }
+      out << "}";
+      comma = true;
+    }
+
+    out << "],\"events\":[";
+    for (std::size_t i = 0; i < j.result.events.size(); ++i) {
+      out << (i ? "," : "") << String{j.result.events[i]};
+    }
+    return out << "]}\n";
+  }
+
+private:
+  struct String {
+    std::string_view text;
+
+    friend std::ostream &operator<<(std::ostream &out, const String &s) {
+      out << '"';
+      for (const char c : s.text) {
+        if (c == '"' || c == '\\') {
+          out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[8];
+          std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          out << escaped;
+        } else {
+          out << c;
+        }
+      }
+      return out << '"';
+    }
+  };
+};
+
+} // namespace sctl::parser
@@ -2,93 +2,181 @@
 
 #include <sctl_parser.h>
 
-#include <memory>
+#include <algorithm>
 #include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_set>
 
 namespace sctl::parser {
 
+// Prints PlantUML state diagram of ParseResult, nested states are drawn
+// inside their parents. Result of handler keeping state is drawn as
+// self-transition, or with internal_transitions as internal transition
+// `State : Event` (`State : enter` for enter()), which parse_plantuml() reads
+// back as keeping state rather than leaving and entering it again.
 struct PlantUML {
-  std::vector<Transition> transitions;
+  ParseResult result;
+  Hierarchy hierarchy;
+  bool internal_transitions;
 
-  struct PlantState {
-    PlantState(const State &s) : name{s.name}, start_state{s.start_state} {}
+  PlantUML(ParseResult r, bool internal = false)
+      : result{std::move(r)}, hierarchy{result},
+        internal_transitions{internal} {}
 
-    void add_child(std::unique_ptr<PlantState> c) {
-      children.push_back(std::move(c));
-    }
-
-    std::string name;
-    std::optional<std::string> start_state;
-    std::vector<std::unique_ptr<PlantState>> children;
+  friend std::ostream &operator<<(std::ostream &out, const PlantUML &p) {
+    const auto &states = p.result.states;
+    const auto composite = [&p, &states](std::size_t s) {
+      return states[s].start_state || p.hierarchy.has_children(s);
+    };
 
-    void draw(std::ostream &out, size_t depth = 0) const {
-      const std::string tabs(depth, '\t');
-      out << tabs << "state " << name;
-      if (start_state) {
-        out << " {\n";
-        out << tabs << "\t[*] --> " << start_state.value() << "\n";
-        for (const auto &c : children) {
-          c->draw(out, depth + 1);
+    out << "@startuml\n";
+    p.hierarchy.walk(
+        [&](std::size_t s, std::size_t depth) {
+          const std::string tabs(depth, '\t');
+          out << tabs << "state " << states[s].name;
+          if (composite(s)) {
+            out << " {\n";
+            if (states[s].start_state) {
+              out << tabs << "\t[*] --> " << *states[s].start_state << "\n";
+            }
+          } else {
+            out << "\n";
+          }
+        },
+        [&](std::size_t s, std::size_t depth) {
+          if (composite(s)) {
+            out << std::string(depth, '\t') << "}\n";
+          }
+        });
+    if (!states.empty()) {
+      out << "[*] --> " << states.front().name << "\n";
+    }
+    for (const auto &t : p.result.transitions) {
+      for (const auto &to : t.to) {
+        if (to == "sctl::NoAction" && p.internal_transitions) {
+          out << t.from << " : " << (t.action ? *t.action : "enter") << "\n";
+          continue;
+        }
+        out << t.from << " --> " << (to == "sctl::NoAction" ? t.from : to);
+        if (t.action) {
+          out << ": " << *t.action;
         }
-        out << tabs << "}\n";
+        out << "\n";
       }
-      out << tabs << "\n";
     }
+    out << "@enduml\n";
+    return out;
+  }
+};
+
+// Reads back subset of PlantUML written by PlantUML with
+// internal_transitions: nested `state` blocks,
+// `[*] -->` start states, `From --> To: Event` transitions, transitions
+// without event being enter() redirects, and `State : Event` internal
+// transitions. Consecutive lines of the same state and event are one
+// transition with many targets. State only named by transition is added at
+// top level, other lines are skipped.
+inline ParseResult parse_plantuml(std::string_view text) {
+  const auto trim = [](std::string_view v) {
+    const auto begin = v.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos) {
+      return std::string_view{};
+    }
+    return v.substr(begin, v.find_last_not_of(" \t\r") - begin + 1);
   };
 
-  std::vector<std::unique_ptr<PlantState>> states;
-  std::string start_state;
+  ParseResult result;
+  std::vector<std::size_t> open;
+  std::string initial;
+  std::vector<std::string> named;
+  std::unordered_set<std::string> events;
 
-  PlantUML(const ParseResult &result) : transitions{result.transitions} {
-    std::map<std::string, State> map_raw_states;
-    std::map<std::string, std::unique_ptr<PlantState>> bucket;
-    start_state = result.states[0].name;
-    for (const auto &s : result.states) {
-      map_raw_states[s.name] = s;
-      bucket.emplace(s.name, std::make_unique<PlantState>(s));
+  const auto add = [&](std::string_view from, std::string_view to,
+                       std::optional<std::string> action) {
+    named.emplace_back(from);
+    named.emplace_back(to);
+    if (action && events.insert(*action).second) {
+      result.events.push_back(*action);
+    }
+    auto &transitions = result.transitions;
+    if (!transitions.empty() && transitions.back().from == from &&
+        transitions.back().action == action) {
+      transitions.back().to.emplace_back(to);
+    } else {
+      transitions.push_back({std::string{from}, {std::string{to}}, action});
     }
+  };
 
-    while (!bucket.empty()) {
-      for (auto it = bucket.begin(); it != bucket.end();) {
-        const auto &state = map_raw_states[it->first];
-        if (!state.start_state || [&map_raw_states, &bucket](auto name) {
-              for (const auto &[key, value] : bucket) {
-                if (map_raw_states[key].parent &&
-                    name == map_raw_states[key].parent) {
-                  return false;
-                }
-              }
-              return true;
-            }(state.name)) {
-          if (state.parent && bucket.contains(state.parent.value())) {
-            bucket[state.parent.value()]->add_child(std::move(it->second));
-          } else {
-            states.push_back(std::move(it->second));
-          }
-          bucket.erase(it++);
+  while (!text.empty()) {
+    const auto end = std::min(text.find('\n'), text.size());
+    const auto line = trim(text.substr(0, end));
+    text.remove_prefix(std::min(end + 1, text.size()));
+
+    if (line.starts_with("state ")) {
+      auto name = trim(line.substr(6));
+      const bool block = name.ends_with('{');
+      if (block) {
+        name = trim(name.substr(0, name.size() - 1));
+      }
+      State state{std::string{name}, {}, {}};
+      if (!open.empty()) {
+        state.parent = result.states[open.back()].name;
+      }
+      result.states.push_back(std::move(state));
+      if (block) {
+        open.push_back(result.states.size() - 1);
+      }
+    } else if (line == "}") {
+      if (!open.empty()) {
+        open.pop_back();
+      }
+    } else if (const auto arrow = line.find("-->");
+               arrow != std::string_view::npos) {
+      const auto from = trim(line.substr(0, arrow));
+      auto to = trim(line.substr(arrow + 3));
+      std::optional<std::string> action;
+      if (const auto colon = to.find(": "); colon != std::string_view::npos) {
+        action = std::string{trim(to.substr(colon + 1))};
+        to = trim(to.substr(0, colon));
+      }
+      if (from == "[*]") {
+        if (open.empty()) {
+          initial = to;
         } else {
-          ++it;
+          result.states[open.back()].start_state = std::string{to};
         }
+        named.emplace_back(to);
+      } else {
+        add(from, to, std::move(action));
       }
+    } else if (const auto colon = line.find(" : ");
+               colon != std::string_view::npos) {
+      const auto action = trim(line.substr(colon + 3));
+      add(trim(line.substr(0, colon)), "sctl::NoAction",
+          action == "enter" ? std::nullopt
+                            : std::optional<std::string>{action});
     }
   }
 
-  friend std::ostream &operator<<(std::ostream &out, const PlantUML &p) {
-    out << "@startuml\n";
-    for (const auto &s : p.states) {
-      s->draw(out);
-    }
-    out << "[*] --> " << p.start_state << "\n";
-    for (const auto &t : p.transitions) {
-      for (const auto &d : t.to) {
-        using namespace std::string_literals;
-        out << t.from << " --> " << (d == "sctl::NoAction" ? t.from : d)
-            << (t.action ? ": "s + t.action.value() : ""s) << "\n";
-      }
+  std::unordered_set<std::string> declared;
+  for (const auto &s : result.states) {
+    declared.insert(s.name);
+  }
+  for (auto &name : named) {
+    if (name != "sctl::NoAction" && declared.insert(name).second) {
+      result.states.push_back({std::move(name), {}, {}});
     }
-    out << "@enduml\n";
-    return out;
   }
-};
+
+  // Initial state goes first, as in chart.
+  const auto first = std::find_if(
+      result.states.begin(), result.states.end(),
+      [&initial](const State &s) { return s.name == initial; });
+  if (first != result.states.end()) {
+    std::rotate(result.states.begin(), first, first + 1);
+  }
+  return result;
+}
 
 } // namespace sctl::parser
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <sctl_parser.h>
+#include <sctl_profile.h>
+
+#include <algorithm>
+#include <array>
+#include <ostream>
+
+namespace sctl::parser {
+
+// Prints profile of every measured handler and action, summed over threads,
+// with names of states and events taken from ParseResult of Parser given
+// events of ProfileObserver. Percentiles are lower bounds of histogram
+// buckets, max is exact.
+struct Profile {
+  struct Row {
+    std::string name;
+    std::uint64_t count{0};
+    std::uint64_t total_ticks{0};
+    std::uint64_t max_ticks{0};
+    std::array<std::uint64_t, profile_buckets> buckets{};
+
+    // Lower bound, in ticks, of bucket holding given fraction of
+    // measurements.
+    std::uint64_t percentile(double fraction) const {
+      const auto rank = std::min(
+          static_cast<std::uint64_t>(fraction * static_cast<double>(count)),
+          count - 1);
+      std::uint64_t seen = 0;
+      for (std::size_t b = 0; b < profile_buckets; ++b) {
+        seen += buckets[b];
+        if (seen > rank) {
+          return profile_bucket_begin(b);
+        }
+      }
+      return 0;
+    }
+  };
+
+  std::vector<Row> rows;
+  std::uint64_t ticks_per_second;
+
+  Profile(const ParseResult &result, const ProfileSegment &segment)
+      : ticks_per_second{segment.ticks_per_second()} {
+    for (std::size_t state = 0; state < segment.states(); ++state) {
+      for (std::size_t column = 0; column < segment.columns(); ++column) {
+        Row row{entry_name(result, state, column, segment.events())};
+        for (std::size_t thread = 0; thread < segment.threads(); ++thread) {
+          const auto &entry = segment.entry(thread, state, column);
+          row.count += ProfileSegment::load(entry.count);
+          row.total_ticks += ProfileSegment::load(entry.total_ticks);
+          row.max_ticks =
+              std::max(row.max_ticks, ProfileSegment::load(entry.max_ticks));
+          for (std::size_t b = 0; b < profile_buckets; ++b) {
+            row.buckets[b] += ProfileSegment::load(entry.buckets[b]);
+          }
+        }
+        if (row.count) {
+          rows.push_back(std::move(row));
+        }
+      }
+    }
+  }
+
+  friend std::ostream &operator<<(std::ostream &out, const Profile &p) {
+    out << "name,count,mean_ns,p50_ns,p99_ns,max_ns\n";
+    for (const auto &r : p.rows) {
+      out << r.name << "," << r.count << "," << p.ns(r.total_ticks / r.count)
+          << "," << p.ns(r.percentile(0.5)) << ","
+          << p.ns(r.percentile(0.99)) << "," << p.ns(r.max_ticks) << "\n";
+    }
+    return out;
+  }
+
+private:
+  std::uint64_t ns(std::uint64_t ticks) const {
+    return static_cast<std::uint64_t>(static_cast<double>(ticks) * 1e9 /
+                                      ticks_per_second);
+  }
+
+  static std::string entry_name(const ParseResult &result, std::size_t state,
+                                std::size_t column, std::size_t events) {
+    std::string name = state < result.states.size()
+                           ? result.states[state].name
+                           : std::to_string(state);
+    if (column == events) {
+      return name + "::enter";
+    } else if (column == events + 1) {
+      return name + "::exit";
+    }
+    return name + "::handle(" +
+           (column < result.events.size() ? result.events[column]
+                                          : std::to_string(column)) +
+           ")";
+  }
+};
+
+} // namespace sctl::parser
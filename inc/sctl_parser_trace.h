@@ -0,0 +1,55 @@
+#pragma once
+
+#include <sctl_parser.h>
+#include <sctl_trace.h>
+
+#include <ostream>
+
+namespace sctl::parser {
+
+// Prints trace records, one per line, with names of states and events taken
+// from ParseResult of Parser given events of TraceObserver.
+struct Trace {
+  std::vector<std::string> states;
+  std::vector<std::string> events;
+  std::vector<TraceRecord> records;
+
+  Trace(const ParseResult &result, std::vector<TraceRecord> trace)
+      : events{result.events}, records{std::move(trace)} {
+    for (const auto &s : result.states) {
+      states.push_back(s.name);
+    }
+  }
+
+  friend std::ostream &operator<<(std::ostream &out, const Trace &t) {
+    for (const auto &r : t.records) {
+      out << r.timestamp << " ";
+      switch (r.kind) {
+      case TraceKind::Event:
+        out << "event " << name(t.events, r.event);
+        break;
+      case TraceKind::Exit:
+        out << "exit " << name(t.states, r.state);
+        break;
+      case TraceKind::Enter:
+        out << "enter " << name(t.states, r.state);
+        break;
+      case TraceKind::Transition:
+        out << "transition " << name(t.states, r.state) << " -> "
+            << name(t.states, r.target);
+        break;
+      }
+      out << "\n";
+    }
+    return out;
+  }
+
+private:
+  static const std::string &name(const std::vector<std::string> &names,
+                                 std::uint16_t index) {
+    static const std::string unknown{"?"};
+    return index < names.size() ? names[index] : unknown;
+  }
+};
+
+} // namespace sctl::parser
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <sctl.h>
+#include <sctl_snapshot.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <tuple>
+#include <vector>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+namespace sctl {
+
+namespace details {
+
+// Access of engine to single instance of StateChartPool: objects of states
+// with data are arrays indexed by instance id, states without data have
+// single object per pool.
+template <typename Id, typename StateIndex> struct PoolAccess {
+  static constexpr std::size_t region_count = 0;
+
+  void *const *objects;
+  const StateIndex *parents;
+  Id id;
+
+  template <typename S> S &get(std::size_t index) {
+    if constexpr (std::is_empty<S>::value) {
+      return *static_cast<S *>(objects[index - 1]);
+    } else {
+      return static_cast<S *>(objects[index - 1])[id];
+    }
+  }
+  std::size_t parent(std::size_t index) const { return parents[index]; }
+  NoObserver observer() { return {}; }
+};
+
+// Every instance of group moves to Destination, known at compile time.
+template <std::size_t Destination, typename Id, typename StateIndex>
+void assign_pool_group(PoolAccess<Id, StateIndex> &, StateIndex *current,
+                       std::span<const Id> ids, const void *) {
+  for (const auto id : ids) {
+    current[id] = Destination;
+  }
+}
+
+template <typename Node, typename S, typename Event, typename Id,
+          typename StateIndex>
+void dispatch_pool_group(PoolAccess<Id, StateIndex> &access,
+                         StateIndex *current, std::span<const Id> ids,
+                         const void *event) {
+  const auto &e = *static_cast<const Event *>(event);
+  for (const auto id : ids) {
+    access.id = id;
+    current[id] = Node::template dispatch<S>(access, e);
+  }
+}
+
+} // namespace details
+
+// Many instances of one state chart. Active state of every instance is kept
+// in dense array of state indexes, objects of states with data are kept in
+// per-state columns indexed by instance id, states without data are shared.
+template <typename... States> class StateChartPool {
+  using Engine = details::Engine<States...>;
+  static constexpr std::size_t table_stride = Engine::table_stride;
+
+  static_assert(Engine::region_count == 0,
+                "StateChartPool does not support regions");
+  static_assert(Engine::DeferredEvents::size == 0,
+                "StateChartPool does not support deferred events");
+
+public:
+  using Id = std::uint32_t;
+  using StateIndex = typename Engine::StateIndex;
+
+  explicit StateChartPool(std::size_t size)
+      : _current(size, 0), _columns{Column<States>(size)...},
+        _objects{objects()} {}
+
+  // Objects of states are reached through pointers to columns, which copy
+  // and move have to take again.
+  StateChartPool(const StateChartPool &other)
+      : _current{other._current}, _columns{other._columns},
+        _objects{objects()} {}
+  StateChartPool(StateChartPool &&other)
+      : _current{std::move(other._current)},
+        _columns{std::move(other._columns)}, _objects{objects()} {}
+  StateChartPool &operator=(const StateChartPool &other) {
+    _current = other._current;
+    _columns = other._columns;
+    _objects = objects();
+    return *this;
+  }
+  StateChartPool &operator=(StateChartPool &&other) {
+    _current = std::move(other._current);
+    _columns = std::move(other._columns);
+    _objects = objects();
+    return *this;
+  }
+
+  std::size_t size() const { return _current.size(); }
+
+  void start(bool call_entry = false) {
+    for (Id id = 0; id < size(); ++id) {
+      start(id, call_entry);
+    }
+  }
+
+  void start(Id id, bool call_entry = false) {
+    Access access{_objects.data(), Engine::parent_table.data(), id};
+    _current[id] = Engine::start(access, call_entry);
+  }
+
+  template <typename Event> void handle(Id id, const Event &e) {
+    Access access{_objects.data(), Engine::parent_table.data(), id};
+    _current[id] =
+        Engine::template dispatch_table<Access, Event>[_current[id]](access, e);
+  }
+
+  // Instances are grouped by active state and every group is handled by
+  // single table entry. Ids have to be unique.
+  template <typename Event>
+  void handle(std::span<const Id> ids, const Event &e) {
+    if constexpr (all_static<Event>()) {
+      for (const auto id : ids) {
+        _current[id] = static_table<Event>[_current[id]];
+      }
+    } else {
+      group(ids);
+      handle_groups(e);
+    }
+  }
+
+  template <typename Event> void broadcast(const Event &e) {
+    if constexpr (all_static<Event>()) {
+      apply_table(_current, static_table<Event>);
+    } else {
+      group_all();
+      handle_groups(e);
+    }
+  }
+
+  template <typename S> S &state(Id id) {
+    return Access{_objects.data(), Engine::parent_table.data(), id}
+        .template get<S>(Engine::template index_of<S>());
+  }
+
+  // True if S is active state or parent of active state of instance.
+  template <typename S> bool is_active(Id id) const {
+    return Engine::template is_active<S>(_current[id]);
+  }
+
+  // Active states of all instances written after SnapshotHeader as single
+  // array, objects of states are not included.
+  std::size_t snapshot_size() const {
+    return details::snapshot_buffer_size<StateIndex>(size());
+  }
+
+  // Returns number of bytes written, 0 when out is too small.
+  std::size_t snapshot(std::span<std::byte> out) const {
+    std::byte *at = details::write_snapshot_header<StateIndex>(
+        Engine::layout, size(), out);
+    if (!at) {
+      return 0;
+    }
+    const auto states = std::as_bytes(std::span{_current});
+    std::copy(states.begin(), states.end(), at);
+    return snapshot_size();
+  }
+
+  // Restores active states without calling enter(), bytes can be mmap'ed
+  // snapshot. Returns false, leaving pool unchanged, when snapshot was taken
+  // from pool of other layout or size or is corrupt, e.g. has composite
+  // state active.
+  bool restore(std::span<const std::byte> bytes) {
+    const auto records =
+        details::read_snapshot_records<StateIndex>(Engine::layout, bytes);
+    if (!records.data() || records.size() != size() ||
+        std::any_of(records.begin(), records.end(),
+                    [](StateIndex s) {
+                      return !Engine::valid_configuration(s, {});
+                    })) {
+      return false;
+    }
+    std::copy(records.begin(), records.end(), _current.begin());
+    return true;
+  }
+
+private:
+  using Access = details::PoolAccess<Id, StateIndex>;
+
+  template <typename S> struct Column {
+    explicit Column(std::size_t size) : objects(size) {}
+    void *data() { return objects.data(); }
+    std::vector<S> objects;
+  };
+  template <typename S>
+  requires std::is_empty<S>::value struct Column<S> {
+    explicit Column(std::size_t) {}
+    void *data() { return &object; }
+    S object;
+  };
+
+  std::array<void *, sizeof...(States)> objects() {
+    return {std::get<Column<States>>(_columns).data()...};
+  }
+
+  std::vector<StateIndex> _current;
+  std::tuple<Column<States>...> _columns;
+  std::array<void *, sizeof...(States)> _objects;
+
+  std::vector<Id> _grouped;
+  std::array<std::size_t, table_stride + 1> _group_begin{};
+
+  template <typename Event> static constexpr bool all_static() {
+    return ((Engine::template static_destination<States, Event>() !=
+             table_stride) &&
+            ...);
+  }
+
+  template <typename Event>
+  static constexpr std::array<StateIndex, table_stride> static_table{
+      0, static_cast<StateIndex>(
+             Engine::template static_destination<States, Event>())...};
+
+  using Group = void (*)(Access &, StateIndex *, std::span<const Id>,
+                         const void *);
+
+  template <typename S, typename Event> static constexpr Group group_cell() {
+    constexpr std::size_t destination =
+        Engine::template static_destination<S, Event>();
+
+    if constexpr (destination != table_stride) {
+      return &details::assign_pool_group<destination, Id, StateIndex>;
+    } else {
+      return &details::dispatch_pool_group<
+          typename Engine::template DispatchNode<S, Event>, S, Event, Id,
+          StateIndex>;
+    }
+  }
+
+  template <typename Event>
+  static constexpr std::array<Group, table_stride> group_table{
+      group_cell<NoAction, Event>(), group_cell<States, Event>()...};
+
+  template <typename Event> void handle_groups(const Event &e) {
+    Access access{_objects.data(), Engine::parent_table.data(), 0};
+    for (std::size_t s = 0; s < table_stride; ++s) {
+      const auto begin = _group_begin[s];
+      const auto end = _group_begin[s + 1];
+      if (begin != end) {
+        group_table<Event>[s](
+            access, _current.data(),
+            std::span<const Id>{_grouped}.subspan(begin, end - begin), &e);
+      }
+    }
+  }
+
+  // Counting sort of ids by active state.
+  void group(std::span<const Id> ids) {
+    std::array<std::size_t, table_stride + 1> count{};
+    for (const auto id : ids) {
+      ++count[_current[id] + 1];
+    }
+    for (std::size_t s = 0; s < table_stride; ++s) {
+      count[s + 1] += count[s];
+    }
+    _group_begin = count;
+
+    _grouped.resize(ids.size());
+    for (const auto id : ids) {
+      _grouped[count[_current[id]]++] = id;
+    }
+  }
+
+  void group_all() {
+    std::array<std::size_t, table_stride + 1> count{};
+    for (const auto s : _current) {
+      ++count[s + 1];
+    }
+    for (std::size_t s = 0; s < table_stride; ++s) {
+      count[s + 1] += count[s];
+    }
+    _group_begin = count;
+
+    _grouped.resize(_current.size());
+    for (Id id = 0; id < _current.size(); ++id) {
+      _grouped[count[_current[id]]++] = id;
+    }
+  }
+
+  static void apply_table(std::span<StateIndex> states,
+                          const std::array<StateIndex, table_stride> &table) {
+    std::size_t i = 0;
+#if defined(__SSSE3__)
+    if constexpr (sizeof(StateIndex) == 1 && table_stride <= 16) {
+      alignas(16) std::array<StateIndex, 16> padded{};
+      std::copy(table.begin(), table.end(), padded.begin());
+      const __m128i lookup =
+          _mm_load_si128(reinterpret_cast<const __m128i *>(padded.data()));
+      for (; i + 16 <= states.size(); i += 16) {
+        auto *p = reinterpret_cast<__m128i *>(states.data() + i);
+        _mm_storeu_si128(p, _mm_shuffle_epi8(lookup, _mm_loadu_si128(p)));
+      }
+    }
+#endif
+    for (; i < states.size(); ++i) {
+      states[i] = table[states[i]];
+    }
+  }
+};
+
+} // namespace sctl
@@ -0,0 +1,333 @@
+#pragma once
+
+#include <sctl.h>
+#include <sctl_trace.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sctl {
+
+// Log-linear histogram of latencies in trace_timestamp() ticks, every power of
+// two range is split into profile_sub_buckets linear buckets.
+inline constexpr std::size_t profile_sub_bits = 2;
+inline constexpr std::size_t profile_sub_buckets = 1 << profile_sub_bits;
+inline constexpr std::size_t profile_buckets = 64 * profile_sub_buckets;
+
+constexpr std::size_t profile_bucket(std::uint64_t ticks) {
+  if (ticks < profile_sub_buckets) {
+    return ticks;
+  }
+  const std::size_t exponent = std::bit_width(ticks) - 1;
+  return (exponent - profile_sub_bits + 1) * profile_sub_buckets +
+         ((ticks >> (exponent - profile_sub_bits)) & (profile_sub_buckets - 1));
+}
+
+// Smallest latency counted in bucket.
+constexpr std::uint64_t profile_bucket_begin(std::size_t bucket) {
+  if (bucket < profile_sub_buckets) {
+    return bucket;
+  }
+  const std::size_t exponent =
+      bucket / profile_sub_buckets + profile_sub_bits - 1;
+  return (profile_sub_buckets + bucket % profile_sub_buckets)
+         << (exponent - profile_sub_bits);
+}
+
+// Statistics of single handler or action of single thread.
+struct ProfileEntry {
+  std::uint64_t count;
+  std::uint64_t total_ticks;
+  std::uint64_t max_ticks;
+  std::uint64_t buckets[profile_buckets];
+};
+
+struct ProfileHeader {
+  static constexpr std::uint64_t magic_value = 0x73637463'70726f66;
+
+  std::uint64_t magic;
+  std::uint64_t layout;
+  std::uint64_t ticks_per_second;
+  std::uint32_t states;
+  std::uint32_t events;
+  std::uint32_t max_threads;
+  std::uint32_t threads;
+};
+
+// POSIX shared memory segment with profile of one state chart, laid out as
+// header followed by max_threads blocks of states x (events + 2) entries.
+// Layout is hash of chart states and events, see profile_layout(), 0 when
+// not known.
+// Column of entry is position of event for handle(), events for enter() and
+// events + 1 for exit(). Every thread writes its own block, so entries are
+// updated without atomic read-modify-write, readers see them through relaxed
+// atomic loads.
+class ProfileSegment {
+public:
+  // Creates or resets segment of given name, e.g. "/my_chart".
+  ProfileSegment(const std::string &name, std::size_t states,
+                 std::size_t events, std::size_t max_threads = 16,
+                 std::uint64_t layout = 0)
+      : ProfileSegment{map(name, size(states, events, max_threads), true)} {
+    _header->layout = layout;
+    _header->ticks_per_second = trace_timestamp_frequency();
+    _header->states = states;
+    _header->events = events;
+    _header->max_threads = max_threads;
+    std::atomic_ref{_header->threads}.store(0, std::memory_order_relaxed);
+    std::atomic_ref{_header->magic}.store(ProfileHeader::magic_value,
+                                          std::memory_order_release);
+  }
+
+  // Segment of chart with given events.
+  template <typename Chart, typename... Events>
+  static ProfileSegment create(const std::string &name,
+                               std::size_t max_threads = 16) {
+    return ProfileSegment{name, Chart::state_count(), sizeof...(Events),
+                          max_threads, profile_layout<Chart, Events...>()};
+  }
+
+  template <typename Chart, typename... Events>
+  static constexpr std::uint64_t profile_layout() {
+    return details::hash(details::type_name<details::TypeList<Events...>>(),
+                         Chart::snapshot_layout());
+  }
+
+  // Opens existing segment read only. Throws when segment is not complete
+  // or, given layout, when it was written for other chart or events.
+  static ProfileSegment open(const std::string &name,
+                             std::uint64_t layout = 0) {
+    ProfileSegment segment{map(name, 0, false)};
+    if (std::atomic_ref{segment._header->magic}.load(
+            std::memory_order_acquire) != ProfileHeader::magic_value ||
+        segment._size < size(segment.states(), segment.events(),
+                             segment._header->max_threads) ||
+        (layout && segment.layout() != layout)) {
+      throw std::system_error{EINVAL, std::system_category(), name};
+    }
+    return segment;
+  }
+
+  static void remove(const std::string &name) { shm_unlink(name.c_str()); }
+
+  ProfileSegment(ProfileSegment &&other)
+      : _header{std::exchange(other._header, nullptr)},
+        _size{other._size}, _id{other._id} {}
+  ProfileSegment &operator=(ProfileSegment &&) = delete;
+
+  ~ProfileSegment() {
+    if (_header) {
+      munmap(_header, _size);
+    }
+  }
+
+  std::uint64_t layout() const { return _header->layout; }
+  std::uint64_t ticks_per_second() const { return _header->ticks_per_second; }
+  std::size_t states() const { return _header->states; }
+  std::size_t events() const { return _header->events; }
+  std::size_t columns() const { return _header->events + 2; }
+  std::size_t threads() const {
+    return std::min<std::size_t>(
+        std::atomic_ref{_header->threads}.load(std::memory_order_acquire),
+        _header->max_threads);
+  }
+
+  // Entry of thread, state and column within threads(), states() and
+  // columns().
+  const ProfileEntry &entry(std::size_t thread, std::size_t state,
+                            std::size_t column) const {
+    return block(thread)[state * columns() + column];
+  }
+
+  // Block of calling thread, claimed on first use. Nullptr when all blocks
+  // are taken. Looked up in list of segments used by thread, callers keep it
+  // together with thread_id().
+  ProfileEntry *local() {
+    thread_local std::vector<std::pair<std::uint64_t, ProfileEntry *>> claimed;
+    for (const auto &[id, entries] : claimed) {
+      if (id == _id) {
+        return entries;
+      }
+    }
+    const auto thread = std::atomic_ref{_header->threads}.fetch_add(
+        1, std::memory_order_acq_rel);
+    ProfileEntry *entries =
+        thread < _header->max_threads ? block(thread) : nullptr;
+    claimed.emplace_back(_id, entries);
+    return entries;
+  }
+
+  // Adds single measurement to entry of calling thread.
+  static void record(ProfileEntry &entry, std::uint64_t ticks) {
+    bump(entry.count, 1);
+    bump(entry.total_ticks, ticks);
+    raise(entry.max_ticks, ticks);
+    bump(entry.buckets[profile_bucket(ticks)], 1);
+  }
+
+  // Nonzero id of calling thread, unique for process lifetime.
+  static std::uint64_t thread_id() {
+    static std::atomic<std::uint64_t> next{0};
+    thread_local const std::uint64_t id = ++next;
+    return id;
+  }
+
+  static std::uint64_t load(const std::uint64_t &value) {
+    return std::atomic_ref{const_cast<std::uint64_t &>(value)}.load(
+        std::memory_order_relaxed);
+  }
+
+private:
+  explicit ProfileSegment(std::pair<void *, std::size_t> mapping)
+      : _header{static_cast<ProfileHeader *>(mapping.first)},
+        _size{mapping.second}, _id{next_id()} {}
+
+  static std::size_t size(std::size_t states, std::size_t events,
+                          std::size_t max_threads) {
+    return sizeof(ProfileHeader) +
+           max_threads * states * (events + 2) * sizeof(ProfileEntry);
+  }
+
+  static std::pair<void *, std::size_t> map(const std::string &name,
+                                            std::size_t size, bool create) {
+    const int fd = shm_open(name.c_str(), create ? O_CREAT | O_RDWR : O_RDONLY,
+                            0644);
+    if (fd < 0) {
+      throw std::system_error{errno, std::system_category(), name};
+    }
+    struct stat st;
+    if ((create && ftruncate(fd, 0) != 0) ||
+        (create && ftruncate(fd, size) != 0) || fstat(fd, &st) != 0) {
+      const int error = errno;
+      close(fd);
+      throw std::system_error{error, std::system_category(), name};
+    }
+    size = st.st_size;
+    void *address = mmap(nullptr, size, PROT_READ | (create ? PROT_WRITE : 0),
+                         MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED || size < sizeof(ProfileHeader)) {
+      throw std::system_error{EINVAL, std::system_category(), name};
+    }
+    return {address, size};
+  }
+
+  static std::uint64_t next_id() {
+    static std::atomic<std::uint64_t> id{0};
+    return ++id;
+  }
+
+  static void bump(std::uint64_t &value, std::uint64_t by) {
+    std::atomic_ref ref{value};
+    ref.store(ref.load(std::memory_order_relaxed) + by,
+              std::memory_order_relaxed);
+  }
+
+  static void raise(std::uint64_t &value, std::uint64_t to) {
+    std::atomic_ref ref{value};
+    if (ref.load(std::memory_order_relaxed) < to) {
+      ref.store(to, std::memory_order_relaxed);
+    }
+  }
+
+  ProfileEntry *block(std::size_t thread) const {
+    auto *entries = reinterpret_cast<ProfileEntry *>(_header + 1);
+    return entries + thread * states() * columns();
+  }
+
+  ProfileHeader *_header;
+  std::size_t _size;
+  std::uint64_t _id;
+};
+
+// Observer measuring every handle(), enter() and exit() call of states into
+// ProfileSegment created for the same number of states and Events, e.g. with
+// ProfileSegment::create<Chart, Events...>(). Throws std::invalid_argument
+// for segment of other number of events, states beyond segment are not
+// measured. Handlers of events not listed in Events are not measured. Block
+// of last calling thread is cached, so observer is used by one thread at a
+// time, as its chart.
+template <typename... Events> class ProfileObserver : public NoObserver {
+public:
+  ProfileObserver() = default;
+  explicit ProfileObserver(ProfileSegment &segment)
+      : _segment{&segment}, _states{segment.states()} {
+    if (segment.events() != sizeof...(Events)) {
+      throw std::invalid_argument{"profile segment of other events"};
+    }
+  }
+
+  template <typename S, typename Event, typename Handle>
+  decltype(auto) around_handle(std::size_t state, const Event &,
+                               Handle &&handle) {
+    using List = details::TypeList<Events...>;
+    if constexpr (List::template contains<Event>()) {
+      Measure measure{*this, state, List::template index_of<Event>()};
+      return handle();
+    } else {
+      return handle();
+    }
+  }
+
+  template <typename S, typename Exit>
+  void around_exit(std::size_t state, Exit &&exit) {
+    Measure measure{*this, state, sizeof...(Events) + 1};
+    exit();
+  }
+
+  template <typename S, typename Enter>
+  decltype(auto) around_enter(std::size_t state, Enter &&enter) {
+    Measure measure{*this, state, sizeof...(Events)};
+    return enter();
+  }
+
+private:
+  struct Measure {
+    ProfileObserver &observer;
+    std::size_t state;
+    std::size_t column;
+    std::uint64_t begin{trace_timestamp()};
+
+    ~Measure() {
+      const auto ticks = trace_timestamp() - begin;
+      auto *entries = observer.local();
+      if (entries && state < observer._states) {
+        ProfileSegment::record(
+            entries[state * (sizeof...(Events) + 2) + column], ticks);
+      }
+    }
+  };
+
+  ProfileEntry *local() {
+    if (!_segment) {
+      return nullptr;
+    }
+    const auto thread = ProfileSegment::thread_id();
+    if (_thread != thread) {
+      _entries = _segment->local();
+      _thread = thread;
+    }
+    return _entries;
+  }
+
+  ProfileSegment *_segment{nullptr};
+  std::size_t _states{0};
+  std::uint64_t _thread{0};
+  ProfileEntry *_entries{nullptr};
+};
+
+} // namespace sctl
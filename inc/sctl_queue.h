@@ -0,0 +1,125 @@
+#pragma once
+
+#include <sctl.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <stop_token>
+#include <thread>
+#include <variant>
+
+namespace sctl {
+
+// Bounded multi-producer single-consumer event queue feeding StateChart.
+// Events can be posted from any thread and from inside state handlers, they
+// are processed one at a time to completion by drain() or run() called from
+// single consumer thread.
+template <typename Chart, std::size_t Capacity, typename... Events>
+class EventQueue {
+  static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity has to be power of two");
+
+public:
+  using EventVariant = std::variant<Events...>;
+
+  EventQueue(Chart &chart) : _chart{chart} {
+    for (std::size_t i = 0; i < Capacity; ++i) {
+      _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  EventQueue(const EventQueue &) = delete;
+  EventQueue &operator=(const EventQueue &) = delete;
+
+  // Returns false when queue is full, event is dropped then.
+  template <typename Event> bool post(const Event &e) {
+    std::size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = _cells[pos & (Capacity - 1)];
+      const std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+      const auto diff =
+          static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (_enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          cell.event.template emplace<Event>(e);
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = _enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Handles queued events, including ones posted while draining, at most
+  // limit of them. Returns number of handled events, nested call from
+  // handler returns 0.
+  std::size_t drain(std::size_t limit = ~std::size_t{0}) {
+    if (_draining) {
+      return 0;
+    }
+    const DrainingGuard guard{_draining};
+
+    std::size_t handled = 0;
+    while (handled < limit) {
+      Cell &cell = _cells[_dequeue_pos & (Capacity - 1)];
+      if (cell.sequence.load(std::memory_order_acquire) != _dequeue_pos + 1) {
+        break;
+      }
+      const EventVariant event{std::move(cell.event)};
+      cell.sequence.store(_dequeue_pos + Capacity, std::memory_order_release);
+      ++_dequeue_pos;
+
+      _chart.handle(event);
+      ++handled;
+    }
+
+    return handled;
+  }
+
+  // True when no posted event is waiting, called by consumer.
+  bool empty() const {
+    return _cells[_dequeue_pos & (Capacity - 1)].sequence.load(
+               std::memory_order_acquire) != _dequeue_pos + 1;
+  }
+
+  void run(std::stop_token stop) {
+    while (!stop.stop_requested()) {
+      if (!drain()) {
+        std::this_thread::yield();
+      }
+    }
+    drain();
+  }
+
+private:
+  static constexpr std::size_t cache_line = 64;
+
+  struct Cell {
+    std::atomic<std::size_t> sequence;
+    EventVariant event;
+  };
+
+  // Clears draining flag also when handler throws, so that next drain()
+  // handles rest of queue.
+  struct DrainingGuard {
+    bool &draining;
+
+    DrainingGuard(bool &flag) : draining{flag} { draining = true; }
+    DrainingGuard(const DrainingGuard &) = delete;
+    DrainingGuard &operator=(const DrainingGuard &) = delete;
+    ~DrainingGuard() { draining = false; }
+  };
+
+  Chart &_chart;
+  std::array<Cell, Capacity> _cells;
+  alignas(cache_line) std::atomic<std::size_t> _enqueue_pos{0};
+  alignas(cache_line) std::size_t _dequeue_pos{0};
+  bool _draining{false};
+};
+
+} // namespace sctl
@@ -0,0 +1,380 @@
+#pragma once
+
+#include <sctl.h>
+#include <sctl_trace.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sctl {
+
+// Event log file is EventLogHeader followed by records, each EventLogRecord
+// followed by payload, bytes of event padded to 8 bytes. Written in native
+// byte order. Layout is hash of chart states and events, so log is replayed
+// only into chart of the same type.
+struct EventLogHeader {
+  static constexpr std::uint64_t magic_value = 0x73637463'72656364;
+
+  std::uint64_t magic;
+  std::uint64_t layout;
+  std::uint64_t ticks_per_second;
+  std::uint32_t events;
+  std::uint32_t reserved;
+};
+
+// Event is position of event type in recorder Events, state is position of
+// active state after handling it, timestamp in trace_timestamp() ticks is
+// taken before handling it. Size of payload is 0 for empty events.
+struct EventLogRecord {
+  std::uint64_t timestamp;
+  std::uint16_t event;
+  std::uint16_t state;
+  std::uint32_t size;
+};
+
+static_assert(sizeof(EventLogHeader) == 32 && sizeof(EventLogRecord) == 16);
+
+namespace details {
+
+template <typename Chart, typename... Events>
+constexpr std::uint64_t event_log_layout() {
+  return hash(type_name<TypeList<Events...>>(), Chart::snapshot_layout());
+}
+
+template <typename Event>
+constexpr std::size_t event_log_size =
+    std::is_empty<Event>::value ? 0 : sizeof(Event);
+
+constexpr std::size_t event_log_padded(std::size_t size) {
+  return (size + 7) / 8 * 8;
+}
+
+} // namespace details
+
+// Passes events to chart and appends them with active state after each one
+// to event log file, buffered, so that events handled by chart and their
+// effect can be replayed with EventReplayer. Events have to be trivially
+// copyable. Throws std::system_error when file can not be written.
+// Only events passed to recorder are logged, so every event source of chart,
+// timers and queues included, has to deliver through it for replay to be
+// deterministic. Deferred events recalled by chart are not logged, replay
+// recalls them the same way.
+template <typename Chart, typename... Events> class EventRecorder {
+  static_assert((std::is_trivially_copyable<Events>::value && ...),
+                "recorded events have to be trivially copyable");
+  static_assert(sizeof...(Events) <= 0xffff);
+
+public:
+  static constexpr std::size_t buffer_size = 64 * 1024;
+
+  // Creates or truncates file at path.
+  EventRecorder(Chart &chart, const std::string &path)
+      : _chart{chart},
+        _fd{::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_APPEND,
+                   0644)},
+        _path{path} {
+    if (_fd < 0) {
+      throw std::system_error{errno, std::system_category(), path};
+    }
+    const EventLogHeader header{
+        EventLogHeader::magic_value,
+        details::event_log_layout<Chart, Events...>(),
+        trace_timestamp_frequency(), sizeof...(Events), 0};
+    _buffer.reserve(buffer_size + sizeof(EventLogRecord) +
+                    details::event_log_padded(
+                        std::max({details::event_log_size<Events>...})));
+    _buffer.resize(sizeof(header));
+    std::memcpy(_buffer.data(), &header, sizeof(header));
+  }
+
+  EventRecorder(const EventRecorder &) = delete;
+  EventRecorder &operator=(const EventRecorder &) = delete;
+
+  // Records not written by flush() are lost if writing them fails here.
+  ~EventRecorder() {
+    try {
+      write_all();
+    } catch (const std::system_error &) {
+    }
+    ::close(_fd);
+  }
+
+  template <typename Event> void handle(const Event &e) {
+    using List = details::TypeList<Events...>;
+    static_assert(List::template contains<Event>(),
+                  "event is not one of recorded events");
+    constexpr std::size_t size = details::event_log_size<Event>;
+
+    const auto timestamp = trace_timestamp();
+    _chart.handle(e);
+    const EventLogRecord record{
+        timestamp, static_cast<std::uint16_t>(List::template index_of<Event>()),
+        static_cast<std::uint16_t>(_chart.active_state()), size};
+    const std::size_t at = _buffer.size();
+    _buffer.resize(at + sizeof(record) + details::event_log_padded(size));
+    std::memcpy(_buffer.data() + at, &record, sizeof(record));
+    std::memcpy(_buffer.data() + at + sizeof(record), &e, size);
+    if (_buffer.size() >= buffer_size) {
+      flush();
+    }
+  }
+
+  // Event held by variant is logged as its alternative.
+  template <typename... Alternatives>
+  void handle(const std::variant<Alternatives...> &e) {
+    using Handle = void (*)(EventRecorder &,
+                            const std::variant<Alternatives...> &);
+    static constexpr std::array<Handle, sizeof...(Alternatives)> table{
+        [](EventRecorder &recorder,
+           const std::variant<Alternatives...> &v) {
+          recorder.handle(*std::get_if<Alternatives>(&v));
+        }...};
+    if (!e.valueless_by_exception()) {
+      table[e.index()](*this, e);
+    }
+  }
+
+  // Writes buffered records to file, throws std::system_error on failure.
+  void flush() {
+    write_all();
+    _buffer.clear();
+  }
+
+private:
+  // Written bytes are dropped from buffer also on failure, so that retried
+  // flush() does not write them again. write() making no progress is EIO, as
+  // retrying it could loop forever.
+  void write_all() {
+    std::size_t written = 0;
+    while (written < _buffer.size()) {
+      const auto n =
+          ::write(_fd, _buffer.data() + written, _buffer.size() - written);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        const int error = n == 0 ? EIO : errno;
+        _buffer.erase(_buffer.begin(), _buffer.begin() + written);
+        throw std::system_error{error, std::system_category(), _path};
+      }
+      written += static_cast<std::size_t>(n);
+    }
+  }
+
+  Chart &_chart;
+  int _fd;
+  std::string _path;
+  std::vector<std::byte> _buffer;
+};
+
+// Event log file mapped read only. Record cut short at end of file, e.g.
+// when recording process was killed, is left out. Throws std::system_error
+// when file can not be read or is not event log.
+class EventLog {
+public:
+  struct Entry {
+    EventLogRecord record;
+    std::span<const std::byte> payload;
+  };
+
+  explicit EventLog(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::system_error{errno, std::system_category(), path};
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<std::size_t>(st.st_size) < sizeof(EventLogHeader)) {
+      ::close(fd);
+      throw std::system_error{EINVAL, std::system_category(), path};
+    }
+    _size = st.st_size;
+    void *address = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+      throw std::system_error{errno, std::system_category(), path};
+    }
+    _data = static_cast<const std::byte *>(address);
+    std::memcpy(&_header, _data, sizeof(_header));
+    if (_header.magic != EventLogHeader::magic_value) {
+      munmap(const_cast<std::byte *>(_data), _size);
+      throw std::system_error{EINVAL, std::system_category(), path};
+    }
+    index();
+  }
+
+  EventLog(const EventLog &) = delete;
+  EventLog &operator=(const EventLog &) = delete;
+
+  ~EventLog() { munmap(const_cast<std::byte *>(_data), _size); }
+
+  const EventLogHeader &header() const { return _header; }
+  std::size_t size() const { return _offsets.size(); }
+
+  // Payload is aligned to 8 bytes.
+  Entry operator[](std::size_t i) const {
+    Entry entry;
+    std::memcpy(&entry.record, _data + _offsets[i], sizeof(EventLogRecord));
+    entry.payload = {_data + _offsets[i] + sizeof(EventLogRecord),
+                     entry.record.size};
+    return entry;
+  }
+
+private:
+  void index() {
+    std::size_t at = sizeof(EventLogHeader);
+    while (_size - at >= sizeof(EventLogRecord)) {
+      EventLogRecord record;
+      std::memcpy(&record, _data + at, sizeof(record));
+      const std::size_t next = at + sizeof(record) +
+                               details::event_log_padded(record.size);
+      if (record.event >= _header.events || next > _size) {
+        break;
+      }
+      _offsets.push_back(at);
+      at = next;
+    }
+  }
+
+  const std::byte *_data{nullptr};
+  std::size_t _size{0};
+  EventLogHeader _header{};
+  std::vector<std::size_t> _offsets;
+};
+
+enum class ReplayPace { AsFastAsPossible, Recorded };
+
+// Result of replay. Latencies are of single handle() calls, in nanoseconds.
+// Mismatch is event after which active state differs from recorded one.
+struct ReplayReport {
+  std::size_t events{0};
+  double seconds{0};
+  double events_per_second{0};
+  double latency_p50{0};
+  double latency_p90{0};
+  double latency_p99{0};
+  double latency_p999{0};
+  double latency_max{0};
+  std::size_t mismatches{0};
+  std::size_t first_mismatch{0};
+};
+
+// Feeds events of EventLog written by EventRecorder of the same Chart and
+// Events to chart, that should be started the way recorded chart was.
+template <typename Chart, typename... Events> class EventReplayer {
+public:
+  explicit EventReplayer(Chart &chart) : _chart{chart} {}
+
+  // Throws std::invalid_argument when log was recorded for other chart or
+  // events or holds payload of wrong size.
+  ReplayReport replay(const EventLog &log,
+                      ReplayPace pace = ReplayPace::AsFastAsPossible) {
+    if (log.header().layout !=
+        details::event_log_layout<Chart, Events...>()) {
+      throw std::invalid_argument{"event log of other chart or events"};
+    }
+    for (std::size_t i = 0; i < log.size(); ++i) {
+      if (log[i].record.size != sizes[log[i].record.event]) {
+        throw std::invalid_argument{"event log record of wrong size"};
+      }
+    }
+
+    using Clock = std::chrono::steady_clock;
+    ReplayReport report;
+    report.events = log.size();
+    report.first_mismatch = log.size();
+    std::vector<std::uint64_t> ticks(log.size());
+    const double ticks_per_nanosecond =
+        static_cast<double>(trace_timestamp_frequency()) / 1e9;
+    const double recorded_per_nanosecond =
+        static_cast<double>(log.header().ticks_per_second) / 1e9;
+
+    const auto begin = Clock::now();
+    for (std::size_t i = 0; i < log.size(); ++i) {
+      const auto entry = log[i];
+      if (pace == ReplayPace::Recorded) {
+        const auto offset = static_cast<double>(entry.record.timestamp -
+                                                log[0].record.timestamp);
+        std::this_thread::sleep_until(
+            begin + std::chrono::nanoseconds{static_cast<std::int64_t>(
+                        offset / recorded_per_nanosecond)});
+      }
+      const auto start = trace_timestamp();
+      dispatch[entry.record.event](_chart, entry.payload.data());
+      ticks[i] = trace_timestamp() - start;
+      if (_chart.active_state() != entry.record.state) {
+        if (report.mismatches++ == 0) {
+          report.first_mismatch = i;
+        }
+      }
+    }
+    report.seconds =
+        std::chrono::duration<double>(Clock::now() - begin).count();
+    report.events_per_second =
+        report.seconds > 0 ? report.events / report.seconds : 0;
+
+    std::sort(ticks.begin(), ticks.end());
+    const auto percentile = [&ticks, ticks_per_nanosecond](double p) {
+      if (ticks.empty()) {
+        return 0.0;
+      }
+      const auto at = std::min(
+          ticks.size() - 1, static_cast<std::size_t>(p * ticks.size()));
+      return ticks[at] / ticks_per_nanosecond;
+    };
+    report.latency_p50 = percentile(0.5);
+    report.latency_p90 = percentile(0.9);
+    report.latency_p99 = percentile(0.99);
+    report.latency_p999 = percentile(0.999);
+    report.latency_max = percentile(1);
+    return report;
+  }
+
+private:
+  // Payload is aligned to 8 bytes by log, events aligned stricter than that
+  // are copied. Events are trivially copyable, so bytes of log hold one
+  // implicitly, reached through std::launder as in read_snapshot_records().
+  template <typename Event>
+  static void handle(Chart &chart, const std::byte *payload) {
+    if constexpr (std::is_empty<Event>::value) {
+      chart.handle(std::bit_cast<Event>(std::array<std::byte, 1>{}));
+    } else if constexpr (alignof(Event) <= 8) {
+      chart.handle(*std::launder(reinterpret_cast<const Event *>(payload)));
+    } else {
+      std::array<std::byte, sizeof(Event)> copy;
+      std::copy_n(payload, sizeof(Event), copy.begin());
+      chart.handle(std::bit_cast<Event>(copy));
+    }
+  }
+
+  static constexpr std::array<void (*)(Chart &, const std::byte *),
+                              sizeof...(Events)>
+      dispatch{&handle<Events>...};
+  static constexpr std::array<std::size_t, sizeof...(Events)> sizes{
+      details::event_log_size<Events>...};
+
+  Chart &_chart;
+};
+
+} // namespace sctl
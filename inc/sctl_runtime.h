@@ -0,0 +1,488 @@
+#pragma once
+
+#include <sctl_parser.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sctl::runtime {
+
+// Index of state, event or handler in Program.
+using Id = std::uint32_t;
+inline constexpr Id none = ~Id{0};
+
+// Returned by Action to keep active state.
+inline constexpr std::size_t keep = ~std::size_t{0};
+
+// Handler or enter() action bound in Registry, gets event passed to
+// Machine::handle() (nullptr for enter()) and returns position of chosen
+// target among targets of transition, or keep. Unbound actions choose first
+// target.
+struct Action {
+  std::size_t (*call)(void *context, const void *event){nullptr};
+  void *context{nullptr};
+};
+
+// exit() action bound in Registry.
+struct Hook {
+  void (*call)(void *context){nullptr};
+  void *context{nullptr};
+};
+
+// State chart compiled from ParseResult into flat arrays. Handlers of every
+// state, own and inherited from parents, are kept in CSR rows sorted by
+// event, and every target of every row has precomputed sequence of states
+// to exit and enter, so that dispatch is row lookup and array walk.
+// Transitions without event are enter() redirects. Regions and deferred
+// events are not described by ParseResult, so they are not supported.
+// Throws std::invalid_argument when result has no states, names unknown
+// states or enter() redirects can form a cycle.
+class Program {
+public:
+  explicit Program(const parser::ParseResult &result) {
+    add_states(result);
+    add_handlers(result);
+    check_redirects();
+    add_rows();
+  }
+
+  std::size_t states() const { return _state_names.size(); }
+  std::size_t events() const { return _event_names.size(); }
+
+  std::string_view state_name(Id state) const { return _state_names[state]; }
+  std::string_view event_name(Id event) const { return _event_names[event]; }
+
+  Id state(std::string_view name) const { return find(_state_ids, name); }
+  Id event(std::string_view name) const { return find(_event_ids, name); }
+
+  Id parent(Id state) const { return _parent[state]; }
+
+  // Handler of event declared by state itself, or none.
+  Id handler(Id state, Id event) const {
+    const auto found = _handler_ids.find(key(state, event));
+    return found == _handler_ids.end() ? none : found->second;
+  }
+
+private:
+  friend class Machine;
+  friend class Registry;
+
+  struct Handler {
+    Id first_target;
+    Id targets;
+  };
+
+  // States to exit, innermost first, followed by states to enter, outermost
+  // first, to is none for target keeping state.
+  struct Path {
+    Id to;
+    Id first;
+    Id exits;
+    Id enters;
+  };
+
+  static std::uint64_t key(Id state, Id event) {
+    return std::uint64_t{state} << 32 | event;
+  }
+
+  static Id find(const std::unordered_map<std::string, Id> &ids,
+                 std::string_view name) {
+    const auto found = ids.find(std::string{name});
+    return found == ids.end() ? none : found->second;
+  }
+
+  Id add_name(std::vector<std::string> &names,
+              std::unordered_map<std::string, Id> &ids,
+              const std::string &name) {
+    const auto [it, added] = ids.emplace(name, static_cast<Id>(names.size()));
+    if (added) {
+      names.push_back(name);
+    }
+    return it->second;
+  }
+
+  Id state_of(const std::string &name) const {
+    const Id s = find(_state_ids, name);
+    if (s == none) {
+      throw std::invalid_argument{"unknown state " + name};
+    }
+    return s;
+  }
+
+  void add_states(const parser::ParseResult &result) {
+    if (result.states.empty()) {
+      throw std::invalid_argument{"chart has no states"};
+    }
+    for (const auto &s : result.states) {
+      add_name(_state_names, _state_ids, s.name);
+    }
+    _parent.assign(states(), none);
+    _start.assign(states(), none);
+    for (const auto &s : result.states) {
+      const Id id = state_of(s.name);
+      if (s.parent) {
+        _parent[id] = state_of(*s.parent);
+      }
+      if (s.start_state) {
+        _start[id] = state_of(*s.start_state);
+      }
+    }
+
+    _depth.assign(states(), 0);
+    _leaf.resize(states());
+    for (Id s = 0; s < states(); ++s) {
+      for (Id p = _parent[s]; p != none; p = _parent[p]) {
+        if (++_depth[s] > states()) {
+          throw std::invalid_argument{"parents of " + _state_names[s] +
+                                      " form a cycle"};
+        }
+      }
+      _leaf[s] = s;
+      for (Id n = 0; _start[_leaf[s]] != none; ++n) {
+        if (n > states()) {
+          throw std::invalid_argument{"start states of " + _state_names[s] +
+                                      " form a cycle"};
+        }
+        _leaf[s] = _start[_leaf[s]];
+      }
+    }
+
+    for (const auto &e : result.events) {
+      add_name(_event_names, _event_ids, e);
+    }
+  }
+
+  void add_handlers(const parser::ParseResult &result) {
+    _enter.assign(states(), none);
+    for (const auto &t : result.transitions) {
+      const Id from = state_of(t.from);
+      Id &handler =
+          t.action ? _handler_ids
+                         .emplace(key(from, add_name(_event_names, _event_ids,
+                                                     *t.action)),
+                                  none)
+                         .first->second
+                   : _enter[from];
+      if (handler != none) {
+        throw std::invalid_argument{"handler of " + t.from +
+                                    " is listed twice"};
+      }
+      handler = static_cast<Id>(_handlers.size());
+      _handlers.push_back({static_cast<Id>(_targets.size()),
+                           static_cast<Id>(t.to.size())});
+      for (const auto &to : t.to) {
+        _targets.push_back(to == "sctl::NoAction" ? none : state_of(to));
+      }
+    }
+  }
+
+  std::vector<Id> chain(Id state) const {
+    std::vector<Id> c(_depth[state] + 1);
+    for (Id s = state; s != none; s = _parent[s]) {
+      c[_depth[s]] = s;
+    }
+    return c;
+  }
+
+  Id add_path(Id from, Id target) {
+    if (target == none) {
+      _paths.push_back({none, 0, 0, 0});
+      return static_cast<Id>(_paths.size() - 1);
+    }
+    const Id to = _leaf[target];
+    const auto from_chain = chain(from);
+    const auto to_chain = chain(to);
+    std::size_t common = 0;
+    while (common < std::min(from_chain.size(), to_chain.size()) &&
+           from_chain[common] == to_chain[common]) {
+      ++common;
+    }
+
+    Path path{to, static_cast<Id>(_path_states.size()), 0, 0};
+    if (common == from_chain.size()) {
+      _path_states.push_back(from);
+    } else {
+      _path_states.insert(_path_states.end(), from_chain.rbegin(),
+                          from_chain.rend() - common);
+    }
+    path.exits = static_cast<Id>(_path_states.size() - path.first);
+    if (common == to_chain.size()) {
+      _path_states.push_back(to);
+    } else {
+      _path_states.insert(_path_states.end(), to_chain.begin() + common,
+                          to_chain.end());
+    }
+    path.enters =
+        static_cast<Id>(_path_states.size() - path.first - path.exits);
+    _paths.push_back(path);
+    return static_cast<Id>(_paths.size() - 1);
+  }
+
+  // Every state entered on way to enter() redirect target can redirect
+  // again, as actions choose targets at run time any such cycle is
+  // rejected.
+  void check_redirects() {
+    std::vector<std::vector<Id>> next(states());
+    for (Id s = 0; s < states(); ++s) {
+      if (_enter[s] == none) {
+        continue;
+      }
+      const auto &h = _handlers[_enter[s]];
+      for (Id t = 0; t < h.targets; ++t) {
+        const Path path = _paths[add_path(s, _targets[h.first_target + t])];
+        for (Id i = 0; i < path.enters; ++i) {
+          const Id entered = _path_states[path.first + path.exits + i];
+          if (_enter[entered] != none) {
+            next[s].push_back(entered);
+          }
+        }
+      }
+    }
+    _paths.clear();
+    _path_states.clear();
+
+    enum Mark : std::uint8_t { Unvisited, Visiting, Visited };
+    std::vector<Mark> mark(states(), Unvisited);
+    const auto visit = [&](const auto &self, Id s) -> void {
+      mark[s] = Visiting;
+      for (const Id n : next[s]) {
+        if (mark[n] == Visiting) {
+          throw std::invalid_argument{"enter() redirects of " +
+                                      _state_names[n] + " form a cycle"};
+        }
+        if (mark[n] == Unvisited) {
+          self(self, n);
+        }
+      }
+      mark[s] = Visited;
+    };
+    for (Id s = 0; s < states(); ++s) {
+      if (mark[s] == Unvisited) {
+        visit(visit, s);
+      }
+    }
+  }
+
+  void add_rows() {
+    std::vector<std::vector<std::pair<Id, Id>>> declared(states());
+    for (const auto &[k, h] : _handler_ids) {
+      declared[k >> 32].emplace_back(static_cast<Id>(k), h);
+    }
+
+    _row.assign(1, 0);
+    std::vector<std::pair<Id, Id>> row;
+    for (Id s = 0; s < states(); ++s) {
+      // Handlers of state first, so stable sort keeps them before handlers
+      // of parents of the same event.
+      row.clear();
+      for (Id owner = s; owner != none; owner = _parent[owner]) {
+        row.insert(row.end(), declared[owner].begin(), declared[owner].end());
+      }
+      std::stable_sort(row.begin(), row.end(),
+                       [](const auto &a, const auto &b) {
+                         return a.first < b.first;
+                       });
+      row.erase(std::unique(row.begin(), row.end(),
+                            [](const auto &a, const auto &b) {
+                              return a.first == b.first;
+                            }),
+                row.end());
+      for (const auto &[e, h] : row) {
+        _row_event.push_back(e);
+        _row_handler.push_back(h);
+        _row_path.push_back(static_cast<Id>(_paths.size()));
+        for (Id t = 0; t < _handlers[h].targets; ++t) {
+          add_path(s, _targets[_handlers[h].first_target + t]);
+        }
+      }
+      _row.push_back(static_cast<Id>(_row_event.size()));
+    }
+
+    _enter_path.assign(states(), none);
+    for (Id s = 0; s < states(); ++s) {
+      if (_enter[s] != none) {
+        _enter_path[s] = static_cast<Id>(_paths.size());
+        const auto &h = _handlers[_enter[s]];
+        for (Id t = 0; t < h.targets; ++t) {
+          add_path(s, _targets[h.first_target + t]);
+        }
+      }
+    }
+
+    if (states() > 0) {
+      const auto start_chain = chain(_leaf[0]);
+      _start_path = static_cast<Id>(_paths.size());
+      _paths.push_back({_leaf[0], static_cast<Id>(_path_states.size()), 0,
+                        static_cast<Id>(start_chain.size())});
+      _path_states.insert(_path_states.end(), start_chain.begin(),
+                          start_chain.end());
+    }
+  }
+
+  std::vector<std::string> _state_names;
+  std::vector<std::string> _event_names;
+  std::unordered_map<std::string, Id> _state_ids;
+  std::unordered_map<std::string, Id> _event_ids;
+
+  std::vector<Id> _parent;
+  std::vector<Id> _start;
+  std::vector<Id> _depth;
+  std::vector<Id> _leaf;
+
+  std::unordered_map<std::uint64_t, Id> _handler_ids;
+  std::vector<Handler> _handlers;
+  std::vector<Id> _targets;
+  std::vector<Id> _enter;
+
+  std::vector<Id> _row;
+  std::vector<Id> _row_event;
+  std::vector<Id> _row_handler;
+  std::vector<Id> _row_path;
+  std::vector<Id> _enter_path;
+  Id _start_path{none};
+
+  std::vector<Path> _paths;
+  std::vector<Id> _path_states;
+};
+
+// Actions of states of Program, bound by names. Throws std::invalid_argument
+// for unknown state or handler.
+class Registry {
+public:
+  explicit Registry(const Program &program)
+      : _program{&program}, _handle(program._handlers.size()),
+        _enter(program.states()), _exit(program.states()) {}
+
+  void on_handle(std::string_view state, std::string_view event,
+                 Action action) {
+    const Id h = _program->handler(state_of(state), _program->event(event));
+    if (h == none) {
+      throw std::invalid_argument{std::string{state} + " does not handle " +
+                                  std::string{event}};
+    }
+    _handle[h] = action;
+  }
+
+  void on_enter(std::string_view state, Action action) {
+    _enter[state_of(state)] = action;
+  }
+
+  void on_exit(std::string_view state, Hook hook) {
+    _exit[state_of(state)] = hook;
+  }
+
+private:
+  friend class Machine;
+
+  Id state_of(std::string_view name) const {
+    const Id s = _program->state(name);
+    if (s == none) {
+      throw std::invalid_argument{"unknown state " + std::string{name}};
+    }
+    return s;
+  }
+
+  const Program *_program;
+  std::vector<Action> _handle;
+  std::vector<Action> _enter;
+  std::vector<Hook> _exit;
+};
+
+// Instance of Program, with actions of Registry. Both have to outlive it.
+class Machine {
+public:
+  Machine(const Program &program, const Registry &registry)
+      : _program{&program}, _registry{&registry} {}
+
+  void start(bool call_entry = false) {
+    const Program &p = *_program;
+    if (call_entry) {
+      run(p._start_path);
+    } else {
+      _current = p._paths[p._start_path].to;
+    }
+  }
+
+  // Returns false when neither active state nor its parents handle event.
+  bool handle(Id event, const void *data = nullptr) {
+    if (_current == none) {
+      return false;
+    }
+    const Program &p = *_program;
+    const auto begin = p._row_event.begin() + p._row[_current];
+    const auto end = p._row_event.begin() + p._row[_current + 1];
+    const auto found = std::lower_bound(begin, end, event);
+    if (found == end || *found != event) {
+      return false;
+    }
+    const auto row = found - p._row_event.begin();
+    const Id h = p._row_handler[row];
+    const std::size_t choice = call(_registry->_handle[h], data);
+    if (choice < p._handlers[h].targets) {
+      const Id path = p._row_path[row] + static_cast<Id>(choice);
+      if (p._paths[path].to != none) {
+        run(path);
+      }
+    }
+    return true;
+  }
+
+  Id current() const { return _current; }
+
+  // True if state is active state or its parent.
+  bool is_active(Id state) const {
+    for (Id s = _current; s != none; s = _program->_parent[s]) {
+      if (s == state) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  static std::size_t call(const Action &action, const void *data) {
+    return action.call ? action.call(action.context, data) : 0;
+  }
+
+  // Exits and enters states of path and of every enter() redirect met on
+  // the way, Program rejects redirect cycles so this ends.
+  void run(Id path) {
+    const Program &p = *_program;
+    while (path != none) {
+      const Program::Path &step = p._paths[path];
+      const Id *states = p._path_states.data() + step.first;
+      path = none;
+      for (Id i = 0; i < step.exits; ++i) {
+        const Hook &hook = _registry->_exit[states[i]];
+        if (hook.call) {
+          hook.call(hook.context);
+        }
+      }
+      _current = step.to;
+      for (Id i = step.exits; i < step.exits + step.enters; ++i) {
+        const Id s = states[i];
+        const std::size_t choice = call(_registry->_enter[s], nullptr);
+        const Id h = p._enter[s];
+        if (h != none && choice < p._handlers[h].targets &&
+            p._paths[p._enter_path[s] + choice].to != none) {
+          _current = s;
+          path = p._enter_path[s] + static_cast<Id>(choice);
+          break;
+        }
+      }
+    }
+  }
+
+  const Program *_program;
+  const Registry *_registry;
+  Id _current{none};
+};
+
+} // namespace sctl::runtime
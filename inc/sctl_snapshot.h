@@ -0,0 +1,140 @@
+#pragma once
+
+#include <sctl.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <span>
+#include <type_traits>
+
+namespace sctl {
+
+// Header of buffer holding snapshots of many charts of one type, followed by
+// count records of record_size bytes. Written in native byte order, so
+// buffer is read back in place, e.g. from mmap'ed file, by machine of the
+// same kind.
+struct SnapshotHeader {
+  static constexpr std::uint64_t magic_value = 0x73637463'736e6170;
+
+  std::uint64_t magic;
+  std::uint64_t layout;
+  std::uint64_t record_size;
+  std::uint64_t count;
+};
+
+namespace details {
+
+template <typename Record>
+constexpr std::size_t snapshot_buffer_size(std::size_t count) {
+  return sizeof(SnapshotHeader) + count * sizeof(Record);
+}
+
+// Writes header and returns position of first record, nullptr when out is
+// too small.
+template <typename Record>
+std::byte *write_snapshot_header(std::uint64_t layout, std::size_t count,
+                                 std::span<std::byte> out) {
+  if (out.size() < snapshot_buffer_size<Record>(count)) {
+    return nullptr;
+  }
+  const SnapshotHeader header{SnapshotHeader::magic_value, layout,
+                              sizeof(Record), count};
+  std::memcpy(out.data(), &header, sizeof(header));
+  return out.data() + sizeof(header);
+}
+
+// Records of buffer written with the same layout and record type, span
+// without data when buffer does not hold them or is misaligned.
+template <typename Record>
+std::span<const Record> read_snapshot_records(std::uint64_t layout,
+                                              std::span<const std::byte> in) {
+  if (in.size() < sizeof(SnapshotHeader) ||
+      reinterpret_cast<std::uintptr_t>(in.data()) %
+              std::max(alignof(SnapshotHeader), alignof(Record)) !=
+          0) {
+    return {};
+  }
+  SnapshotHeader header;
+  std::memcpy(&header, in.data(), sizeof(header));
+  if (header.magic != SnapshotHeader::magic_value || header.layout != layout ||
+      header.record_size != sizeof(Record) ||
+      header.count > (in.size() - sizeof(header)) / sizeof(Record)) {
+    return {};
+  }
+  return {std::launder(
+              reinterpret_cast<const Record *>(in.data() + sizeof(header))),
+          static_cast<std::size_t>(header.count)};
+}
+
+} // namespace details
+
+// Bytes taken by snapshots of count charts of type Chart.
+template <typename Chart>
+constexpr std::size_t snapshot_buffer_size(std::size_t count) {
+  return details::snapshot_buffer_size<typename Chart::SnapshotRecord>(count);
+}
+
+// Writes snapshots of charts, range of charts of one type, one after another
+// after SnapshotHeader. Returns number of bytes written, 0 when out is too
+// small.
+template <typename Range>
+std::size_t write_snapshots(const Range &charts, std::span<std::byte> out) {
+  using Chart = std::remove_cvref_t<decltype(*std::begin(charts))>;
+  using Record = typename Chart::SnapshotRecord;
+
+  const std::size_t count = std::size(charts);
+  std::byte *at = details::write_snapshot_header<Record>(
+      Chart::snapshot_layout(), count, out);
+  if (!at) {
+    return 0;
+  }
+  for (const auto &chart : charts) {
+    const auto snapshot = chart.snapshot();
+    std::memcpy(at, &snapshot.record, sizeof(Record));
+    at += sizeof(Record);
+  }
+  return snapshot_buffer_size<Chart>(count);
+}
+
+// Snapshots written by write_snapshots(), read in place. Buffer has to stay
+// valid and be aligned to 8 bytes, as mmap'ed file is. View of buffer with
+// other layout, record size or too short for its records is not valid and
+// empty.
+template <typename Chart> class SnapshotView {
+public:
+  using Record = typename Chart::SnapshotRecord;
+
+  explicit SnapshotView(std::span<const std::byte> bytes)
+      : _records{details::read_snapshot_records<Record>(
+            Chart::snapshot_layout(), bytes)} {}
+
+  bool valid() const { return _records.data() != nullptr; }
+  std::size_t size() const { return _records.size(); }
+
+  typename Chart::Snapshot operator[](std::size_t i) const {
+    return {Chart::snapshot_layout(), _records[i]};
+  }
+
+  // Restores charts, range of the same size as view, returns false when
+  // view is not valid or any snapshot is rejected.
+  template <typename Range> bool restore(Range &charts) const {
+    if (!valid() || std::size(charts) != size()) {
+      return false;
+    }
+    bool restored = true;
+    std::size_t i = 0;
+    for (auto &chart : charts) {
+      restored = chart.restore((*this)[i++]) && restored;
+    }
+    return restored;
+  }
+
+private:
+  std::span<const Record> _records;
+};
+
+} // namespace sctl
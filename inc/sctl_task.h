@@ -0,0 +1,224 @@
+#pragma once
+
+#include <sctl.h>
+
+#include <algorithm>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace sctl {
+
+namespace details {
+
+template <typename Result> struct TaskValue {
+  std::optional<Result> value;
+
+  template <typename T> void return_value(T &&v) {
+    value.emplace(std::forward<T>(v));
+  }
+  Result take() { return std::move(*value); }
+};
+
+template <> struct TaskValue<void> {
+  void return_void() {}
+  KeepState take() { return {}; }
+};
+
+} // namespace details
+
+// Coroutine returned from handle() or enter() of state in
+// sctl::StateChart<sctl::Async<>, States...>, Result is one of usual handle()
+// or enter() results, void stands for KeepState. State chart starts task
+// right away and continues transition when it completes, events handled
+// meanwhile are queued. Task can be awaited by other tasks, so it is also
+// usable for helper coroutines returning any Result. Exception escaping task
+// that was pending terminates, as there is no caller left to take it.
+template <typename Result = void> class Task {
+public:
+  using task_result =
+      typename std::conditional<std::is_void<Result>::value, KeepState,
+                                Result>::type;
+
+  struct promise_type : details::TaskValue<Result> {
+    std::coroutine_handle<> continuation;
+    void (*on_done)(void *){nullptr};
+    void *context{nullptr};
+    std::exception_ptr error;
+
+    Task get_return_object() {
+      return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    auto final_suspend() noexcept { return Final{}; }
+    void unhandled_exception() { error = std::current_exception(); }
+  };
+
+  Task(Task &&other) : _handle{std::exchange(other._handle, {})} {}
+  Task &operator=(Task &&) = delete;
+  ~Task() {
+    if (_handle) {
+      _handle.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<>
+  await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    _handle.promise().continuation = awaiting;
+    return _handle;
+  }
+  decltype(auto) await_resume() {
+    if constexpr (std::is_void<Result>::value) {
+      rethrow();
+    } else {
+      return result();
+    }
+  }
+
+  // Used by state chart. Runs task until it suspends, returns true if it
+  // completed, otherwise on_done(context) is called when it does.
+  bool start(void (*on_done)(void *), void *context) {
+    _handle.resume();
+    if (_handle.done()) {
+      return true;
+    }
+    _handle.promise().on_done = on_done;
+    _handle.promise().context = context;
+    return false;
+  }
+
+  task_result result() {
+    rethrow();
+    return _handle.promise().take();
+  }
+
+  // Used by state chart. Task of handler(event) that keeps copy of event in
+  // its frame, as event passed to handle() does not outlive suspension.
+  template <typename Handler, typename Event>
+  static Task keeping(Handler handler, Event event) {
+    co_return co_await handler(static_cast<const Event &>(event));
+  }
+
+  void *release() { return std::exchange(_handle, {}).address(); }
+  static Task adopt(void *frame) {
+    return Task{std::coroutine_handle<promise_type>::from_address(frame)};
+  }
+  static void destroy(void *frame) {
+    std::coroutine_handle<promise_type>::from_address(frame).destroy();
+  }
+
+private:
+  // Resumes awaiting task or notifies state chart, which may destroy
+  // completed task, so nothing is touched after on_done.
+  struct Final {
+    bool await_ready() noexcept { return false; }
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<promise_type> done) noexcept {
+      auto &promise = done.promise();
+      if (promise.continuation) {
+        return promise.continuation;
+      }
+      if (const auto on_done = promise.on_done) {
+        on_done(promise.context);
+      }
+      return std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+
+  explicit Task(std::coroutine_handle<promise_type> handle)
+      : _handle{handle} {}
+
+  void rethrow() {
+    if (_handle.promise().error) {
+      std::rethrow_exception(_handle.promise().error);
+    }
+  }
+
+  std::coroutine_handle<promise_type> _handle;
+};
+
+// Awaitable suspending coroutine and posting it to executor, that is any
+// object with post(std::coroutine_handle<>) resuming it later on thread
+// handling events of state chart. Coroutine destroyed while posted, e.g.
+// pending task of destroyed state chart, is taken back by executor's
+// cancel(std::coroutine_handle<>), which executor has to have unless it
+// outlives no such coroutine.
+template <typename Executor> auto resume_on(Executor &executor) {
+  class Awaiter {
+  public:
+    explicit Awaiter(Executor &executor) : _executor{executor} {}
+    Awaiter(const Awaiter &) = delete;
+    Awaiter &operator=(const Awaiter &) = delete;
+
+    ~Awaiter() {
+      if constexpr (requires { _executor.cancel(_posted); }) {
+        if (_posted) {
+          _executor.cancel(_posted);
+        }
+      }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> awaiting) {
+      _posted = awaiting;
+      _executor.post(awaiting);
+    }
+    void await_resume() noexcept { _posted = {}; }
+
+  private:
+    Executor &_executor;
+    std::coroutine_handle<> _posted;
+  };
+  return Awaiter{executor};
+}
+
+// Single threaded executor, coroutines can be posted from any thread and are
+// resumed by thread calling run(). One loop can drive any number of charts.
+class RunLoop {
+public:
+  void post(std::coroutine_handle<> handle) {
+    std::lock_guard lock{_mutex};
+    _ready.push_back(handle);
+  }
+
+  // Forgets posted coroutine that is being destroyed.
+  void cancel(std::coroutine_handle<> handle) {
+    std::lock_guard lock{_mutex};
+    _ready.erase(std::remove(_ready.begin(), _ready.end(), handle),
+                 _ready.end());
+  }
+
+  auto schedule() { return resume_on(*this); }
+
+  // Resumes posted coroutines in order, including ones posted meanwhile,
+  // until none is left. Coroutine is taken one at a time, so resumed one can
+  // cancel others by destroying them. Returns number of resumed coroutines.
+  std::size_t run() {
+    std::size_t resumed = 0;
+    for (;;) {
+      std::coroutine_handle<> handle;
+      {
+        std::lock_guard lock{_mutex};
+        if (_ready.empty()) {
+          return resumed;
+        }
+        handle = _ready.front();
+        _ready.pop_front();
+      }
+      handle.resume();
+      ++resumed;
+    }
+  }
+
+private:
+  std::mutex _mutex;
+  std::deque<std::coroutine_handle<>> _ready;
+};
+
+} // namespace sctl
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <sctl.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace sctl {
+
+// Timeout of state, Event is handled by state chart when state stays active
+// for Ticks ticks of TimerWheel.
+template <std::uint64_t Ticks, typename Event> struct After {};
+
+// Declared as `using Timers = sctl::Timers<sctl::After<Ticks, Event>...>` by
+// state with timeouts, they are armed when state is entered and cancelled
+// when it is exited.
+template <typename... A> struct Timers {};
+
+// Hierarchical timing wheel, levels of 64 slots each cover 64 times longer
+// delays than level below. Timers are intrusive nodes owned by caller, armed
+// and cancelled in constant time. Time is given by caller in ticks of any
+// length, so the wheel never reads clock itself.
+class TimerWheel {
+public:
+  static constexpr std::size_t slot_bits = 6;
+  static constexpr std::size_t slots = 1 << slot_bits;
+  static constexpr std::size_t levels = 4;
+  static constexpr std::uint64_t max_delay =
+      (std::uint64_t{1} << (slot_bits * levels)) - 1;
+
+  struct Link {
+    Link *prev{nullptr};
+    Link *next{nullptr};
+  };
+
+  struct Timer : Link {
+    std::uint64_t expiry{0};
+    void (*fire)(Timer &){nullptr};
+
+    Timer() = default;
+    Timer(const Timer &) = delete;
+    Timer &operator=(const Timer &) = delete;
+    ~Timer() { unlink(); }
+
+    bool armed() const { return next != nullptr; }
+
+    // Takes place of other in wheel, other is left unarmed.
+    void take_over(Timer &other) {
+      unlink();
+      expiry = other.expiry;
+      if (other.next) {
+        prev = other.prev;
+        next = other.next;
+        prev->next = next->prev = this;
+        other.prev = other.next = nullptr;
+      }
+    }
+
+    void unlink() {
+      if (next) {
+        prev->next = next;
+        next->prev = prev;
+        prev = next = nullptr;
+      }
+    }
+  };
+
+  explicit TimerWheel(std::uint64_t now = 0) : _now{now} {
+    for (auto &level : _slots) {
+      for (auto &slot : level) {
+        slot.prev = slot.next = &slot;
+      }
+    }
+  }
+
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel &operator=(const TimerWheel &) = delete;
+
+  std::uint64_t now() const { return _now; }
+
+  // Timer fires when time reaches now() + delay, delay of 0 fires on next
+  // tick. Armed timer is rearmed.
+  void arm(Timer &timer, std::uint64_t delay) {
+    timer.unlink();
+    timer.expiry = _now + std::max<std::uint64_t>(delay, 1);
+    insert(timer);
+  }
+
+  static void cancel(Timer &timer) { timer.unlink(); }
+
+  // Fires, in order of expiry, every timer that expires up to given time.
+  // Fired timers can arm and cancel timers.
+  void advance_to(std::uint64_t now) {
+    while (_now < now) {
+      tick();
+    }
+  }
+
+private:
+  static constexpr std::uint64_t mask = slots - 1;
+
+  void insert(Timer &timer) {
+    const std::uint64_t expiry = std::min(timer.expiry, _now + max_delay);
+    const std::uint64_t delay = expiry - _now;
+    std::size_t level = 0;
+    while (level + 1 < levels && delay >> (slot_bits * (level + 1))) {
+      ++level;
+    }
+    push(_slots[level][(expiry >> (slot_bits * level)) & mask], timer);
+  }
+
+  static void push(Link &head, Link &node) {
+    node.prev = head.prev;
+    node.next = &head;
+    head.prev->next = &node;
+    head.prev = &node;
+  }
+
+  // Moves all timers of slot to list headed by to.
+  static void splice(Link &slot, Link &to) {
+    to.prev = to.next = &to;
+    if (slot.next != &slot) {
+      to.next = slot.next;
+      to.prev = slot.prev;
+      to.next->prev = &to;
+      to.prev->next = &to;
+      slot.prev = slot.next = &slot;
+    }
+  }
+
+  void tick() {
+    ++_now;
+    for (std::size_t level = 1; level < levels; ++level) {
+      if ((_now >> (slot_bits * (level - 1))) & mask) {
+        break;
+      }
+      Link pending;
+      splice(_slots[level][(_now >> (slot_bits * level)) & mask], pending);
+      while (pending.next != &pending) {
+        Timer &timer = static_cast<Timer &>(*pending.next);
+        timer.unlink();
+        insert(timer);
+      }
+    }
+
+    Link due;
+    splice(_slots[0][_now & mask], due);
+    while (due.next != &due) {
+      Timer &timer = static_cast<Timer &>(*due.next);
+      timer.unlink();
+      timer.fire(timer);
+    }
+  }
+
+  std::uint64_t _now;
+  std::array<std::array<Link, slots>, levels> _slots;
+};
+
+// Observer arming timers declared by states in TimerWheel when they are
+// entered and cancelling them when they are exited. Timeout events have to be
+// listed in Events and be default constructible. Chart has to be bound with
+// bind(), usually right after construction, and started with entry, so that
+// timers of initial states are armed. At most max_timers timers of one chart
+// can be armed at once, others are counted as dropped.
+// Observer has to be part of chart it is bound to: its observer, or member of
+// sctl::CompositeObserver to be used together with e.g. TraceObserver or
+// ProfileObserver. Chart is kept as offset from observer and moved observer
+// takes over armed timers, so moving observer never detaches its timers.
+template <typename... Events> class TimerObserver : public NoObserver {
+public:
+  static constexpr std::size_t max_timers = 16;
+
+  explicit TimerObserver(TimerWheel &wheel) : _wheel{&wheel} {}
+  TimerObserver(TimerObserver &&other)
+      : _wheel{other._wheel}, _chart_offset{other._chart_offset},
+        _deliver{other._deliver}, _dropped{other._dropped} {
+    for (std::size_t i = 0; i < max_timers; ++i) {
+      Armed &timer = _timers[i];
+      Armed &from = other._timers[i];
+      timer.owner = this;
+      timer.state = from.state;
+      timer.event = from.event;
+      timer.fire = from.fire;
+      timer.take_over(from);
+    }
+  }
+  TimerObserver &operator=(TimerObserver &&) = delete;
+
+  template <typename Chart> void bind(Chart &chart) {
+    _chart_offset = reinterpret_cast<std::uintptr_t>(this) -
+                    reinterpret_cast<std::uintptr_t>(&chart);
+    _deliver = {
+        [](void *c) { static_cast<Chart *>(c)->handle(Events{}); }...};
+  }
+
+  template <typename S> void on_enter(std::size_t state) {
+    if constexpr (requires { typename S::Timers; }) {
+      [this, state]<typename... A>(Timers<A...>) {
+        (arm(state, A{}), ...);
+      }(typename S::Timers{});
+    }
+  }
+
+  template <typename S> void on_exit(std::size_t state) {
+    if constexpr (requires { typename S::Timers; }) {
+      for (auto &timer : _timers) {
+        if (timer.state == state) {
+          timer.unlink();
+        }
+      }
+    }
+  }
+
+  std::size_t dropped() const { return _dropped; }
+
+private:
+  struct Armed : TimerWheel::Timer {
+    TimerObserver *owner{nullptr};
+    std::size_t state{0};
+    std::size_t event{0};
+  };
+
+  template <std::uint64_t Ticks, typename Event>
+  void arm(std::size_t state, After<Ticks, Event>) {
+    using List = details::TypeList<Events...>;
+    static_assert(List::template contains<Event>(),
+                  "timeout event is not listed in TimerObserver events");
+
+    for (auto &timer : _timers) {
+      if (!timer.armed()) {
+        timer.owner = this;
+        timer.state = state;
+        timer.event = List::template index_of<Event>();
+        timer.fire = [](TimerWheel::Timer &t) {
+          auto &armed = static_cast<Armed &>(t);
+          armed.owner->_deliver[armed.event](armed.owner->chart());
+        };
+        _wheel->arm(timer, Ticks);
+        return;
+      }
+    }
+    ++_dropped;
+  }
+
+  void *chart() {
+    return reinterpret_cast<void *>(reinterpret_cast<std::uintptr_t>(this) -
+                                    _chart_offset);
+  }
+
+  TimerWheel *_wheel;
+  std::uintptr_t _chart_offset{0};
+  std::array<void (*)(void *), sizeof...(Events)> _deliver{};
+  std::array<Armed, max_timers> _timers;
+  std::size_t _dropped{0};
+};
+
+} // namespace sctl
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <sctl.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace sctl {
+
+enum class TraceKind : std::uint8_t { Event, Exit, Enter, Transition };
+
+// Single observer callback. Event is position of event in TraceObserver
+// parameters, state and target are state indexes, unused ones are no_index.
+struct TraceRecord {
+  static constexpr std::uint16_t no_index = 0xffff;
+
+  std::uint64_t timestamp;
+  std::uint16_t event;
+  std::uint16_t state;
+  std::uint16_t target;
+  TraceKind kind;
+};
+
+static_assert(sizeof(TraceRecord) == 16);
+
+// Time stamp counter where available, steady clock nanoseconds otherwise.
+inline std::uint64_t trace_timestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+// Number of trace_timestamp() ticks per second, measured on first call.
+inline std::uint64_t trace_timestamp_frequency() {
+#if defined(__x86_64__) || defined(__i386__)
+  static const std::uint64_t frequency = [] {
+    using Clock = std::chrono::steady_clock;
+    const auto begin = Clock::now();
+    const auto ticks = trace_timestamp();
+    while (Clock::now() - begin < std::chrono::milliseconds{10}) {
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - begin);
+    return (trace_timestamp() - ticks) * 1'000'000'000 / elapsed.count();
+  }();
+  return frequency;
+#else
+  return 1'000'000'000;
+#endif
+}
+
+// Ring buffer of trace records written by single thread, oldest records are
+// overwritten when it is full. Writing never blocks. Every slot is guarded by
+// its own sequence number, so snapshot() may be taken from any thread while
+// writer runs, torn or overwritten records are left out.
+class TraceBuffer {
+public:
+  static constexpr std::size_t capacity = 4096;
+
+  // Buffer of calling thread.
+  static TraceBuffer &local() {
+    thread_local TraceBuffer buffer;
+    return buffer;
+  }
+
+  // Slot holds record of position pos when its sequence is 2 * pos + 2, odd
+  // sequence while it is written.
+  void write(const TraceRecord &record) {
+    const std::size_t pos = _head.load(std::memory_order_relaxed);
+    Slot &slot = _slots[pos & (capacity - 1)];
+    std::uint64_t words[2];
+    std::memcpy(words, &record, sizeof(words));
+    slot.sequence.store(2 * pos + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::atomic_ref{slot.words[0]}.store(words[0], std::memory_order_relaxed);
+    std::atomic_ref{slot.words[1]}.store(words[1], std::memory_order_relaxed);
+    slot.sequence.store(2 * pos + 2, std::memory_order_release);
+    _head.store(pos + 1, std::memory_order_release);
+  }
+
+  // Up to capacity newest records written since clear(), oldest first.
+  std::vector<TraceRecord> snapshot() const {
+    const std::size_t end = _head.load(std::memory_order_acquire);
+    const std::size_t begin = std::max(
+        end > capacity ? end - capacity : 0,
+        _cleared.load(std::memory_order_acquire));
+
+    std::vector<TraceRecord> records;
+    records.reserve(end - std::min(begin, end));
+    for (std::size_t pos = begin; pos < end; ++pos) {
+      const Slot &slot = _slots[pos & (capacity - 1)];
+      const auto sequence = slot.sequence.load(std::memory_order_acquire);
+      std::uint64_t words[2];
+      words[0] = std::atomic_ref{const_cast<std::uint64_t &>(slot.words[0])}
+                     .load(std::memory_order_relaxed);
+      words[1] = std::atomic_ref{const_cast<std::uint64_t &>(slot.words[1])}
+                     .load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence == 2 * pos + 2 &&
+          slot.sequence.load(std::memory_order_relaxed) == sequence) {
+        std::memcpy(&records.emplace_back(), words, sizeof(words));
+      }
+    }
+    return records;
+  }
+
+  // Leaves out records written so far from following snapshots.
+  void clear() {
+    _cleared.store(_head.load(std::memory_order_acquire),
+                   std::memory_order_release);
+  }
+
+private:
+  static_assert((capacity & (capacity - 1)) == 0,
+                "capacity has to be power of two");
+
+  struct Slot {
+    std::atomic<std::uint64_t> sequence{0};
+    std::uint64_t words[2];
+  };
+
+  static_assert(sizeof(TraceRecord) == sizeof(Slot::words));
+
+  std::array<Slot, capacity> _slots;
+  std::atomic<std::size_t> _head{0};
+  std::atomic<std::size_t> _cleared{0};
+};
+
+// Observer writing TraceRecord for every callback to buffer of calling thread.
+// Events are identified by position in Events, to be decoded with
+// sctl::parser::Parser given the same events in the same order.
+template <typename... Events> struct TraceObserver : NoObserver {
+  static constexpr std::uint16_t no_index = TraceRecord::no_index;
+
+  template <typename Event> void on_event(const Event &) {
+    TraceBuffer::local().write({trace_timestamp(), event_index<Event>(),
+                                no_index, no_index, TraceKind::Event});
+  }
+
+  template <typename S> void on_exit(std::size_t index) {
+    TraceBuffer::local().write({trace_timestamp(), no_index,
+                                static_cast<std::uint16_t>(index), no_index,
+                                TraceKind::Exit});
+  }
+
+  template <typename S> void on_enter(std::size_t index) {
+    TraceBuffer::local().write({trace_timestamp(), no_index,
+                                static_cast<std::uint16_t>(index), no_index,
+                                TraceKind::Enter});
+  }
+
+  template <typename From, typename To>
+  void on_transition(std::size_t from, std::size_t to) {
+    TraceBuffer::local().write(
+        {trace_timestamp(), no_index, static_cast<std::uint16_t>(from),
+         static_cast<std::uint16_t>(to), TraceKind::Transition});
+  }
+
+private:
+  template <typename Event> static constexpr std::uint16_t event_index() {
+    using List = details::TypeList<Events...>;
+    if constexpr (List::template contains<Event>()) {
+      return List::template index_of<Event>();
+    } else {
+      return no_index;
+    }
+  }
+};
+
+} // namespace sctl
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <sctl.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <type_traits>
+
+namespace sctl {
+
+// Wire id of event type, Event::wire_id unless specialized for types that
+// can not be changed.
+template <typename Event> struct WireId {
+  static constexpr std::uint32_t value = Event::wire_id;
+};
+
+namespace details {
+
+template <typename... Events> constexpr bool unique_wire_ids() {
+  std::array<std::uint32_t, sizeof...(Events)> ids{WireId<Events>::value...};
+  std::sort(ids.begin(), ids.end());
+  return std::adjacent_find(ids.begin(), ids.end()) == ids.end();
+}
+
+// Type whose object is created implicitly in bytes it is copied to, until
+// std::is_implicit_lifetime of C++23. Trivially copyable class can be
+// copyable only by assignment, so it is not always one.
+template <typename T>
+concept ImplicitLifetime =
+    std::is_scalar<T>::value || std::is_aggregate<T>::value ||
+    ((std::is_trivially_default_constructible<T>::value ||
+      std::is_trivially_copy_constructible<T>::value ||
+      std::is_trivially_move_constructible<T>::value) &&
+     std::is_trivially_destructible<T>::value);
+
+} // namespace details
+
+// Events received as (wire id, bytes of trivially copyable event), e.g. from
+// shared memory queue. Event is handled in place, handlers get reference to
+// object in buffer, unless buffer is not aligned for it or it is not of
+// implicit-lifetime type, then it is copied to stack. Id is found with binary
+// search of table sorted at compile time.
+template <typename... Events> class WireEvents {
+  static_assert((std::is_trivially_copyable<Events>::value && ...),
+                "wire events have to be trivially copyable");
+
+  template <typename Chart>
+  using Dispatch = void (*)(Chart &, std::span<const std::byte>);
+
+  template <typename Chart> struct Entry {
+    std::uint32_t id;
+    std::size_t size;
+    Dispatch<Chart> dispatch;
+  };
+
+  // Empty events take no bytes.
+  template <typename Event>
+  static constexpr std::size_t size_of =
+      std::is_empty<Event>::value ? 0 : sizeof(Event);
+
+  template <typename Event>
+  static Event copy_of(std::span<const std::byte> bytes) {
+    std::array<std::byte, sizeof(Event)> copy;
+    std::copy_n(bytes.data(), sizeof(Event), copy.begin());
+    return std::bit_cast<Event>(copy);
+  }
+
+  // Bytes of buffer implicitly hold event of implicit-lifetime type, reached
+  // through std::launder as in read_snapshot_records(). Other events can not
+  // be created from bytes, they are default constructed and bytes are copied
+  // into them.
+  template <typename Event, typename Chart>
+  static void dispatch(Chart &chart, std::span<const std::byte> bytes) {
+    if constexpr (std::is_empty<Event>::value) {
+      chart.handle(std::bit_cast<Event>(std::array<std::byte, 1>{}));
+    } else if constexpr (!details::ImplicitLifetime<Event>) {
+      static_assert(std::is_default_constructible<Event>::value,
+                    "wire event that is not of implicit-lifetime type has to "
+                    "be default constructible");
+      Event copy;
+      std::memcpy(&copy, bytes.data(), sizeof(Event));
+      chart.handle(static_cast<const Event &>(copy));
+    } else if (reinterpret_cast<std::uintptr_t>(bytes.data()) % alignof(Event) ==
+               0) {
+      chart.handle(
+          *std::launder(reinterpret_cast<const Event *>(bytes.data())));
+    } else {
+      chart.handle(copy_of<Event>(bytes));
+    }
+  }
+
+  template <typename Chart>
+  static constexpr std::array<Entry<Chart>, sizeof...(Events)> sorted() {
+    std::array<Entry<Chart>, sizeof...(Events)> table{
+        Entry<Chart>{WireId<Events>::value, size_of<Events>,
+                     &dispatch<Events, Chart>}...};
+    std::sort(table.begin(), table.end(),
+              [](const auto &a, const auto &b) { return a.id < b.id; });
+    return table;
+  }
+
+  template <typename Chart>
+  static constexpr std::array<Entry<Chart>, sizeof...(Events)> table =
+      sorted<Chart>();
+
+  static_assert(details::unique_wire_ids<Events...>(),
+                "wire ids of events have to be unique");
+
+public:
+  // Handles event of given wire id held by bytes. Returns false, handling
+  // nothing, for unknown id or when size of bytes is not size of event.
+  template <typename Chart>
+  static bool handle(Chart &chart, std::uint32_t id,
+                     std::span<const std::byte> bytes) {
+    const auto &entries = table<Chart>;
+    const auto found = std::lower_bound(
+        entries.begin(), entries.end(), id,
+        [](const Entry<Chart> &e, std::uint32_t i) { return e.id < i; });
+    if (found == entries.end() || found->id != id ||
+        found->size != bytes.size()) {
+      return false;
+    }
+    found->dispatch(chart, bytes);
+    return true;
+  }
+
+  // Bytes of event as sent on wire, with its id.
+  template <typename Event>
+  static std::span<const std::byte> bytes(const Event &e) {
+    static_assert((std::is_same<Event, Events>::value || ...),
+                  "event is not one of wire events");
+    return std::as_bytes(std::span<const Event, 1>{&e, 1})
+        .first(size_of<Event>);
+  }
+};
+
+} // namespace sctl
@@ -0,0 +1,159 @@
+#include "gmock/gmock.h"
+
+#include "sctl_actor.h"
+
+#include <chrono>
+#include <set>
+#include <thread>
+#include <vector>
+
+/*
+ Actor system
+
+ every actor is a counter chart, Numbered events of every producer have to
+ be seen in posting order, Relay hops from actor to actor, Slow keeps worker
+ busy so that others steal
+
+*/
+
+namespace {
+
+struct Numbered {
+  int producer;
+  int number;
+};
+struct Relay {
+  int hops;
+};
+struct Slow {};
+
+struct Counting;
+
+struct Device;
+using System = sctl::ActorSystem<Device, 64, Numbered, Relay, Slow>;
+
+struct Counting {
+  System *system{nullptr};
+  System::Id next{0};
+  std::vector<int> last{std::vector<int>(4, -1)};
+  bool ordered{true};
+  int relayed{0};
+  std::set<std::thread::id> threads;
+
+  void handle(const Numbered &n) {
+    ordered = ordered && n.number == last[n.producer] + 1;
+    last[n.producer] = n.number;
+  }
+  void handle(const Relay &r) {
+    ++relayed;
+    if (r.hops > 0) {
+      EXPECT_TRUE(system->post(next, Relay{r.hops - 1}));
+    }
+  }
+  void handle(const Slow &) {
+    threads.insert(std::this_thread::get_id());
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+};
+
+using DeviceSC = sctl::StateChart<Counting>;
+
+struct Device {
+  Counting counting;
+  DeviceSC chart{counting};
+
+  Device(System &system, System::Id next) {
+    counting.system = &system;
+    counting.next = next;
+    chart.start();
+  }
+
+  template <typename Event> void handle(const Event &e) { chart.handle(e); }
+};
+
+struct ActorSystemSC : public ::testing::Test {
+  static constexpr System::Id actors = 32;
+
+  System system{4};
+
+  ActorSystemSC() {
+    for (System::Id id = 0; id < actors; ++id) {
+      EXPECT_EQ(system.spawn(system, (id + 1) % actors), id);
+    }
+  }
+
+  Counting &counting(System::Id id) { return system.actor(id).counting; }
+};
+
+TEST_F(ActorSystemSC, EventsOfInstanceHandledInPostingOrder) {
+  constexpr int producers = 4;
+  constexpr int per_producer = 2000;
+
+  system.start();
+  std::vector<std::jthread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([this, p] {
+      for (int i = 0; i < per_producer; ++i) {
+        for (System::Id id = 0; id < actors; ++id) {
+          while (!system.post(id, Numbered{p, i})) {
+            std::this_thread::yield();
+          }
+        }
+      }
+    });
+  }
+  threads.clear();
+  system.stop();
+
+  for (System::Id id = 0; id < actors; ++id) {
+    EXPECT_TRUE(counting(id).ordered);
+    EXPECT_THAT(counting(id).last, ::testing::Each(per_producer - 1));
+  }
+}
+
+TEST_F(ActorSystemSC, EventsPostedByHandlersAreHandledBeforeWaitReturns) {
+  system.start();
+  for (System::Id id = 0; id < actors; ++id) {
+    ASSERT_TRUE(system.post(id, Relay{100}));
+  }
+  system.wait();
+
+  int relayed = 0;
+  for (System::Id id = 0; id < actors; ++id) {
+    relayed += counting(id).relayed;
+  }
+  EXPECT_EQ(relayed, actors * 101);
+}
+
+TEST_F(ActorSystemSC, IdleWorkersStealFromBusyShard) {
+  // All actors with ids divisible by worker count belong to the first shard.
+  for (System::Id id = 0; id < actors; id += 4) {
+    for (int i = 0; i < 10; ++i) {
+      ASSERT_TRUE(system.post(id, Slow{}));
+    }
+  }
+  system.start();
+  system.stop();
+
+  std::set<std::thread::id> threads;
+  for (System::Id id = 0; id < actors; id += 4) {
+    threads.insert(counting(id).threads.begin(), counting(id).threads.end());
+  }
+  EXPECT_GT(threads.size(), 1u);
+}
+
+TEST_F(ActorSystemSC, PostFailsWhenMailboxIsFull) {
+  for (int i = 0; i < 64; ++i) {
+    ASSERT_TRUE(system.post(0, Numbered{0, i}));
+  }
+  EXPECT_FALSE(system.post(0, Numbered{0, 64}));
+
+  system.start();
+  system.wait();
+  EXPECT_TRUE(system.post(0, Numbered{0, 64}));
+  system.stop();
+  EXPECT_EQ(counting(0).last[0], 64);
+  EXPECT_TRUE(counting(0).ordered);
+}
+
+} // namespace
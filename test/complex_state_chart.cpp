@@ -1,5 +1,22 @@
 #include "complex_state_chart.h"
 
+#include <stdexcept>
+
+static_assert(SC::max_enter_redirects == 1);
+
+static_assert(std::is_same<sctl::details::SmallestIndex<255>::type,
+                           std::uint8_t>::value);
+static_assert(std::is_same<sctl::details::SmallestIndex<256>::type,
+                           std::uint16_t>::value);
+static_assert(std::is_same<sctl::details::SmallestIndex<65536>::type,
+                           std::uint32_t>::value);
+
+// Active state of chart with 10 states takes single byte.
+static_assert(std::is_same<sctl::details::Engine<Off, OffInternal, Error, On,
+                                                 Init, Ready, Busy, Config,
+                                                 Processing, Waiting>::StateIndex,
+                           std::uint8_t>::value);
+
 struct ComplexSC : public ::testing::Test {
   Off off;
   OffInternal off_internal;
@@ -127,3 +144,106 @@ TEST_F(ComplexSC, TransitionFromBegin) {
 
   instance.handle(Failure{});
 }
+
+TEST_F(ComplexSC, VariantReturnFromHandle) {
+  ::testing::InSequence seq;
+
+  instance.start();
+  instance.handle(PowerOn{});
+  instance.handle(Initialized{});
+  instance.handle(Configure{});
+
+  EXPECT_CALL(waiting, exit());
+  EXPECT_CALL(config, exit());
+  EXPECT_CALL(ready, enter());
+
+  instance.handle(Timeout{});
+}
+
+TEST_F(ComplexSC, HandleBatchOfSameEvent) {
+  ::testing::InSequence seq;
+
+  instance.start();
+
+  const std::vector<Tick> ticks(3);
+  EXPECT_CALL(off_internal, handle(::testing::An<const Tick &>())).Times(3);
+
+  instance.handle_batch(std::span{ticks});
+
+  EXPECT_CALL(off_internal, exit());
+  EXPECT_CALL(off, exit());
+  EXPECT_CALL(on, enter());
+  EXPECT_CALL(init, enter());
+
+  instance.handle(PowerOn{});
+}
+
+TEST_F(ComplexSC, HandleBatchOfEventVariants) {
+  ::testing::InSequence seq;
+
+  instance.start();
+
+  using Event = std::variant<PowerOn, Initialized, Action, Tick>;
+  const std::vector<Event> events{PowerOn{}, Initialized{}, Action{}, Tick{}};
+
+  EXPECT_CALL(off_internal, exit());
+  EXPECT_CALL(off, exit());
+  EXPECT_CALL(on, enter());
+  EXPECT_CALL(init, enter());
+  EXPECT_CALL(init, exit());
+  EXPECT_CALL(ready, enter());
+  EXPECT_CALL(ready, exit());
+  EXPECT_CALL(busy, enter());
+  EXPECT_CALL(busy, exit());
+  EXPECT_CALL(busy, enter());
+
+  instance.handle_batch(std::span{events});
+
+  EXPECT_CALL(busy, exit());
+  EXPECT_CALL(ready, enter());
+
+  instance.handle(Timeout{});
+}
+
+TEST_F(ComplexSC, HandleEventVariant) {
+  ::testing::InSequence seq;
+
+  using Event = std::variant<PowerOn, Timeout, Tick>;
+
+  instance.start();
+
+  EXPECT_CALL(off_internal, handle(::testing::An<const Tick &>()));
+
+  instance.handle(Event{Tick{}});
+  instance.handle(Event{Timeout{}});
+
+  EXPECT_CALL(off_internal, exit());
+  EXPECT_CALL(off, exit());
+  EXPECT_CALL(on, enter());
+  EXPECT_CALL(init, enter());
+
+  instance.handle(Event{PowerOn{}});
+}
+
+// Event whose construction fails. Not trivially copyable, so that emplace()
+// constructs it in place and leaves variant valueless.
+struct FailingEvent {
+  FailingEvent() = default;
+  FailingEvent(const FailingEvent &) {}
+  explicit FailingEvent(int) { throw std::runtime_error{"event"}; }
+};
+
+TEST_F(ComplexSC, ValuelessEventVariantThrows) {
+  using Event = std::variant<PowerOn, FailingEvent>;
+
+  instance.start();
+
+  Event event{PowerOn{}};
+  EXPECT_THROW(event.emplace<FailingEvent>(0), std::runtime_error);
+  ASSERT_TRUE(event.valueless_by_exception());
+
+  EXPECT_THROW(instance.handle(event), std::bad_variant_access);
+  EXPECT_THROW(instance.handle_batch(std::span{&event, 1}),
+               std::bad_variant_access);
+  EXPECT_TRUE(instance.is_active<OffInternal>());
+}
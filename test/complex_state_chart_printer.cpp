@@ -1,15 +1,24 @@
 #include "complex_state_chart.h"
 #include <iostream>
+#include <sctl_parser_dot.h>
+#include <sctl_parser_json.h>
 #include <sctl_parser_plantuml.h>
+#include <string_view>
 
-int main() {
+// Prints chart as PlantUML, or as DOT or JSON given "dot" or "json".
+int main(int argc, char **argv) {
   sctl::parser::Parser<SC, PowerOn, PowerOff, Initialized, Failure, Action,
                        Timeout, Configure, Tick>
       parser;
 
-  sctl::parser::PlantUML plant{parser()};
-
-  std::cout << plant << "\n";
+  const std::string_view format = argc > 1 ? argv[1] : "plantuml";
+  if (format == "dot") {
+    std::cout << sctl::parser::Dot{parser()};
+  } else if (format == "json") {
+    std::cout << sctl::parser::Json{parser()};
+  } else {
+    std::cout << sctl::parser::PlantUML{parser()} << "\n";
+  }
 
   return 0;
 }
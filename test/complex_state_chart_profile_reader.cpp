@@ -0,0 +1,30 @@
+#include "complex_state_chart.h"
+#include <iostream>
+#include <sctl_parser_profile.h>
+
+// Prints profile written by ProfileObserver of complex state chart into
+// shared memory segment given as argument.
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <segment name>\n";
+    return 1;
+  }
+
+  sctl::parser::Parser<SC, PowerOn, PowerOff, Initialized, Failure, Action,
+                       Timeout, Configure, Tick>
+      parser;
+
+  try {
+    const auto layout =
+        sctl::ProfileSegment::profile_layout<SC, PowerOn, PowerOff,
+                                             Initialized, Failure, Action,
+                                             Timeout, Configure, Tick>();
+    std::cout << sctl::parser::Profile{
+        parser(), sctl::ProfileSegment::open(argv[1], layout)};
+  } catch (const std::system_error &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
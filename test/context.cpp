@@ -0,0 +1,186 @@
+#include "gmock/gmock.h"
+
+#include "sctl.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <variant>
+#include <vector>
+
+/*
+ Chart with context
+
+```
+@startuml
+hide empty description
+
+state Open {
+  [*] --> Handshake
+  Handshake --> Streaming : Hello
+  Streaming : Data / count bytes
+}
+
+[*] --> Closed
+Closed --> Open : Connect
+Open --> Closed : Reset
+@enduml
+```
+
+*/
+
+namespace {
+
+struct Closed;
+struct Open;
+struct Handshake;
+struct Streaming;
+
+struct Connect {};
+struct Hello {
+  std::uint16_t version;
+};
+struct Data {
+  std::uint32_t bytes;
+};
+struct Reset {};
+
+struct Connection {
+  std::uint64_t received{0};
+  std::uint16_t version{0};
+  std::uint16_t opened{0};
+  std::uint16_t closed{0};
+};
+
+struct Closed {
+  auto handle(Connection &, const Connect &) { return sctl::State<Open>{}; }
+};
+struct Open {
+  using StartState = Handshake;
+  void enter(Connection &c) { ++c.opened; }
+  void exit(Connection &c) { ++c.closed; }
+  auto handle(Connection &, const Reset &) { return sctl::State<Closed>{}; }
+};
+struct Handshake {
+  using ParentState = Open;
+  auto handle(Connection &c, const Hello &h) {
+    c.version = h.version;
+    return sctl::State<Streaming>{};
+  }
+};
+struct Streaming {
+  using ParentState = Open;
+  void handle(Connection &c, const Data &d) { c.received += d.bytes; }
+};
+
+using ConnectionSC =
+    sctl::StateChart<sctl::WithContext<Connection>, Closed, Open, Handshake,
+                     Streaming>;
+
+// Active state index takes tail padding of context, states take nothing.
+static_assert(sizeof(ConnectionSC) == sizeof(Connection));
+
+struct Lit;
+struct Dark;
+struct Toggle {};
+struct Lit {
+  auto handle(std::uint8_t &switched, const Toggle &) {
+    ++switched;
+    return sctl::State<Dark>{};
+  }
+};
+struct Dark {
+  auto handle(std::uint8_t &switched, const Toggle &) {
+    ++switched;
+    return sctl::State<Lit>{};
+  }
+};
+
+// Context without padding: chart is context and single byte of active state.
+static_assert(
+    sizeof(sctl::StateChart<sctl::WithContext<std::uint8_t>, Lit, Dark>) == 2);
+
+TEST(ContextStateChart, InstancesKeepOwnContext) {
+  std::vector<ConnectionSC> charts(3);
+  for (auto &chart : charts) {
+    chart.start();
+    chart.handle(Connect{});
+  }
+  charts[0].handle(Hello{2});
+  charts[0].handle(Data{100});
+  charts[0].handle(Data{20});
+  charts[1].handle(Hello{3});
+  charts[2].handle(Reset{});
+
+  EXPECT_TRUE(charts[0].is_active<Streaming>());
+  EXPECT_EQ(charts[0].context().received, 120u);
+  EXPECT_EQ(charts[0].context().version, 2);
+  EXPECT_TRUE(charts[1].is_active<Streaming>());
+  EXPECT_EQ(charts[1].context().received, 0u);
+  EXPECT_EQ(charts[1].context().version, 3);
+  EXPECT_TRUE(charts[2].is_active<Closed>());
+  EXPECT_EQ(charts[2].context().opened, 1);
+  EXPECT_EQ(charts[2].context().closed, 1);
+}
+
+TEST(ContextStateChart, ChartsSharingStatesStayIndependent) {
+  using ShortSC =
+      sctl::StateChart<sctl::WithContext<Connection>, Closed, Open, Handshake>;
+  static_assert(sizeof(ShortSC) == sizeof(Connection));
+
+  ConnectionSC a;
+  ShortSC b;
+  a.start();
+  b.start();
+  a.handle(Connect{});
+  a.handle(Hello{4});
+  b.handle(Connect{});
+
+  EXPECT_NE(&a.context(), &b.context());
+  EXPECT_TRUE(a.is_active<Streaming>());
+  EXPECT_TRUE(b.is_active<Handshake>());
+  EXPECT_EQ(a.context().version, 4);
+  EXPECT_EQ(b.context().version, 0);
+
+  b.handle(Reset{});
+  EXPECT_TRUE(a.is_active<Streaming>());
+  EXPECT_EQ(a.context().closed, 0);
+  EXPECT_EQ(b.context().closed, 1);
+}
+
+TEST(ContextStateChart, HandlesVariantsAndBatches) {
+  using Event = std::variant<Connect, Hello, Data, Reset>;
+  const std::array<Event, 4> events{Connect{}, Hello{1}, Data{7}, Data{8}};
+
+  ConnectionSC chart{Connection{5}};
+  chart.start();
+  chart.handle_batch(std::span{events});
+  chart.handle(Event{Reset{}});
+
+  EXPECT_TRUE(chart.is_active<Closed>());
+  EXPECT_EQ(chart.context().received, 20u);
+}
+
+struct Log : sctl::NoObserver {
+  std::vector<std::string> *lines;
+
+  template <typename S> void on_enter(std::size_t) {
+    lines->push_back(std::string{"enter "} +
+                     std::string{sctl::details::type_name<S>()});
+  }
+};
+
+TEST(ContextStateChart, NotifiesObserver) {
+  std::vector<std::string> lines;
+  sctl::StateChart<sctl::WithContext<Connection, Log>, Closed, Open,
+                   Handshake, Streaming>
+      chart{Log{{}, &lines}, Connection{}};
+  chart.start();
+  chart.handle(Connect{});
+
+  EXPECT_THAT(lines, ::testing::Contains(::testing::HasSubstr("Open")));
+  EXPECT_THAT(lines, ::testing::Contains(::testing::HasSubstr("Handshake")));
+  EXPECT_EQ(chart.context().opened, 1);
+}
+
+} // namespace
@@ -0,0 +1,198 @@
+#include "gmock/gmock.h"
+
+#include "sctl.h"
+
+#include <string>
+#include <variant>
+#include <vector>
+
+/*
+ Deferred Events
+
+```
+@startuml
+hide empty description
+
+state Busy {
+  [*] --> Loading
+  Loading --> Saving : Next
+  Saving --> Loading : Next
+}
+
+[*] --> Idle
+Idle --> Busy : Start
+Busy --> Idle : Done
+Busy : Action / defer
+Busy : Job / defer
+@enduml
+```
+
+*/
+
+namespace {
+
+struct Idle;
+struct Busy;
+struct Loading;
+struct Saving;
+
+struct Start {};
+struct Done {};
+struct Next {};
+struct Action {
+  int id;
+};
+struct Job {
+  std::string name;
+};
+
+struct Idle {
+  std::vector<std::string> log;
+
+  auto handle(const Start &) { return sctl::State<Busy>{}; }
+  void handle(const Action &a) {
+    log.push_back("action " + std::to_string(a.id));
+  }
+  void handle(const Job &j) { log.push_back("job " + j.name); }
+};
+struct Busy {
+  using StartState = Loading;
+  using Deferred = sctl::Deferred<Action, Job>;
+  auto handle(const Done &) { return sctl::State<Idle>{}; }
+};
+struct Loading {
+  using ParentState = Busy;
+  int actions{0};
+
+  auto handle(const Next &) { return sctl::State<Saving>{}; }
+  // Handler below deferring state takes precedence.
+  void handle(const Action &) { ++actions; }
+};
+struct Saving {
+  using ParentState = Busy;
+  auto handle(const Next &) { return sctl::State<Loading>{}; }
+};
+
+struct Overflow : sctl::NoObserver {
+  std::size_t dropped{0};
+  template <typename Event> void on_defer_overflow(const Event &) {
+    ++dropped;
+  }
+};
+
+using DeferringSC = sctl::StateChart<sctl::WithObserver<Overflow>, Idle, Busy,
+                                     Loading, Saving>;
+
+struct DeferredEvents : public ::testing::Test {
+  Idle idle;
+  Busy busy;
+  Loading loading;
+  Saving saving;
+
+  DeferringSC instance{idle, busy, loading, saving};
+
+  void start_saving() {
+    instance.start();
+    instance.handle(Start{});
+    instance.handle(Next{});
+  }
+};
+
+TEST_F(DeferredEvents, HandlerBelowDeferringStateTakesPrecedence) {
+  instance.start();
+  instance.handle(Start{});
+
+  instance.handle(Action{1});
+  instance.handle(Done{});
+
+  EXPECT_EQ(loading.actions, 1);
+  EXPECT_TRUE(idle.log.empty());
+}
+
+TEST_F(DeferredEvents, RedispatchedInOrderAfterLeavingDeferringState) {
+  start_saving();
+
+  instance.handle(Action{1});
+  instance.handle(Job{"report"});
+  instance.handle(Action{2});
+  EXPECT_TRUE(idle.log.empty());
+
+  instance.handle(Done{});
+
+  EXPECT_THAT(idle.log,
+              ::testing::ElementsAre("action 1", "job report", "action 2"));
+  EXPECT_TRUE(instance.is_active<Idle>());
+}
+
+TEST_F(DeferredEvents, DeferredAgainWhileDeferringStateStaysActive) {
+  start_saving();
+  instance.handle(Job{"a"});
+
+  instance.handle(Next{});
+  instance.handle(Next{});
+  EXPECT_TRUE(idle.log.empty());
+
+  instance.handle(Done{});
+  EXPECT_THAT(idle.log, ::testing::ElementsAre("job a"));
+}
+
+TEST_F(DeferredEvents, DeferredEventCanBeHandledByNewActiveState) {
+  start_saving();
+  instance.handle(Action{1});
+
+  instance.handle(Next{});
+
+  EXPECT_EQ(loading.actions, 1);
+  instance.handle(Done{});
+  EXPECT_TRUE(idle.log.empty());
+}
+
+TEST_F(DeferredEvents, VariantAndBatchEventsAreDeferred) {
+  using Event = std::variant<Start, Done, Next, Action, Job>;
+  instance.start();
+
+  const Event events[] = {Start{}, Next{}, Job{"x"}, Action{3}, Done{}};
+  instance.handle_batch(std::span<const Event>{events});
+
+  EXPECT_THAT(idle.log, ::testing::ElementsAre("job x", "action 3"));
+}
+
+TEST_F(DeferredEvents, ReportsEventsThatDoNotFit) {
+  start_saving();
+
+  for (std::size_t i = 0; i < DeferringSC::max_deferred + 2; ++i) {
+    instance.handle(Job{"j"});
+  }
+  EXPECT_EQ(instance.observer().dropped, 2u);
+
+  instance.handle(Done{});
+  EXPECT_EQ(idle.log.size(), DeferringSC::max_deferred);
+}
+
+TEST(DeferredArena, ReusesSpaceFreedByPop) {
+  sctl::details::DeferredArena<2, sctl::details::TypeList<Action, Job>> arena;
+  std::vector<std::string> out;
+  const auto record = [&out](const auto &event) {
+    if constexpr (std::is_same<std::decay_t<decltype(event)>, Job>::value) {
+      out.push_back(event.name);
+    } else {
+      out.push_back(std::to_string(event.id));
+    }
+  };
+
+  EXPECT_TRUE(arena.push(Job{"first"}));
+  EXPECT_TRUE(arena.push(Action{1}));
+  EXPECT_TRUE(arena.push(Action{2}));
+  EXPECT_FALSE(arena.push(Job{"no room"}));
+
+  arena.pop(record);
+  EXPECT_TRUE(arena.push(Job{"second"}));
+  EXPECT_EQ(arena.size(), 3u);
+
+  while (!arena.empty()) {
+    arena.pop(record);
+  }
+  EXPECT_THAT(out, ::testing::ElementsAre("first", "1", "2", "second"));
+}
+
+} // namespace
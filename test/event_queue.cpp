@@ -0,0 +1,133 @@
+#include "gmock/gmock.h"
+
+#include "sctl_queue.h"
+
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/*
+ Event queue
+
+ counter state counts Increment events, Burst event posts more Increments from
+ inside handler, Stop moves to stopped state, Fail throws from handler
+
+*/
+
+struct Increment {};
+struct Burst {
+  int count;
+};
+struct Stop {};
+struct Fail {};
+
+struct Counting;
+struct Stopped;
+
+using QueueSC = sctl::StateChart<Counting, Stopped>;
+using Queue = sctl::EventQueue<QueueSC, 1024, Increment, Burst, Stop, Fail>;
+
+struct Counting {
+  Queue *queue{nullptr};
+  int count{0};
+
+  void handle(const Increment &) { ++count; }
+  void handle(const Burst &b) {
+    for (int i = 0; i < b.count; ++i) {
+      queue->post(Increment{});
+    }
+    EXPECT_EQ(queue->drain(), 0u);
+  }
+  auto handle(const Stop &) { return sctl::State<Stopped>{}; }
+  void handle(const Fail &) { throw std::runtime_error{"fail"}; }
+};
+
+struct Stopped {
+  MOCK_METHOD(void, enter, ());
+};
+
+struct EventQueueSC : public ::testing::Test {
+  Counting counting;
+  Stopped stopped;
+
+  QueueSC instance{counting, stopped};
+  Queue queue{instance};
+
+  EventQueueSC() {
+    counting.queue = &queue;
+    instance.start();
+  }
+};
+
+TEST_F(EventQueueSC, NothingHandledUntilDrained) {
+  queue.post(Increment{});
+  queue.post(Increment{});
+
+  EXPECT_EQ(counting.count, 0);
+  EXPECT_EQ(queue.drain(), 2u);
+  EXPECT_EQ(counting.count, 2);
+}
+
+TEST_F(EventQueueSC, PostFromHandlerIsHandledAfterCurrentEvent) {
+  queue.post(Burst{3});
+  queue.post(Increment{});
+
+  EXPECT_EQ(queue.drain(), 5u);
+  EXPECT_EQ(counting.count, 4);
+}
+
+TEST_F(EventQueueSC, EventsHandledInPostingOrder) {
+  EXPECT_CALL(stopped, enter());
+
+  queue.post(Increment{});
+  queue.post(Stop{});
+  queue.post(Increment{});
+
+  queue.drain();
+  EXPECT_EQ(counting.count, 1);
+}
+
+TEST_F(EventQueueSC, PostFailsWhenFull) {
+  for (int i = 0; i < 1024; ++i) {
+    ASSERT_TRUE(queue.post(Increment{}));
+  }
+  EXPECT_FALSE(queue.post(Increment{}));
+
+  queue.drain();
+  EXPECT_TRUE(queue.post(Increment{}));
+}
+
+TEST_F(EventQueueSC, DrainsAgainAfterHandlerThrows) {
+  queue.post(Fail{});
+  queue.post(Increment{});
+
+  EXPECT_THROW(queue.drain(), std::runtime_error);
+  EXPECT_EQ(counting.count, 0);
+
+  queue.post(Burst{2});
+  EXPECT_EQ(queue.drain(), 4u);
+  EXPECT_EQ(counting.count, 3);
+}
+
+TEST_F(EventQueueSC, MultipleProducers) {
+  constexpr int producers = 4;
+  constexpr int per_producer = 10000;
+
+  std::jthread consumer{[this](std::stop_token stop) { queue.run(stop); }};
+
+  std::vector<std::jthread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([this] {
+      for (int i = 0; i < per_producer; ++i) {
+        while (!queue.post(Increment{})) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  threads.clear();
+  consumer.request_stop();
+  consumer.join();
+
+  EXPECT_EQ(counting.count, producers * per_producer);
+}
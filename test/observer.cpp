@@ -0,0 +1,228 @@
+#include "complex_state_chart.h"
+
+#include "sctl_parser_trace.h"
+
+#include <sstream>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using ::testing::ElementsAre;
+using ::testing::NiceMock;
+
+// Indexes of states in ObservedSC.
+enum : std::size_t {
+  IOff,
+  IOffInternal,
+  IError,
+  IOn,
+  IInit,
+  IReady,
+  IBusy,
+  IConfig,
+  IProcessing,
+  IWaiting
+};
+
+struct Recorder : sctl::NoObserver {
+  std::vector<std::string> log;
+
+  void on_event(const Tick &) { log.push_back("event Tick"); }
+  template <typename Event> void on_event(const Event &) {
+    log.push_back("event");
+  }
+  template <typename S> void on_exit(std::size_t index) {
+    log.push_back("exit " + std::to_string(index));
+  }
+  template <typename S> void on_enter(std::size_t index) {
+    log.push_back("enter " + std::to_string(index));
+  }
+  template <typename From, typename To>
+  void on_transition(std::size_t from, std::size_t to) {
+    log.push_back("transition " + std::to_string(from) + " " +
+                  std::to_string(to));
+  }
+};
+
+template <typename Observer>
+using ObservedSC =
+    sctl::StateChart<sctl::WithObserver<Observer>, Off, OffInternal, Error, On,
+                     Init, Ready, Busy, Config, Processing, Waiting>;
+
+static_assert(sizeof(SC) == sizeof(ObservedSC<sctl::NoObserver>));
+
+template <typename Observer>
+struct ObservedStateChart : public ::testing::Test {
+  NiceMock<Off> off;
+  NiceMock<OffInternal> off_internal;
+  NiceMock<Error> error;
+  NiceMock<On> on;
+  NiceMock<Init> init;
+  NiceMock<Ready> ready;
+  NiceMock<Busy> busy;
+  NiceMock<Config> config;
+  NiceMock<Processing> processing;
+  NiceMock<Waiting> waiting;
+
+  ObservedSC<Observer> instance{off,  off_internal, error,  on,
+                                init, ready,        busy,   config,
+                                processing,         waiting};
+};
+
+using RecordedStateChart = ObservedStateChart<Recorder>;
+
+TEST_F(RecordedStateChart, ReportsEnterOnStartWithEntry) {
+  instance.start(true);
+
+  EXPECT_THAT(instance.observer().log,
+              ElementsAre("enter " + std::to_string(IOff),
+                          "enter " + std::to_string(IOffInternal)));
+}
+
+TEST_F(RecordedStateChart, ReportsTransitionExitsAndEnters) {
+  instance.start();
+
+  instance.handle(PowerOn{});
+
+  EXPECT_THAT(instance.observer().log,
+              ElementsAre("event",
+                          "transition " + std::to_string(IOffInternal) + " " +
+                              std::to_string(IInit),
+                          "exit " + std::to_string(IOffInternal),
+                          "exit " + std::to_string(IOff),
+                          "enter " + std::to_string(IOn),
+                          "enter " + std::to_string(IInit)));
+}
+
+TEST_F(RecordedStateChart, ReportsEnterRedirectAsTransition) {
+  instance.start();
+  instance.handle(PowerOn{});
+  instance.handle(Initialized{});
+  instance.observer().log.clear();
+
+  instance.handle(Configure{});
+
+  EXPECT_THAT(instance.observer().log,
+              ElementsAre("event",
+                          "transition " + std::to_string(IReady) + " " +
+                              std::to_string(IProcessing),
+                          "exit " + std::to_string(IReady),
+                          "enter " + std::to_string(IConfig),
+                          "enter " + std::to_string(IProcessing),
+                          "transition " + std::to_string(IProcessing) + " " +
+                              std::to_string(IWaiting),
+                          "exit " + std::to_string(IProcessing),
+                          "enter " + std::to_string(IWaiting)));
+}
+
+TEST_F(RecordedStateChart, ReportsUnhandledEvents) {
+  instance.start();
+
+  instance.handle(Initialized{});
+  instance.handle(std::variant<Tick, Action>{Action{}});
+  instance.handle(std::variant<Tick, Action>{Tick{}});
+
+  EXPECT_THAT(instance.observer().log,
+              ElementsAre("event", "event", "event Tick"));
+}
+
+TEST_F(RecordedStateChart, NoReportsWhenNotStarted) {
+  instance.handle(PowerOn{});
+  instance.handle(std::variant<Tick, Action>{Tick{}});
+
+  EXPECT_TRUE(instance.observer().log.empty());
+}
+
+using Traced = sctl::TraceObserver<PowerOn, PowerOff, Initialized, Failure,
+                                   Action, Timeout, Configure, Tick>;
+using TracedStateChart = ObservedStateChart<Traced>;
+
+TEST_F(TracedStateChart, WritesRecordsToThreadBuffer) {
+  sctl::TraceBuffer::local().clear();
+  instance.start();
+
+  instance.handle(PowerOn{});
+
+  const auto records = sctl::TraceBuffer::local().snapshot();
+  ASSERT_EQ(records.size(), 6u);
+  EXPECT_EQ(records[0].kind, sctl::TraceKind::Event);
+  EXPECT_EQ(records[0].event, 0u);
+  EXPECT_EQ(records[1].kind, sctl::TraceKind::Transition);
+  EXPECT_EQ(records[1].state, IOffInternal);
+  EXPECT_EQ(records[1].target, IInit);
+  EXPECT_EQ(records[5].kind, sctl::TraceKind::Enter);
+  EXPECT_EQ(records[5].state, IInit);
+  EXPECT_LE(records[0].timestamp, records[5].timestamp);
+}
+
+TEST_F(TracedStateChart, KeepsNewestRecordsOnWrap) {
+  sctl::TraceBuffer::local().clear();
+  instance.start();
+
+  for (std::size_t i = 0; i < sctl::TraceBuffer::capacity + 1; ++i) {
+    instance.handle(Tick{});
+  }
+  instance.handle(PowerOn{});
+
+  const auto records = sctl::TraceBuffer::local().snapshot();
+  ASSERT_EQ(records.size(), sctl::TraceBuffer::capacity);
+  EXPECT_EQ(records.back().kind, sctl::TraceKind::Enter);
+  EXPECT_EQ(records.back().state, IInit);
+}
+
+TEST(TraceBuffer, SnapshotFromOtherThreadHasNoTornRecords) {
+  auto buffer = std::make_unique<sctl::TraceBuffer>();
+  std::atomic<bool> done{false};
+  std::thread writer{[&] {
+    for (std::uint64_t i = 1; i <= 200'000; ++i) {
+      const auto index = static_cast<std::uint16_t>(i);
+      buffer->write({i, index, index, index, sctl::TraceKind::Event});
+    }
+    done = true;
+  }};
+
+  bool complete = false;
+  while (!complete) {
+    complete = done;
+    const auto records = buffer->snapshot();
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      const auto index = static_cast<std::uint16_t>(records[i].timestamp);
+      ASSERT_EQ(records[i].event, index);
+      ASSERT_EQ(records[i].target, index);
+      if (i > 0) {
+        ASSERT_LT(records[i - 1].timestamp, records[i].timestamp);
+      }
+    }
+  }
+  writer.join();
+
+  const auto records = buffer->snapshot();
+  ASSERT_EQ(records.size(), sctl::TraceBuffer::capacity);
+  EXPECT_EQ(records.back().timestamp, 200'000u);
+  buffer->clear();
+  EXPECT_TRUE(buffer->snapshot().empty());
+}
+
+TEST_F(TracedStateChart, DecodesNamesWithParser) {
+  sctl::TraceBuffer::local().clear();
+  instance.start();
+  instance.handle(PowerOn{});
+
+  sctl::parser::Parser<ObservedSC<Traced>, PowerOn, PowerOff, Initialized,
+                       Failure, Action, Timeout, Configure, Tick>
+      parser;
+  std::ostringstream out;
+  out << sctl::parser::Trace{parser(), sctl::TraceBuffer::local().snapshot()};
+
+  std::vector<std::string> lines;
+  std::istringstream in{out.str()};
+  for (std::string line; std::getline(in, line);) {
+    lines.push_back(line.substr(line.find(' ') + 1));
+  }
+  EXPECT_THAT(lines,
+              ElementsAre("event PowerOn", "transition OffInternal -> Init",
+                          "exit OffInternal", "exit Off", "enter On",
+                          "enter Init"));
+}
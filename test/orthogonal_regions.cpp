@@ -0,0 +1,298 @@
+#include "gmock/gmock.h"
+
+#include "sctl.h"
+
+#include <stdexcept>
+#include <variant>
+
+/*
+ Orthogonal Regions
+
+```
+@startuml
+hide empty description
+
+state Device {
+  state Power {
+    [*] --> Battery
+    Battery --> Mains : Plug
+    Mains --> Battery : Unplug
+  }
+  --
+  state Link {
+    [*] --> Offline
+    Offline --> Online : Connect
+    Online --> Offline : Disconnect
+  }
+}
+
+[*] --> Idle
+Idle --> Device : TurnOn
+Device --> Idle : TurnOff
+Mains --> Idle : Surge
+@enduml
+```
+
+*/
+
+namespace {
+
+struct Idle;
+struct Device;
+struct Power;
+struct Battery;
+struct Mains;
+struct Link;
+struct Offline;
+struct Online;
+
+struct TurnOn {};
+struct TurnOff {};
+struct Plug {};
+struct Unplug {};
+struct Connect {};
+struct Disconnect {};
+struct Surge {};
+struct Ping {};
+struct Status {};
+
+struct StateBase {
+  MOCK_METHOD(void, enter, ());
+  MOCK_METHOD(void, exit, ());
+};
+
+struct Idle : StateBase {
+  auto handle(const TurnOn &) { return sctl::State<Device>{}; }
+};
+struct Device : StateBase {
+  using Regions = sctl::Regions<Power, Link>;
+  auto handle(const TurnOff &) { return sctl::State<Idle>{}; }
+  MOCK_METHOD(void, handle, (const Status &));
+};
+struct Power : StateBase {
+  using ParentState = Device;
+  using StartState = Battery;
+};
+struct Battery : StateBase {
+  using ParentState = Power;
+  auto handle(const Plug &) { return sctl::State<Mains>{}; }
+};
+struct Mains : StateBase {
+  using ParentState = Power;
+  auto handle(const Unplug &) { return sctl::State<Battery>{}; }
+  auto handle(const Surge &) { return sctl::State<Idle>{}; }
+};
+struct Link : StateBase {
+  using ParentState = Device;
+  using StartState = Offline;
+};
+struct Offline : StateBase {
+  using ParentState = Link;
+  auto handle(const Connect &) { return sctl::State<Online>{}; }
+};
+struct Online : StateBase {
+  using ParentState = Link;
+  auto handle(const Disconnect &) { return sctl::State<Offline>{}; }
+  MOCK_METHOD(void, handle, (const Ping &));
+};
+
+using RegionsSC = sctl::StateChart<Idle, Device, Power, Battery, Mains, Link,
+                                   Offline, Online>;
+using DeviceSC = sctl::StateChart<Device, Power, Battery, Mains, Link,
+                                  Offline, Online, Idle>;
+
+using Engine = sctl::details::Engine<Idle, Device, Power, Battery, Mains, Link,
+                                     Offline, Online>;
+static_assert(Engine::region_count == 2);
+
+template <typename SC> struct Regions : public ::testing::Test {
+  ::testing::NiceMock<Idle> idle;
+  ::testing::NiceMock<Device> device;
+  ::testing::NiceMock<Power> power;
+  ::testing::NiceMock<Battery> battery;
+  ::testing::NiceMock<Mains> mains;
+  ::testing::NiceMock<Link> link;
+  ::testing::NiceMock<Offline> offline;
+  ::testing::NiceMock<Online> online;
+};
+
+struct RegionsStateChart : Regions<RegionsSC> {
+  RegionsSC instance{idle, device, power,   battery,
+                     mains, link,  offline, online};
+};
+
+struct StartInRegions : Regions<DeviceSC> {
+  DeviceSC instance{device, power,   battery, mains,
+                    link,   offline, online,  idle};
+};
+
+TEST_F(StartInRegions, StartActivatesStartStateOfEveryRegion) {
+  instance.start();
+
+  EXPECT_TRUE(instance.is_active<Device>());
+  EXPECT_TRUE(instance.is_active<Battery>());
+  EXPECT_TRUE(instance.is_active<Offline>());
+  EXPECT_FALSE(instance.is_active<Mains>());
+  EXPECT_FALSE(instance.is_active<Idle>());
+}
+
+TEST_F(StartInRegions, StartWithEntryEntersEveryRegion) {
+  ::testing::InSequence seq;
+
+  EXPECT_CALL(device, enter());
+  EXPECT_CALL(power, enter());
+  EXPECT_CALL(battery, enter());
+  EXPECT_CALL(link, enter());
+  EXPECT_CALL(offline, enter());
+
+  instance.start(true);
+}
+
+TEST_F(RegionsStateChart, EnteringStateEntersEveryRegion) {
+  ::testing::InSequence seq;
+  instance.start();
+
+  EXPECT_CALL(idle, exit());
+  EXPECT_CALL(device, enter());
+  EXPECT_CALL(power, enter());
+  EXPECT_CALL(battery, enter());
+  EXPECT_CALL(link, enter());
+  EXPECT_CALL(offline, enter());
+
+  instance.handle(TurnOn{});
+
+  EXPECT_TRUE(instance.is_active<Battery>());
+  EXPECT_TRUE(instance.is_active<Offline>());
+}
+
+TEST_F(RegionsStateChart, RegionsHandleEventsIndependently) {
+  instance.start();
+  instance.handle(TurnOn{});
+
+  EXPECT_CALL(battery, exit());
+  EXPECT_CALL(mains, enter());
+  EXPECT_CALL(offline, exit()).Times(0);
+
+  instance.handle(Plug{});
+  EXPECT_TRUE(instance.is_active<Mains>());
+  EXPECT_TRUE(instance.is_active<Offline>());
+  ::testing::Mock::VerifyAndClearExpectations(&offline);
+
+  EXPECT_CALL(mains, exit()).Times(0);
+  instance.handle(Connect{});
+  EXPECT_TRUE(instance.is_active<Mains>());
+  EXPECT_TRUE(instance.is_active<Online>());
+}
+
+TEST_F(RegionsStateChart, EventNotHandledInRegionsGoesToState) {
+  instance.start();
+  instance.handle(TurnOn{});
+  instance.handle(Connect{});
+
+  EXPECT_CALL(online, handle(::testing::An<const Ping &>()));
+  EXPECT_CALL(device, handle(::testing::An<const Status &>()));
+
+  instance.handle(Ping{});
+  instance.handle(Status{});
+}
+
+TEST_F(RegionsStateChart, LeavingStateExitsEveryRegion) {
+  ::testing::InSequence seq;
+  instance.start();
+  instance.handle(TurnOn{});
+  instance.handle(Plug{});
+
+  EXPECT_CALL(mains, exit());
+  EXPECT_CALL(power, exit());
+  EXPECT_CALL(offline, exit());
+  EXPECT_CALL(link, exit());
+  EXPECT_CALL(device, exit());
+  EXPECT_CALL(idle, enter());
+
+  instance.handle(TurnOff{});
+
+  EXPECT_TRUE(instance.is_active<Idle>());
+  EXPECT_FALSE(instance.is_active<Device>());
+  EXPECT_FALSE(instance.is_active<Mains>());
+  EXPECT_FALSE(instance.is_active<Offline>());
+}
+
+TEST_F(RegionsStateChart, TransitionOutOfRegionExitsOtherRegions) {
+  ::testing::InSequence seq;
+  instance.start();
+  instance.handle(TurnOn{});
+  instance.handle(Plug{});
+  instance.handle(Connect{});
+
+  EXPECT_CALL(mains, exit());
+  EXPECT_CALL(power, exit());
+  EXPECT_CALL(online, exit());
+  EXPECT_CALL(link, exit());
+  EXPECT_CALL(device, exit());
+  EXPECT_CALL(idle, enter());
+
+  instance.handle(Surge{});
+
+  EXPECT_TRUE(instance.is_active<Idle>());
+  EXPECT_FALSE(instance.is_active<Online>());
+}
+
+TEST_F(RegionsStateChart, ReenteringStateRestartsRegions) {
+  instance.start();
+  instance.handle(TurnOn{});
+  instance.handle(Plug{});
+  instance.handle(Connect{});
+  instance.handle(TurnOff{});
+
+  instance.handle(TurnOn{});
+
+  EXPECT_TRUE(instance.is_active<Battery>());
+  EXPECT_TRUE(instance.is_active<Offline>());
+}
+
+TEST_F(RegionsStateChart, RegionEventsIgnoredOutsideState) {
+  instance.start();
+
+  EXPECT_CALL(battery, exit()).Times(0);
+  EXPECT_CALL(online, handle(::testing::An<const Ping &>())).Times(0);
+
+  instance.handle(Plug{});
+  instance.handle(Ping{});
+
+  EXPECT_TRUE(instance.is_active<Idle>());
+}
+
+TEST_F(RegionsStateChart, VariantAndBatchDispatchToRegions) {
+  using Event = std::variant<TurnOn, Plug, Connect, Ping>;
+  instance.start();
+
+  EXPECT_CALL(online, handle(::testing::An<const Ping &>()));
+
+  instance.handle(Event{TurnOn{}});
+  instance.handle(Event{Plug{}});
+  const Event rest[] = {Connect{}, Ping{}};
+  instance.handle_batch(std::span<const Event>{rest});
+
+  EXPECT_TRUE(instance.is_active<Mains>());
+  EXPECT_TRUE(instance.is_active<Online>());
+}
+
+// Throwing emplace() of this event leaves variant valueless.
+struct FailingEvent {
+  FailingEvent() = default;
+  FailingEvent(const FailingEvent &) {}
+  explicit FailingEvent(int) { throw std::runtime_error{"event"}; }
+};
+
+TEST_F(RegionsStateChart, ValuelessEventVariantThrows) {
+  using Event = std::variant<Plug, FailingEvent>;
+  instance.start();
+
+  Event event{Plug{}};
+  EXPECT_THROW(event.emplace<FailingEvent>(0), std::runtime_error);
+
+  EXPECT_THROW(instance.handle(event), std::bad_variant_access);
+  EXPECT_TRUE(instance.is_active<Idle>());
+}
+
+} // namespace
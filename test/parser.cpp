@@ -0,0 +1,225 @@
+#include "gmock/gmock.h"
+
+#include "complex_state_chart.h"
+#include "sctl_parser.h"
+#include "sctl_parser_dot.h"
+#include "sctl_parser_json.h"
+#include "sctl_parser_plantuml.h"
+
+#include <sstream>
+#include <string>
+#include <string_view>
+
+namespace {
+
+using ComplexParser =
+    sctl::parser::Parser<SC, PowerOn, PowerOff, Initialized, Failure, Action,
+                         Timeout, Configure, Tick>;
+
+constexpr std::size_t none = sctl::parser::none;
+
+static_assert(sctl::details::type_name<int>() == "int");
+static_assert(sctl::details::type_name<Config>() == "Config");
+static_assert(sctl::details::type_name<sctl::NoAction>() == "sctl::NoAction");
+
+// Names as MSVC spells them.
+constexpr bool strips_to(std::string_view spelled, std::string_view name) {
+  char buffer[64]{};
+  const auto size = sctl::details::strip_elaborated(spelled, buffer);
+  return size == sctl::details::strip_elaborated(spelled, nullptr) &&
+         std::string_view{buffer, size} == name;
+}
+static_assert(strips_to("struct sctl::NoAction", "sctl::NoAction"));
+static_assert(strips_to("class Config", "Config"));
+static_assert(strips_to("struct sctl::details::TypeList<struct A,class "
+                        "B<enum C,union D> >",
+                        "sctl::details::TypeList<A,B<C,D> >"));
+static_assert(strips_to("Subclass<int,myenum >", "Subclass<int,myenum >"));
+static_assert(std::string_view{
+                  sctl::details::StrippedTypeName<Config>::value.data(),
+                  sctl::details::StrippedTypeName<Config>::value.size()} ==
+              "Config");
+
+static_assert(ComplexParser::states.size() == 10);
+static_assert(ComplexParser::states[0].name == "Off");
+static_assert(ComplexParser::states[0].parent == none);
+static_assert(ComplexParser::states[0].start_state == 1);
+static_assert(ComplexParser::states[8].name == "Processing");
+static_assert(ComplexParser::states[8].parent == 7);
+static_assert(ComplexParser::events[7] == "Tick");
+
+// Error::enter() redirects to Off.
+static_assert(ComplexParser::transitions[1].from == 2);
+static_assert(ComplexParser::transitions[1].event == none);
+static_assert(ComplexParser::targets_of(ComplexParser::transitions[1])[0]
+                  .state == 0);
+
+constexpr std::size_t count_targets(std::string_view from,
+                                    std::size_t state) {
+  std::size_t count = 0;
+  for (const auto &t : ComplexParser::transitions) {
+    if (ComplexParser::states[t.from].name == from) {
+      for (const auto &target : ComplexParser::targets_of(t)) {
+        count += target.state == state;
+      }
+    }
+  }
+  return count;
+}
+static_assert(count_targets("Processing", 9) == 1);
+static_assert(count_targets("Processing", none) == 1);
+static_assert(count_targets("Waiting", 5) == 1);
+
+TEST(Parser, RuntimeResultMatchesStaticGraph) {
+  const auto result = ComplexParser{}();
+
+  ASSERT_EQ(result.states.size(), ComplexParser::states.size());
+  EXPECT_EQ(result.states[3].name, "On");
+  EXPECT_EQ(result.states[3].start_state, "Init");
+  EXPECT_EQ(result.states[4].parent, "On");
+  EXPECT_FALSE(result.states[2].parent);
+
+  ASSERT_EQ(result.transitions.size(), ComplexParser::transitions.size());
+  EXPECT_EQ(result.transitions[0].from, "Off");
+  EXPECT_THAT(result.transitions[0].to, ::testing::ElementsAre("On"));
+  EXPECT_EQ(result.transitions[0].action, "PowerOn");
+
+  EXPECT_THAT(result.events, ::testing::ElementsAre(
+                                 "PowerOn", "PowerOff", "Initialized",
+                                 "Failure", "Action", "Timeout", "Configure",
+                                 "Tick"));
+}
+
+sctl::parser::ParseResult nested_result() {
+  return {{{"Top", {}, "Mid"},
+           {"Leaf", "Mid", {}},
+           {"Mid", "Top", "Leaf"},
+           {"Other", {}, {}}},
+          {{"Leaf", {"Other"}, "Go"}, {"Other", {"sctl::NoAction"}, "Go"}},
+          {"Go"}};
+}
+
+TEST(Hierarchy, ChildrenListedBeforeParentsAreLinked) {
+  const auto result = nested_result();
+  sctl::parser::Hierarchy hierarchy{result};
+  std::string order;
+  hierarchy.walk(
+      [&](std::size_t s, std::size_t depth) {
+        order += std::to_string(depth) + result.states[s].name + " ";
+      },
+      [&](std::size_t s, std::size_t) {
+        order += "/" + result.states[s].name + " ";
+      });
+
+  EXPECT_EQ(order, "0Top 1Mid 2Leaf /Leaf /Mid /Top 0Other /Other ");
+}
+
+TEST(PlantUML, NestsStatesInParents) {
+  std::ostringstream out;
+  out << sctl::parser::PlantUML{nested_result()};
+
+  EXPECT_EQ(out.str(), "@startuml\n"
+                       "state Top {\n"
+                       "\t[*] --> Mid\n"
+                       "\tstate Mid {\n"
+                       "\t\t[*] --> Leaf\n"
+                       "\t\tstate Leaf\n"
+                       "\t}\n"
+                       "}\n"
+                       "state Other\n"
+                       "[*] --> Top\n"
+                       "Leaf --> Other: Go\n"
+                       "Other --> Other: Go\n"
+                       "@enduml\n");
+}
+
+TEST(PlantUML, DrawsKeptStateAsInternalTransition) {
+  std::ostringstream out;
+  out << sctl::parser::PlantUML{nested_result(), true};
+
+  EXPECT_THAT(out.str(), ::testing::HasSubstr("\nOther : Go\n"));
+  EXPECT_THAT(out.str(), ::testing::HasSubstr("\nLeaf --> Other: Go\n"));
+}
+
+TEST(Dot, DrawsParentsAsClusters) {
+  std::ostringstream out;
+  out << sctl::parser::Dot{nested_result()};
+
+  EXPECT_THAT(out.str(), ::testing::HasSubstr("subgraph \"cluster_Mid\" {\n"
+                                              "\t\t\tlabel=\"Mid\";\n"
+                                              "\t\t\t\"Mid\" [shape=point];\n"
+                                              "\t\t\t\"Leaf\";\n"
+                                              "\t\t}\n"));
+  EXPECT_THAT(out.str(), ::testing::HasSubstr("\t\"Top\" -> \"Mid\";\n"));
+  EXPECT_THAT(out.str(),
+              ::testing::HasSubstr("\t\"Other\" -> \"Other\" [label=\"Go\"];"));
+}
+
+TEST(Json, WritesNestedStates) {
+  std::ostringstream out;
+  out << sctl::parser::Json{nested_result()};
+
+  EXPECT_EQ(out.str(),
+            R"({"states":[{"name":"Top","start_state":"Mid","states":[)"
+            R"({"name":"Mid","start_state":"Leaf","states":[{"name":"Leaf"}]}]},)"
+            R"({"name":"Other"}],"transitions":[)"
+            R"({"from":"Leaf","to":["Other"],"event":"Go"},)"
+            R"({"from":"Other","to":["sctl::NoAction"],"event":"Go"}],)"
+            R"("events":["Go"]})"
+            "\n");
+}
+
+TEST(Json, EscapesNames) {
+  std::ostringstream out;
+  out << sctl::parser::Json{{{{"A<\"x\\\">", {}, {}}}, {}, {}}};
+
+  EXPECT_EQ(out.str(),
+            R"({"states":[{"name":"A<\"x\\\">"}],"transitions":[],"events":[]})"
+            "\n");
+}
+
+namespace context {
+
+struct Counter {
+  int value{0};
+};
+
+struct Start {};
+struct Stop {};
+
+struct Idle;
+struct Running;
+
+struct Idle {
+  auto handle(Counter &, const Start &) { return sctl::State<Running>{}; }
+};
+struct Running {
+  sctl::State<Idle> enter(Counter &c) {
+    ++c.value;
+    return {};
+  }
+  auto handle(Counter &, const Stop &) { return sctl::State<Idle>{}; }
+};
+
+using ContextParser = sctl::parser::Parser<
+    sctl::StateChart<sctl::WithContext<Counter>, Idle, Running>, Start, Stop>;
+
+static_assert(ContextParser::states.size() == 2);
+static_assert(ContextParser::states[0].name.ends_with("context::Idle"));
+
+} // namespace context
+
+TEST(Parser, ReadsActionsTakingContext) {
+  const auto result = context::ContextParser{}();
+
+  ASSERT_EQ(result.transitions.size(), 3u);
+  EXPECT_THAT(result.transitions[0].from, ::testing::EndsWith("Idle"));
+  EXPECT_THAT(result.transitions[0].to,
+              ::testing::ElementsAre(::testing::EndsWith("Running")));
+  EXPECT_THAT(*result.transitions[0].action, ::testing::EndsWith("Start"));
+  EXPECT_THAT(result.transitions[1].from, ::testing::EndsWith("Running"));
+  EXPECT_EQ(result.transitions[1].action, std::nullopt);
+  EXPECT_THAT(*result.transitions[2].action, ::testing::EndsWith("Stop"));
+}
+
+} // namespace
@@ -0,0 +1,183 @@
+#include "complex_state_chart.h"
+
+#include "sctl_parser_profile.h"
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+using ::testing::HasSubstr;
+using ::testing::NiceMock;
+
+using Profiled = sctl::ProfileObserver<PowerOn, PowerOff, Initialized, Failure,
+                                       Action, Timeout, Configure, Tick>;
+using ProfiledSC =
+    sctl::StateChart<sctl::WithObserver<Profiled>, Off, OffInternal, Error, On,
+                     Init, Ready, Busy, Config, Processing, Waiting>;
+
+// Indexes of states and columns in segment.
+enum : std::size_t { IOff = 0, IOffInternal = 1, IOn = 3, IInit = 4 };
+enum : std::size_t { CPowerOn = 0, CTick = 7, CEnter = 8, CExit = 9 };
+
+static_assert(sctl::profile_bucket(3) == 3);
+static_assert(sctl::profile_bucket(4) == 4);
+static_assert(sctl::profile_bucket(7) == 7);
+static_assert(sctl::profile_bucket(8) == 8);
+static_assert(sctl::profile_bucket(12) == 10);
+static_assert(sctl::profile_bucket_begin(sctl::profile_bucket(1000)) <= 1000);
+static_assert(sctl::profile_bucket(~std::uint64_t{0}) <
+              sctl::profile_buckets);
+
+struct ProfiledStateChart : public ::testing::Test {
+  const std::string name = "/sctl_test_profile_" + std::to_string(getpid());
+  sctl::ProfileSegment segment =
+      sctl::ProfileSegment::create<ProfiledSC, PowerOn, PowerOff, Initialized,
+                                   Failure, Action, Timeout, Configure, Tick>(
+          name, 4);
+
+  NiceMock<Off> off;
+  NiceMock<OffInternal> off_internal;
+  NiceMock<Error> error;
+  NiceMock<On> on;
+  NiceMock<Init> init;
+  NiceMock<Ready> ready;
+  NiceMock<Busy> busy;
+  NiceMock<Config> config;
+  NiceMock<Processing> processing;
+  NiceMock<Waiting> waiting;
+
+  ProfiledSC instance{Profiled{segment},
+                      off,
+                      off_internal,
+                      error,
+                      on,
+                      init,
+                      ready,
+                      busy,
+                      config,
+                      processing,
+                      waiting};
+
+  ~ProfiledStateChart() { sctl::ProfileSegment::remove(name); }
+
+  std::uint64_t count(std::size_t thread, std::size_t state,
+                      std::size_t column) {
+    return sctl::ProfileSegment::load(
+        segment.entry(thread, state, column).count);
+  }
+};
+
+TEST_F(ProfiledStateChart, CountsHandlersAndActions) {
+  instance.start();
+
+  instance.handle(Tick{});
+  instance.handle(Tick{});
+  instance.handle(PowerOn{});
+
+  ASSERT_EQ(segment.threads(), 1u);
+  EXPECT_EQ(count(0, IOffInternal, CTick), 2u);
+  EXPECT_EQ(count(0, IOff, CPowerOn), 1u);
+  EXPECT_EQ(count(0, IOffInternal, CExit), 1u);
+  EXPECT_EQ(count(0, IOff, CExit), 1u);
+  EXPECT_EQ(count(0, IOn, CEnter), 1u);
+  EXPECT_EQ(count(0, IInit, CEnter), 1u);
+  EXPECT_EQ(count(0, IOn, CPowerOn), 0u);
+}
+
+TEST_F(ProfiledStateChart, EveryThreadWritesOwnBlock) {
+  instance.start();
+  instance.handle(Tick{});
+
+  std::thread{[this] {
+    instance.handle(Tick{});
+    instance.handle(Tick{});
+  }}.join();
+
+  ASSERT_EQ(segment.threads(), 2u);
+  EXPECT_EQ(count(0, IOffInternal, CTick), 1u);
+  EXPECT_EQ(count(1, IOffInternal, CTick), 2u);
+}
+
+TEST_F(ProfiledStateChart, HistogramHoldsEveryMeasurement) {
+  instance.start();
+  for (int i = 0; i < 100; ++i) {
+    instance.handle(Tick{});
+  }
+
+  const auto &entry = segment.entry(0, IOffInternal, CTick);
+  std::uint64_t in_buckets = 0;
+  for (const auto b : entry.buckets) {
+    in_buckets += b;
+  }
+  EXPECT_EQ(in_buckets, 100u);
+}
+
+TEST_F(ProfiledStateChart, ReaderNamesEntriesWithParser) {
+  instance.start();
+  instance.handle(Tick{});
+  instance.handle(PowerOn{});
+
+  sctl::parser::Parser<ProfiledSC, PowerOn, PowerOff, Initialized, Failure,
+                       Action, Timeout, Configure, Tick>
+      parser;
+  std::ostringstream out;
+  out << sctl::parser::Profile{parser(), sctl::ProfileSegment::open(name)};
+
+  EXPECT_THAT(out.str(), HasSubstr("\nOffInternal::handle(Tick),1,"));
+  EXPECT_THAT(out.str(), HasSubstr("\nOff::handle(PowerOn),1,"));
+  EXPECT_THAT(out.str(), HasSubstr("\nOff::exit,1,"));
+  EXPECT_THAT(out.str(), HasSubstr("\nInit::enter,1,"));
+}
+
+TEST_F(ProfiledStateChart, OpensOnlySegmentOfSameLayout) {
+  const auto layout =
+      sctl::ProfileSegment::profile_layout<SC, PowerOn, PowerOff, Initialized,
+                                           Failure, Action, Timeout, Configure,
+                                           Tick>();
+
+  EXPECT_EQ(segment.states(), 10u);
+  EXPECT_EQ(sctl::ProfileSegment::open(name, layout).layout(), layout);
+  EXPECT_THROW(sctl::ProfileSegment::open(
+                   name, sctl::ProfileSegment::profile_layout<SC, Tick>()),
+               std::system_error);
+  EXPECT_THROW(sctl::ProfileObserver<Tick>{segment}, std::invalid_argument);
+}
+
+TEST(ProfileObserver, SkipsStatesBeyondSegment) {
+  const std::string name =
+      "/sctl_test_profile_small_" + std::to_string(getpid());
+  sctl::ProfileSegment segment{name, 2, 8, 1};
+  Profiled observer{segment};
+
+  observer.around_enter<On>(IOn, [] {});
+  observer.around_enter<Off>(IOff, [] {});
+  observer.around_enter<Off>(IOff, [] {});
+
+  EXPECT_EQ(sctl::ProfileSegment::load(segment.entry(0, IOff, CEnter).count),
+            2u);
+  sctl::ProfileSegment::remove(name);
+}
+
+TEST(ProfileSegment, RecordsExactMaximum) {
+  const std::string name = "/sctl_test_profile_max_" + std::to_string(getpid());
+  sctl::ProfileSegment segment{name, 1, 1, 1};
+  auto &entry = segment.local()[0];
+
+  sctl::ProfileSegment::record(entry, 1000);
+  sctl::ProfileSegment::record(entry, 3);
+
+  EXPECT_EQ(sctl::ProfileSegment::load(entry.max_ticks), 1000u);
+  EXPECT_LT(sctl::profile_bucket_begin(sctl::profile_bucket(1000)), 1000u);
+  sctl::ProfileSegment::remove(name);
+}
+
+TEST(ProfileRow, PercentilesAreBucketLowerBounds) {
+  sctl::parser::Profile::Row row{"row", 4};
+  row.buckets[sctl::profile_bucket(2)] = 3;
+  row.buckets[sctl::profile_bucket(1000)] = 1;
+
+  EXPECT_EQ(row.percentile(0.5), 2u);
+  EXPECT_EQ(row.percentile(1.0),
+            sctl::profile_bucket_begin(sctl::profile_bucket(1000)));
+}
@@ -0,0 +1,187 @@
+#include "gmock/gmock.h"
+
+#include "sctl_record.h"
+
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <variant>
+
+#include <unistd.h>
+
+/*
+ Record and replay
+
+```
+@startuml
+hide empty description
+
+state Heating {
+  [*] --> Warming
+  Warming --> Holding : Reached
+}
+
+[*] --> Idle
+Idle --> Heating : Target
+Heating --> Idle : Stop
+Heating : Target / set
+@enduml
+```
+
+*/
+
+namespace {
+
+struct Idle;
+struct Heating;
+struct Warming;
+struct Holding;
+
+struct Target {
+  double celsius;
+  std::uint32_t zone;
+};
+struct Reached {};
+struct Stop {};
+
+struct Idle {
+  auto handle(const Target &) { return sctl::State<Heating>{}; }
+};
+struct Heating {
+  using StartState = Warming;
+  double celsius{0};
+  std::uint32_t zone{0};
+
+  void handle(const Target &t) {
+    celsius = t.celsius;
+    zone = t.zone;
+  }
+  auto handle(const Stop &) { return sctl::State<Idle>{}; }
+};
+struct Warming {
+  using ParentState = Heating;
+  auto handle(const Reached &) { return sctl::State<Holding>{}; }
+};
+struct Holding {
+  using ParentState = Heating;
+};
+
+using HeaterSC = sctl::StateChart<Idle, Heating, Warming, Holding>;
+using Recorder = sctl::EventRecorder<HeaterSC, Target, Reached, Stop>;
+using Replayer = sctl::EventReplayer<HeaterSC, Target, Reached, Stop>;
+
+struct Heater {
+  Idle idle;
+  Heating heating;
+  Warming warming;
+  Holding holding;
+  HeaterSC chart{idle, heating, warming, holding};
+
+  Heater() { chart.start(); }
+};
+
+struct RecordReplay : public ::testing::Test {
+  const std::string path =
+      "/tmp/sctl_test_record_" + std::to_string(getpid()) + ".log";
+
+  RecordReplay() {
+    Heater heater;
+    Recorder recorder{heater.chart, path};
+    for (int i = 0; i < 100; ++i) {
+      recorder.handle(Target{20.0 + i, static_cast<std::uint32_t>(i)});
+      recorder.handle(Reached{});
+      recorder.handle(Target{40.5, 7});
+      recorder.handle(Stop{});
+    }
+    recorder.handle(Target{10.0, 1});
+    recorder.handle(Target{60.25, 3});
+  }
+
+  ~RecordReplay() { std::remove(path.c_str()); }
+};
+
+TEST_F(RecordReplay, ReplaysSameStateSequence) {
+  const sctl::EventLog log{path};
+  ASSERT_EQ(log.size(), 402u);
+
+  Heater heater;
+  const auto report = Replayer{heater.chart}.replay(log);
+
+  EXPECT_EQ(report.events, 402u);
+  EXPECT_EQ(report.mismatches, 0u);
+  EXPECT_LE(report.latency_p50, report.latency_p99);
+  EXPECT_LE(report.latency_p99, report.latency_max);
+  EXPECT_TRUE(heater.chart.is_active<Warming>());
+  EXPECT_EQ(heater.heating.celsius, 60.25);
+  EXPECT_EQ(heater.heating.zone, 3u);
+}
+
+TEST_F(RecordReplay, ReportsFirstMismatch) {
+  const sctl::EventLog log{path};
+
+  Heater heater;
+  heater.chart.handle(Target{0, 0});
+  heater.chart.handle(Reached{});
+  const auto report = Replayer{heater.chart}.replay(log);
+
+  EXPECT_EQ(report.first_mismatch, 0u);
+  EXPECT_GT(report.mismatches, 0u);
+}
+
+TEST_F(RecordReplay, ReplaysAtRecordedPace) {
+  const sctl::EventLog log{path};
+
+  Heater heater;
+  const auto report =
+      Replayer{heater.chart}.replay(log, sctl::ReplayPace::Recorded);
+
+  EXPECT_EQ(report.mismatches, 0u);
+}
+
+TEST_F(RecordReplay, IgnoresTruncatedRecord) {
+  ASSERT_EQ(truncate(path.c_str(), sizeof(sctl::EventLogHeader) + 40), 0);
+  const sctl::EventLog log{path};
+
+  EXPECT_EQ(log.size(), 1u);
+  EXPECT_EQ(log[0].record.event, 0u);
+  EXPECT_EQ(log[0].payload.size(), sizeof(Target));
+}
+
+TEST_F(RecordReplay, RecordsVariantAsAlternative) {
+  {
+    Heater heater;
+    Recorder recorder{heater.chart, path};
+    using Event = std::variant<Target, Reached, Stop>;
+    recorder.handle(Event{Target{30.0, 2}});
+    recorder.handle(Event{Reached{}});
+  }
+  const sctl::EventLog log{path};
+
+  ASSERT_EQ(log.size(), 2u);
+  EXPECT_EQ(log[0].record.event, 0u);
+  EXPECT_EQ(log[1].record.event, 1u);
+  Heater heater;
+  EXPECT_EQ(Replayer{heater.chart}.replay(log).mismatches, 0u);
+  EXPECT_TRUE(heater.chart.is_active<Holding>());
+}
+
+TEST(EventRecorder, FailedFlushThrowsAndDestructorDoesNot) {
+  Heater heater;
+  std::optional<Recorder> recorder{std::in_place, heater.chart, "/dev/full"};
+  recorder->handle(Target{1.0, 1});
+
+  EXPECT_THROW(recorder->flush(), std::system_error);
+  recorder->handle(Stop{});
+  EXPECT_NO_FATAL_FAILURE(recorder.reset());
+}
+
+TEST_F(RecordReplay, RejectsLogOfOtherEvents) {
+  const sctl::EventLog log{path};
+
+  Heater heater;
+  sctl::EventReplayer<HeaterSC, Target, Stop> other{heater.chart};
+  EXPECT_THROW(other.replay(log), std::invalid_argument);
+  EXPECT_THROW(sctl::EventLog{"/tmp"}, std::system_error);
+}
+
+} // namespace
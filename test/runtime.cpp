@@ -0,0 +1,202 @@
+#include "gmock/gmock.h"
+
+#include "complex_state_chart.h"
+#include "sctl_parser_plantuml.h"
+#include "sctl_runtime.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using ::testing::NiceMock;
+
+using Log = std::vector<std::string>;
+
+struct Logger : sctl::NoObserver {
+  Log *log{nullptr};
+
+  template <typename S> void on_enter(std::size_t) {
+    log->push_back("enter " + std::string{sctl::details::type_name<S>()});
+  }
+  template <typename S> void on_exit(std::size_t) {
+    log->push_back("exit " + std::string{sctl::details::type_name<S>()});
+  }
+};
+
+using LoggedSC = sctl::StateChart<sctl::WithObserver<Logger>, Off, OffInternal,
+                                  Error, On, Init, Ready, Busy, Config,
+                                  Processing, Waiting>;
+using ComplexParser =
+    sctl::parser::Parser<SC, PowerOn, PowerOff, Initialized, Failure, Action,
+                         Timeout, Configure, Tick>;
+
+// Binds enter() and exit() of every state to entries of log.
+struct LoggingRegistry {
+  struct Entry {
+    Log *log;
+    std::string enter;
+    std::string exit;
+  };
+
+  LoggingRegistry(const sctl::runtime::Program &program, Log &log)
+      : registry{program}, entries(program.states()) {
+    for (sctl::runtime::Id s = 0; s < program.states(); ++s) {
+      const std::string name{program.state_name(s)};
+      entries[s] = {&log, "enter " + name, "exit " + name};
+      registry.on_enter(name, {[](void *c, const void *) -> std::size_t {
+                                 auto &e = *static_cast<Entry *>(c);
+                                 e.log->push_back(e.enter);
+                                 return 0;
+                               },
+                               &entries[s]});
+      registry.on_exit(name, {[](void *c) {
+                                auto &e = *static_cast<Entry *>(c);
+                                e.log->push_back(e.exit);
+                              },
+                              &entries[s]});
+    }
+  }
+
+  sctl::runtime::Registry registry;
+  std::vector<Entry> entries;
+};
+
+struct RuntimeChart : public ::testing::Test {
+  NiceMock<Off> off;
+  NiceMock<OffInternal> off_internal;
+  NiceMock<Error> error;
+  NiceMock<On> on;
+  NiceMock<Init> init;
+  NiceMock<Ready> ready;
+  NiceMock<Busy> busy;
+  NiceMock<Config> config;
+  NiceMock<Processing> processing;
+  NiceMock<Waiting> waiting;
+
+  Log compiled_log;
+  Log runtime_log;
+
+  LoggedSC compiled{Logger{{}, &compiled_log},
+                    off,
+                    off_internal,
+                    error,
+                    on,
+                    init,
+                    ready,
+                    busy,
+                    config,
+                    processing,
+                    waiting};
+
+  template <typename... Events>
+  void expect_same_as_compiled(const sctl::runtime::Program &program) {
+    LoggingRegistry registry{program, runtime_log};
+    sctl::runtime::Machine machine{program, registry.registry};
+
+    compiled.start(true);
+    machine.start(true);
+    const auto step = [&](const auto &event) {
+      compiled.handle(event);
+      machine.handle(program.event(
+          sctl::details::type_name<std::decay_t<decltype(event)>>()));
+    };
+    step(PowerOn{});
+    step(Initialized{});
+    step(Action{});
+    step(Tick{});
+    step(Timeout{});
+    step(Configure{});
+    step(Timeout{});
+    step(Failure{});
+    step(Tick{});
+    step(PowerOn{});
+    step(PowerOff{});
+
+    EXPECT_EQ(runtime_log, compiled_log);
+    EXPECT_EQ(program.state_name(machine.current()), "OffInternal");
+  }
+};
+
+TEST_F(RuntimeChart, FollowsCompiledChart) {
+  const sctl::runtime::Program program{ComplexParser{}()};
+  expect_same_as_compiled(program);
+}
+
+TEST_F(RuntimeChart, FollowsCompiledChartReadFromPlantUML) {
+  std::ostringstream plantuml;
+  plantuml << sctl::parser::PlantUML{ComplexParser{}(), true};
+
+  const sctl::runtime::Program program{
+      sctl::parser::parse_plantuml(plantuml.str())};
+  expect_same_as_compiled(program);
+}
+
+TEST(RuntimeProgram, ResolvesInheritedHandlersAtCompileTime) {
+  const sctl::runtime::Program program{ComplexParser{}()};
+  const auto busy = program.state("Busy");
+  const auto on = program.state("On");
+
+  EXPECT_EQ(program.parent(busy), on);
+  EXPECT_NE(program.handler(on, program.event("PowerOff")),
+            sctl::runtime::none);
+  EXPECT_EQ(program.handler(busy, program.event("PowerOff")),
+            sctl::runtime::none);
+  EXPECT_EQ(program.state("Unknown"), sctl::runtime::none);
+}
+
+sctl::parser::ParseResult door() {
+  return {{{"Closed", {}, {}}, {"Opened", {}, {}}, {"Locked", {}, {}}},
+          {{"Closed", {"Opened", "Locked", "sctl::NoAction"}, "Push"},
+           {"Opened", {"Closed"}, "Push"}},
+          {"Push"}};
+}
+
+TEST(RuntimeMachine, ActionChoosesTarget) {
+  const sctl::runtime::Program program{door()};
+  sctl::runtime::Registry registry{program};
+  std::size_t choice = 1;
+  registry.on_handle("Closed", "Push",
+                     {[](void *c, const void *event) {
+                        return *static_cast<const int *>(event) +
+                               *static_cast<std::size_t *>(c);
+                      },
+                      &choice});
+
+  sctl::runtime::Machine machine{program, registry};
+  machine.start();
+  const int offset = 0;
+  EXPECT_TRUE(machine.handle(program.event("Push"), &offset));
+  EXPECT_TRUE(machine.is_active(program.state("Locked")));
+  EXPECT_FALSE(machine.handle(program.event("Push"), &offset));
+
+  machine.start();
+  choice = 2;
+  EXPECT_TRUE(machine.handle(program.event("Push"), &offset));
+  EXPECT_TRUE(machine.is_active(program.state("Closed")));
+  choice = sctl::runtime::keep;
+  EXPECT_TRUE(machine.handle(program.event("Push"), &offset));
+  EXPECT_TRUE(machine.is_active(program.state("Closed")));
+}
+
+TEST(RuntimeProgram, RejectsInvalidCharts) {
+  auto unknown = door();
+  unknown.transitions[1].to[0] = "Ajar";
+  EXPECT_THROW(sctl::runtime::Program{unknown}, std::invalid_argument);
+
+  auto cycle = door();
+  cycle.transitions.push_back({"Opened", {"Locked"}, {}});
+  cycle.transitions.push_back({"Locked", {"sctl::NoAction", "Opened"}, {}});
+  EXPECT_THROW(sctl::runtime::Program{cycle}, std::invalid_argument);
+
+  EXPECT_THROW(sctl::runtime::Program{sctl::parser::ParseResult{}},
+               std::invalid_argument);
+
+  const sctl::runtime::Program program{door()};
+  sctl::runtime::Registry registry{program};
+  EXPECT_THROW(registry.on_handle("Locked", "Push", {}),
+               std::invalid_argument);
+}
+
+} // namespace
@@ -29,6 +29,10 @@ struct StateOff {
   auto handle(const ActionTurnOn &) { return sctl::State<StateOn>{}; }
 };
 
+// Active state is kept as single byte index.
+static_assert(sizeof(sctl::details::Engine<StateOff, StateOn>::StateIndex) ==
+              1);
+
 struct SimpleFSM : public ::testing::Test {
   StateOn on;
   StateOff off;
@@ -0,0 +1,330 @@
+#include "gmock/gmock.h"
+
+#include "sctl_pool.h"
+#include "sctl_snapshot.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ Snapshot and restore
+
+```
+@startuml
+hide empty description
+
+state Running {
+  state Pump {
+    [*] --> PumpOff
+    PumpOff --> PumpOn : Prime
+  }
+  --
+  state Valve {
+    [*] --> Closed
+    Closed --> Opened : Open
+  }
+}
+
+[*] --> Idle
+Idle --> Running : Start
+Running --> Idle : Stop
+Running : Order / defer
+@enduml
+```
+
+*/
+
+namespace {
+
+struct Idle;
+struct Running;
+struct Pump;
+struct PumpOff;
+struct PumpOn;
+struct Valve;
+struct Closed;
+struct Opened;
+
+struct Start {};
+struct Stop {};
+struct Prime {};
+struct Open {};
+struct Order {
+  int id;
+};
+
+struct Entered {
+  int entered{0};
+  void enter() { ++entered; }
+};
+
+struct Idle : Entered {
+  std::vector<int> orders;
+
+  auto handle(const Start &) { return sctl::State<Running>{}; }
+  void handle(const Order &o) { orders.push_back(o.id); }
+};
+struct Running : Entered {
+  using Regions = sctl::Regions<Pump, Valve>;
+  using Deferred = sctl::Deferred<Order>;
+  auto handle(const Stop &) { return sctl::State<Idle>{}; }
+};
+struct Pump : Entered {
+  using ParentState = Running;
+  using StartState = PumpOff;
+};
+struct PumpOff : Entered {
+  using ParentState = Pump;
+  auto handle(const Prime &) { return sctl::State<PumpOn>{}; }
+};
+struct PumpOn : Entered {
+  using ParentState = Pump;
+};
+struct Valve : Entered {
+  using ParentState = Running;
+  using StartState = Closed;
+};
+struct Closed : Entered {
+  using ParentState = Valve;
+  auto handle(const Open &) { return sctl::State<Opened>{}; }
+};
+struct Opened : Entered {
+  using ParentState = Valve;
+};
+
+using PlantSC = sctl::StateChart<Idle, Running, Pump, PumpOff, PumpOn, Valve,
+                                 Closed, Opened>;
+using ReorderedSC = sctl::StateChart<Running, Idle, Pump, PumpOff, PumpOn,
+                                     Valve, Closed, Opened>;
+
+static_assert(sctl::details::type_name<Order>().ends_with("Order"));
+static_assert(PlantSC::snapshot_layout() != ReorderedSC::snapshot_layout());
+static_assert(std::is_trivially_copyable<PlantSC::Snapshot>::value);
+
+struct Plant {
+  Idle idle;
+  Running running;
+  Pump pump;
+  PumpOff pump_off;
+  PumpOn pump_on;
+  Valve valve;
+  Closed closed;
+  Opened opened;
+
+  PlantSC chart() {
+    return {idle,     running, pump,   pump_off,
+            pump_on,  valve,   closed, opened};
+  }
+
+  int entered() const {
+    return idle.entered + running.entered + pump.entered + pump_off.entered +
+           pump_on.entered + valve.entered + closed.entered + opened.entered;
+  }
+};
+
+struct Snapshot : public ::testing::Test {
+  Plant primary_plant;
+  Plant standby_plant;
+
+  PlantSC primary = primary_plant.chart();
+  PlantSC standby = standby_plant.chart();
+
+  Snapshot() {
+    primary.start();
+    primary.handle(Start{});
+    primary.handle(Prime{});
+    primary.handle(Order{1});
+    primary.handle(Order{2});
+  }
+};
+
+TEST_F(Snapshot, RestoresActiveStatesWithoutEnterActions) {
+  ASSERT_TRUE(standby.restore(primary.snapshot()));
+
+  EXPECT_TRUE(standby.is_active<PumpOn>());
+  EXPECT_TRUE(standby.is_active<Closed>());
+  EXPECT_EQ(standby_plant.entered(), 0);
+
+  standby.handle(Open{});
+  EXPECT_TRUE(standby.is_active<Opened>());
+}
+
+TEST_F(Snapshot, RestoresDeferredEvents) {
+  ASSERT_TRUE(standby.restore(primary.snapshot()));
+
+  standby.handle(Stop{});
+
+  EXPECT_THAT(standby_plant.idle.orders, ::testing::ElementsAre(1, 2));
+  EXPECT_TRUE(primary_plant.idle.orders.empty());
+}
+
+TEST_F(Snapshot, RejectsSnapshotOfOtherLayout) {
+  auto snapshot = primary.snapshot();
+  snapshot.layout = ReorderedSC::snapshot_layout();
+
+  EXPECT_FALSE(standby.restore(snapshot));
+  EXPECT_FALSE(standby.is_active<Idle>());
+  EXPECT_FALSE(standby.is_active<Running>());
+}
+
+TEST_F(Snapshot, RejectsCorruptSnapshot) {
+  standby.start();
+  auto bad_state = primary.snapshot();
+  bad_state.record.regions[1] = 100;
+  auto bad_deferred = primary.snapshot();
+  bad_deferred.record.deferred.count = 3;
+
+  EXPECT_FALSE(standby.restore(bad_state));
+  EXPECT_FALSE(standby.restore(bad_deferred));
+  EXPECT_TRUE(standby.is_active<Idle>());
+}
+
+using PlantEngine = sctl::details::Engine<Idle, Running, Pump, PumpOff,
+                                          PumpOn, Valve, Closed, Opened>;
+
+template <typename S> std::uint8_t index() {
+  return PlantEngine::index_of<S>();
+}
+
+TEST_F(Snapshot, RejectsImpossibleConfiguration) {
+  standby.start();
+  const auto with = [this](std::uint8_t current, std::uint8_t pump,
+                           std::uint8_t valve) {
+    auto snapshot = primary.snapshot();
+    snapshot.record.current = current;
+    snapshot.record.regions = {pump, valve};
+    return snapshot;
+  };
+
+  // Active state inside region.
+  EXPECT_FALSE(standby.restore(
+      with(index<PumpOn>(), index<PumpOn>(), index<Closed>())));
+  // Composite state active in region.
+  EXPECT_FALSE(standby.restore(
+      with(index<Running>(), index<Pump>(), index<Closed>())));
+  // State of other region.
+  EXPECT_FALSE(standby.restore(
+      with(index<Running>(), index<Closed>(), index<PumpOff>())));
+  // Region without active state while its owner is active.
+  EXPECT_FALSE(
+      standby.restore(with(index<Running>(), index<PumpOff>(), 0)));
+  // Region with active state while its owner is not.
+  EXPECT_FALSE(standby.restore(
+      with(index<Idle>(), index<PumpOff>(), index<Closed>())));
+  EXPECT_TRUE(standby.is_active<Idle>());
+
+  EXPECT_TRUE(standby.restore(with(index<Idle>(), 0, 0)));
+  EXPECT_TRUE(standby.restore(
+      with(index<Running>(), index<PumpOff>(), index<Opened>())));
+  EXPECT_TRUE(standby.is_active<Opened>());
+}
+
+TEST_F(Snapshot, BulkSnapshotIsRestoredInPlace) {
+  std::array<PlantSC, 3> primaries{primary_plant.chart(),
+                                   primary_plant.chart(),
+                                   primary_plant.chart()};
+  primaries[0].start();
+  primaries[2].start();
+  primaries[2].handle(Start{});
+  primaries[2].handle(Open{});
+
+  std::vector<std::byte> buffer(sctl::snapshot_buffer_size<PlantSC>(3));
+  ASSERT_EQ(sctl::write_snapshots(primaries, buffer), buffer.size());
+
+  std::array<PlantSC, 3> standbys{standby_plant.chart(),
+                                  standby_plant.chart(),
+                                  standby_plant.chart()};
+  const sctl::SnapshotView<PlantSC> view{buffer};
+  ASSERT_TRUE(view.valid());
+  ASSERT_EQ(view.size(), 3u);
+  ASSERT_TRUE(view.restore(standbys));
+
+  EXPECT_TRUE(standbys[0].is_active<Idle>());
+  EXPECT_FALSE(standbys[1].is_active<Idle>());
+  EXPECT_FALSE(standbys[1].is_active<Running>());
+  EXPECT_TRUE(standbys[2].is_active<PumpOff>());
+  EXPECT_TRUE(standbys[2].is_active<Opened>());
+  EXPECT_EQ(standby_plant.entered(), 0);
+}
+
+TEST_F(Snapshot, BulkSnapshotOfOtherLayoutIsNotValid) {
+  const std::array<PlantSC, 1> charts{primary_plant.chart()};
+  std::vector<std::byte> buffer(sctl::snapshot_buffer_size<PlantSC>(1));
+  ASSERT_NE(sctl::write_snapshots(charts, buffer), 0u);
+
+  EXPECT_FALSE(sctl::SnapshotView<ReorderedSC>{buffer}.valid());
+  EXPECT_FALSE(sctl::SnapshotView<PlantSC>{
+      std::span<const std::byte>{buffer}.first(buffer.size() - 1)}
+                   .valid());
+  EXPECT_EQ(sctl::write_snapshots(
+                charts, std::span<std::byte>{buffer}.first(buffer.size() - 1)),
+            0u);
+}
+
+struct Off;
+struct On;
+struct Toggle {};
+struct Off {
+  auto handle(const Toggle &) { return sctl::State<On>{}; }
+};
+struct On {
+  int entered{0};
+  void enter() { ++entered; }
+  auto handle(const Toggle &) { return sctl::State<Off>{}; }
+};
+
+using SwitchPool = sctl::StateChartPool<Off, On>;
+
+TEST(StateChartPoolSnapshot, RestoresActiveStatesOfAllInstances) {
+  SwitchPool primary{4};
+  primary.start();
+  primary.handle(1, Toggle{});
+  primary.handle(3, Toggle{});
+
+  std::vector<std::byte> buffer(primary.snapshot_size());
+  ASSERT_EQ(primary.snapshot(buffer), buffer.size());
+
+  SwitchPool standby{4};
+  ASSERT_TRUE(standby.restore(buffer));
+  EXPECT_TRUE(standby.is_active<Off>(0));
+  EXPECT_TRUE(standby.is_active<On>(1));
+  EXPECT_TRUE(standby.is_active<Off>(2));
+  EXPECT_TRUE(standby.is_active<On>(3));
+  EXPECT_EQ(standby.state<On>(1).entered, 0);
+
+  SwitchPool smaller{3};
+  EXPECT_FALSE(smaller.restore(buffer));
+}
+
+struct Group;
+struct Member {
+  using ParentState = Group;
+};
+struct Group {
+  using StartState = Member;
+};
+
+using GroupPool = sctl::StateChartPool<Off, On, Group, Member>;
+
+TEST(StateChartPoolSnapshot, RejectsCompositeActiveState) {
+  GroupPool primary{2};
+  primary.start();
+
+  std::vector<std::byte> buffer(primary.snapshot_size());
+  ASSERT_EQ(primary.snapshot(buffer), buffer.size());
+  buffer[sizeof(sctl::SnapshotHeader) + 1] = std::byte{
+      sctl::details::Engine<Off, On, Group, Member>::index_of<Group>()};
+
+  GroupPool standby{2};
+  EXPECT_FALSE(standby.restore(buffer));
+  EXPECT_FALSE(standby.is_active<Off>(0));
+
+  buffer[sizeof(sctl::SnapshotHeader) + 1] = std::byte{
+      sctl::details::Engine<Off, On, Group, Member>::index_of<Member>()};
+  EXPECT_TRUE(standby.restore(buffer));
+  EXPECT_TRUE(standby.is_active<Group>(1));
+}
+
+} // namespace
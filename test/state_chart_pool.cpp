@@ -0,0 +1,166 @@
+#include "gmock/gmock.h"
+
+#include "sctl_pool.h"
+
+#include <vector>
+
+/*
+ State chart pool
+
+```
+@startuml
+hide empty description
+
+state Online {
+  [*] --> Connecting
+  Connecting --> Connected : Established
+  Connected --> Idle : Close
+}
+
+[*] --> Idle
+Idle --> Online : Connect
+Online --> Idle : Reset
+@enduml
+```
+
+*/
+
+struct Connect {};
+struct Established {};
+struct Data {};
+struct Close {};
+struct Reset {};
+
+struct Idle;
+struct Online;
+struct Connecting;
+struct Connected;
+
+struct Idle {
+  constexpr auto handle(const Connect &) { return sctl::State<Online>{}; }
+};
+struct Online {
+  using StartState = Connecting;
+  constexpr auto handle(const Reset &) { return sctl::State<Idle>{}; }
+};
+struct Connecting {
+  using ParentState = Online;
+  constexpr auto handle(const Established &) {
+    return sctl::State<Connected>{};
+  }
+};
+struct Connected {
+  using ParentState = Online;
+  int received{0};
+  int exited{0};
+
+  void exit() { ++exited; }
+  void handle(const Data &) { ++received; }
+  auto handle(const Close &) { return sctl::State<Idle>{}; }
+};
+
+using Pool = sctl::StateChartPool<Idle, Online, Connecting, Connected>;
+
+using Engine = sctl::details::Engine<Idle, Online, Connecting, Connected>;
+static_assert(Engine::static_destination<Idle, Connect>() ==
+              Engine::index_of<Connecting>());
+static_assert(Engine::static_destination<Connecting, Reset>() ==
+              Engine::index_of<Idle>());
+static_assert(Engine::static_destination<Connected, Reset>() ==
+              Engine::table_stride);
+static_assert(Engine::static_destination<Connected, Close>() ==
+              Engine::table_stride);
+
+struct StateChartPoolTest : public ::testing::Test {
+  Pool pool{100};
+
+  StateChartPoolTest() { pool.start(); }
+
+  std::vector<Pool::Id> connected() {
+    std::vector<Pool::Id> ids;
+    for (Pool::Id id = 0; id < pool.size(); ++id) {
+      if (pool.is_active<Connected>(id)) {
+        ids.push_back(id);
+      }
+    }
+    return ids;
+  }
+};
+
+TEST_F(StateChartPoolTest, StartsInFirstState) {
+  for (Pool::Id id = 0; id < pool.size(); ++id) {
+    EXPECT_TRUE(pool.is_active<Idle>(id));
+  }
+}
+
+TEST_F(StateChartPoolTest, BroadcastResolvesStartState) {
+  pool.broadcast(Connect{});
+
+  for (Pool::Id id = 0; id < pool.size(); ++id) {
+    EXPECT_TRUE(pool.is_active<Online>(id));
+    EXPECT_TRUE(pool.is_active<Connecting>(id));
+  }
+}
+
+TEST_F(StateChartPoolTest, HandleSelectedInstances) {
+  pool.broadcast(Connect{});
+
+  const std::vector<Pool::Id> ids{3, 7, 42};
+  pool.handle(std::span{ids}, Established{});
+
+  EXPECT_EQ(connected(), ids);
+}
+
+TEST_F(StateChartPoolTest, StateDataIsKeptPerInstance) {
+  pool.broadcast(Connect{});
+  pool.broadcast(Established{});
+
+  pool.handle(5, Data{});
+  pool.handle(5, Data{});
+  pool.handle(6, Data{});
+
+  EXPECT_EQ(pool.state<Connected>(5).received, 2);
+  EXPECT_EQ(pool.state<Connected>(6).received, 1);
+  EXPECT_EQ(pool.state<Connected>(7).received, 0);
+}
+
+TEST(StateChartPool, InstanceTakesActiveStateByteAndDataOfStates) {
+  Pool empty{0};
+  Pool pool{1000};
+
+  // Active states are single byte per instance.
+  EXPECT_EQ(pool.snapshot_size() - empty.snapshot_size(), 1000u);
+  // States without data are one object for all instances, states with data
+  // one dense column.
+  EXPECT_EQ(&pool.state<Idle>(0), &pool.state<Idle>(999));
+  EXPECT_EQ(&pool.state<Connected>(999) - &pool.state<Connected>(0), 999);
+}
+
+TEST_F(StateChartPoolTest, BroadcastToInstancesInDifferentStates) {
+  pool.broadcast(Connect{});
+  const std::vector<Pool::Id> ids{1, 2};
+  pool.handle(std::span{ids}, Established{});
+
+  pool.broadcast(Reset{});
+
+  for (Pool::Id id = 0; id < pool.size(); ++id) {
+    EXPECT_TRUE(pool.is_active<Idle>(id));
+  }
+  EXPECT_EQ(pool.state<Connected>(1).exited, 1);
+  EXPECT_EQ(pool.state<Connected>(2).exited, 1);
+  EXPECT_EQ(pool.state<Connected>(3).exited, 0);
+}
+
+TEST_F(StateChartPoolTest, HandleInstancesInDifferentStates) {
+  pool.broadcast(Connect{});
+  const std::vector<Pool::Id> connected_ids{10, 11};
+  pool.handle(std::span{connected_ids}, Established{});
+
+  const std::vector<Pool::Id> ids{9, 10, 11, 12};
+  pool.handle(std::span{ids}, Close{});
+
+  EXPECT_TRUE(pool.is_active<Connecting>(9));
+  EXPECT_TRUE(pool.is_active<Idle>(10));
+  EXPECT_TRUE(pool.is_active<Idle>(11));
+  EXPECT_TRUE(pool.is_active<Connecting>(12));
+}
@@ -0,0 +1,283 @@
+#include "gmock/gmock.h"
+
+#include "sctl_parser.h"
+#include "sctl_task.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+ Asynchronous actions
+
+```
+@startuml
+hide empty description
+
+[*] --> Idle
+Idle --> Opened : Open (after device opened)
+Idle --> Idle : Probe (completes at once)
+Opened --> Flushing : Close
+Flushing --> Idle : (after buffers flushed)
+Opened : Send
+@enduml
+```
+
+*/
+
+namespace {
+
+struct Idle;
+struct Opened;
+struct Flushing;
+
+struct Open {};
+struct Close {};
+struct Probe {};
+struct Send {
+  int id;
+};
+
+struct Device {
+  sctl::RunLoop &loop;
+  std::vector<std::string> log{};
+
+  sctl::Task<int> read() {
+    co_await loop.schedule();
+    log.push_back("read");
+    co_return 42;
+  }
+};
+
+struct Idle {
+  Device &device;
+
+  sctl::Task<sctl::State<Opened>> handle(const Open &) {
+    device.log.push_back("opening");
+    co_await device.loop.schedule();
+    const int id = co_await device.read();
+    device.log.push_back("opened " + std::to_string(id));
+    co_return sctl::State<Opened>{};
+  }
+  sctl::Task<> handle(const Probe &) {
+    device.log.push_back("probe");
+    co_return;
+  }
+};
+struct Opened {
+  Device &device;
+
+  void handle(const Send &s) {
+    device.log.push_back("send " + std::to_string(s.id));
+  }
+  auto handle(const Close &) { return sctl::State<Flushing>{}; }
+};
+struct Flushing {
+  Device &device;
+
+  sctl::Task<std::variant<sctl::State<Idle>, sctl::KeepState>> enter() {
+    co_await device.loop.schedule();
+    device.log.push_back("flushed");
+    co_return sctl::State<Idle>{};
+  }
+};
+
+using AsyncSC = sctl::StateChart<sctl::Async<>, Idle, Opened, Flushing>;
+
+static_assert(AsyncSC::max_enter_redirects == 1);
+
+struct AsyncStateChart : public ::testing::Test {
+  sctl::RunLoop loop;
+  Device device{loop};
+  Idle idle{device};
+  Opened opened{device};
+  Flushing flushing{device};
+
+  AsyncSC instance{idle, opened, flushing};
+
+  AsyncStateChart() { instance.start(); }
+};
+
+TEST_F(AsyncStateChart, TransitionWaitsForTask) {
+  instance.handle(Open{});
+
+  EXPECT_TRUE(instance.is_active<Idle>());
+  EXPECT_THAT(device.log, ::testing::ElementsAre("opening"));
+
+  loop.run();
+
+  EXPECT_TRUE(instance.is_active<Opened>());
+  EXPECT_THAT(device.log,
+              ::testing::ElementsAre("opening", "read", "opened 42"));
+}
+
+TEST_F(AsyncStateChart, EventsAreQueuedWhileTaskIsPending) {
+  instance.handle(Open{});
+  instance.handle(Send{1});
+  instance.handle(std::variant<Send, Close>{Send{2}});
+
+  loop.run();
+
+  EXPECT_THAT(device.log,
+              ::testing::ElementsAre("opening", "read", "opened 42", "send 1",
+                                     "send 2"));
+}
+
+TEST_F(AsyncStateChart, TaskCompletingAtOnceDoesNotSuspend) {
+  instance.handle(Probe{});
+  instance.handle(Open{});
+
+  EXPECT_THAT(device.log, ::testing::ElementsAre("probe", "opening"));
+}
+
+TEST_F(AsyncStateChart, EnterTaskRedirectsWhenCompleted) {
+  instance.handle(Open{});
+  loop.run();
+
+  instance.handle(Close{});
+  instance.handle(Open{});
+  EXPECT_TRUE(instance.is_active<Flushing>());
+
+  loop.run();
+
+  EXPECT_TRUE(instance.is_active<Opened>());
+  EXPECT_THAT(device.log,
+              ::testing::ElementsAre("opening", "read", "opened 42", "flushed",
+                                     "opening", "read", "opened 42"));
+}
+
+TEST_F(AsyncStateChart, OneLoopDrivesManyCharts) {
+  Device other_device{loop};
+  Idle other_idle{other_device};
+  Opened other_opened{other_device};
+  Flushing other_flushing{other_device};
+  AsyncSC other{other_idle, other_opened, other_flushing};
+  other.start();
+
+  instance.handle(Open{});
+  other.handle(Open{});
+  loop.run();
+
+  EXPECT_TRUE(instance.is_active<Opened>());
+  EXPECT_TRUE(other.is_active<Opened>());
+}
+
+TEST_F(AsyncStateChart, PendingTaskIsDestroyedWithChart) {
+  {
+    AsyncSC chart{idle, opened, flushing};
+    chart.start();
+    chart.handle(Open{});
+    chart.handle(Send{1});
+  }
+  // Coroutine posted to loop was destroyed with chart and taken back.
+  EXPECT_EQ(loop.run(), 0u);
+  EXPECT_THAT(device.log, ::testing::ElementsAre("opening"));
+}
+
+struct Queued;
+struct Draining;
+struct Queued {
+  Device &device;
+  using Deferred = sctl::Deferred<Send>;
+
+  sctl::Task<sctl::State<Draining>> handle(const Close &) {
+    co_await device.loop.schedule();
+    co_return sctl::State<Draining>{};
+  }
+};
+struct Draining {
+  Device &device;
+
+  void handle(const Send &s) {
+    device.log.push_back("send " + std::to_string(s.id));
+  }
+};
+
+TEST(Task, DeferredEventsAreRecalledAfterTaskCompleted) {
+  sctl::RunLoop loop;
+  Device device{loop};
+  Queued queued{device};
+  Draining draining{device};
+  sctl::StateChart<sctl::Async<>, Queued, Draining> chart{queued, draining};
+  chart.start();
+
+  chart.handle(Send{1});
+  chart.handle(Close{});
+  EXPECT_TRUE(device.log.empty());
+
+  loop.run();
+
+  EXPECT_TRUE(chart.is_active<Draining>());
+  EXPECT_THAT(device.log, ::testing::ElementsAre("send 1"));
+}
+
+struct Named {
+  std::string name;
+};
+struct Naming {
+  Device &device;
+
+  sctl::Task<> handle(const Named &n) {
+    co_await device.loop.schedule();
+    device.log.push_back("named " + n.name);
+  }
+};
+
+TEST(Task, EventOutlivesSuspendedHandler) {
+  sctl::RunLoop loop;
+  Device device{loop};
+  Naming naming{device};
+  sctl::StateChart<sctl::Async<>, Naming> chart{naming};
+  chart.start();
+
+  chart.handle(Named{std::string(64, 'x')});
+  loop.run();
+
+  EXPECT_THAT(device.log,
+              ::testing::ElementsAre("named " + std::string(64, 'x')));
+}
+
+TEST(Task, AwaitedTaskPassesException) {
+  const auto failing = []() -> sctl::Task<int> {
+    throw std::runtime_error{"failed"};
+    co_return 0;
+  };
+  std::string error;
+  const auto awaiting = [&]() -> sctl::Task<> {
+    try {
+      co_await failing();
+    } catch (const std::runtime_error &e) {
+      error = e.what();
+    }
+  };
+
+  auto task = awaiting();
+  EXPECT_TRUE(task.start(nullptr, nullptr));
+  EXPECT_EQ(error, "failed");
+}
+
+struct Waiting;
+struct Done;
+struct Waiting {
+  sctl::Task<sctl::State<Done>> handle(const Open &);
+};
+struct Done {
+  sctl::Task<std::variant<sctl::State<Waiting>, sctl::KeepState>> enter();
+  sctl::Task<> handle(const Probe &);
+};
+
+TEST(Task, ParserFollowsTaskResults) {
+  sctl::parser::Parser<sctl::StateChart<sctl::Async<>, Waiting, Done>, Open,
+                       Probe>
+      parser;
+  const auto result = parser();
+
+  ASSERT_EQ(result.transitions.size(), 2u);
+  EXPECT_THAT(result.transitions[0].to,
+              ::testing::ElementsAre(::testing::HasSubstr("Done")));
+  EXPECT_THAT(result.transitions[1].to,
+              ::testing::ElementsAre(::testing::HasSubstr("Waiting"),
+                                     ::testing::HasSubstr("NoAction")));
+}
+
+} // namespace
@@ -0,0 +1,242 @@
+#include "gmock/gmock.h"
+
+#include "sctl_timer.h"
+
+#include <vector>
+
+/*
+ Timers
+
+```
+@startuml
+hide empty description
+
+state Link {
+  [*] --> Connecting
+  Connecting --> Connected : Up
+  Connected --> Connecting : Lost
+}
+
+[*] --> Link
+Connecting --> Failed : ConnectTimeout (after 10)
+Connected --> Connected : KeepAlive (after 3)
+Link --> Idle : Timeout (after 100)
+Failed --> Link : Retry
+@enduml
+```
+
+*/
+
+namespace {
+
+struct Link;
+struct Connecting;
+struct Connected;
+struct Failed;
+
+struct ConnectTimeout {};
+struct KeepAlive {};
+struct Timeout {};
+struct Up {};
+struct Lost {};
+struct Retry {};
+
+struct Link {
+  using StartState = Connecting;
+  using Timers = sctl::Timers<sctl::After<100, Timeout>>;
+  int timeouts{0};
+  void handle(const Timeout &) { ++timeouts; }
+};
+struct Connecting {
+  using ParentState = Link;
+  using Timers = sctl::Timers<sctl::After<10, ConnectTimeout>>;
+  auto handle(const Up &) { return sctl::State<Connected>{}; }
+  auto handle(const ConnectTimeout &) { return sctl::State<Failed>{}; }
+};
+struct Connected {
+  using ParentState = Link;
+  using Timers = sctl::Timers<sctl::After<3, KeepAlive>>;
+  int keep_alives{0};
+  auto handle(const KeepAlive &) {
+    ++keep_alives;
+    return sctl::State<Connected>{};
+  }
+  auto handle(const Lost &) { return sctl::State<Connecting>{}; }
+};
+struct Failed {
+  auto handle(const Retry &) { return sctl::State<Link>{}; }
+};
+
+using Timed = sctl::TimerObserver<ConnectTimeout, KeepAlive, Timeout>;
+using TimedSC = sctl::StateChart<sctl::WithObserver<Timed>, Link, Connecting,
+                                 Connected, Failed>;
+
+struct TimedInstance {
+  Link link;
+  Connecting connecting;
+  Connected connected;
+  Failed failed;
+
+  TimedSC chart;
+
+  TimedInstance(sctl::TimerWheel &wheel)
+      : chart{Timed{wheel}, link, connecting, connected, failed} {
+    chart.observer().bind(chart);
+    chart.start(true);
+  }
+};
+
+struct TimedStateChart : public ::testing::Test {
+  sctl::TimerWheel wheel;
+  TimedInstance instance{wheel};
+  TimedSC &chart = instance.chart;
+};
+
+TEST_F(TimedStateChart, TimeoutFiresWhenStateStaysActive) {
+  wheel.advance_to(9);
+  EXPECT_TRUE(chart.is_active<Connecting>());
+
+  wheel.advance_to(10);
+  EXPECT_TRUE(chart.is_active<Failed>());
+}
+
+TEST_F(TimedStateChart, ExitCancelsTimersOfExitedStates) {
+  chart.handle(Up{});
+  chart.handle(Lost{});
+  chart.handle(Up{});
+
+  wheel.advance_to(99);
+  EXPECT_TRUE(chart.is_active<Connected>());
+  EXPECT_EQ(instance.link.timeouts, 0);
+  EXPECT_EQ(instance.connected.keep_alives, 33);
+}
+
+TEST_F(TimedStateChart, ParentTimerKeepsRunningAcrossSubstates) {
+  chart.handle(Up{});
+
+  wheel.advance_to(100);
+
+  EXPECT_EQ(instance.link.timeouts, 1);
+  EXPECT_TRUE(chart.is_active<Connected>());
+}
+
+TEST_F(TimedStateChart, SelfTransitionRearmsTimer) {
+  chart.handle(Up{});
+  wheel.advance_to(2);
+  chart.handle(KeepAlive{});
+
+  wheel.advance_to(4);
+  EXPECT_EQ(instance.connected.keep_alives, 1);
+
+  wheel.advance_to(5);
+  EXPECT_EQ(instance.connected.keep_alives, 2);
+}
+
+TEST_F(TimedStateChart, OneWheelServesManyCharts) {
+  TimedInstance other{wheel};
+  wheel.advance_to(5);
+  other.chart.handle(Up{});
+
+  wheel.advance_to(10);
+
+  EXPECT_TRUE(chart.is_active<Failed>());
+  EXPECT_TRUE(other.chart.is_active<Connected>());
+  EXPECT_EQ(other.connected.keep_alives, 1);
+}
+
+struct Entered : sctl::NoObserver {
+  int entered{0};
+  template <typename S> void on_enter(std::size_t) { ++entered; }
+};
+
+TEST(TimerObserver, RunsInCompositeObserver) {
+  sctl::TimerWheel wheel;
+  Link link;
+  Connecting connecting;
+  Connected connected;
+  Failed failed;
+  using Both = sctl::CompositeObserver<Timed, Entered>;
+  sctl::StateChart<sctl::WithObserver<Both>, Link, Connecting, Connected,
+                   Failed>
+      chart{Both{Timed{wheel}, Entered{}}, link, connecting, connected,
+            failed};
+  chart.observer().get<Timed>().bind(chart);
+  chart.start(true);
+
+  wheel.advance_to(10);
+
+  EXPECT_TRUE(chart.is_active<Failed>());
+  EXPECT_EQ(chart.observer().get<Entered>().entered, 3);
+}
+
+struct Holder {
+  Timed timed;
+  int timeouts{0};
+
+  template <typename Event> void handle(const Event &) { ++timeouts; }
+};
+
+TEST(TimerObserver, MovedObserverTakesOverArmedTimers) {
+  sctl::TimerWheel wheel;
+  Holder from{Timed{wheel}};
+  from.timed.bind(from);
+  from.timed.on_enter<Connecting>(1);
+
+  Holder moved{std::move(from)};
+  wheel.advance_to(10);
+
+  EXPECT_EQ(from.timeouts, 0);
+  EXPECT_EQ(moved.timeouts, 1);
+}
+
+struct Fired : sctl::TimerWheel::Timer {
+  std::vector<std::uint64_t> *log;
+  const sctl::TimerWheel *wheel;
+
+  Fired(std::vector<std::uint64_t> &l, const sctl::TimerWheel &w)
+      : log{&l}, wheel{&w} {
+    fire = [](sctl::TimerWheel::Timer &t) {
+      auto &f = static_cast<Fired &>(t);
+      f.log->push_back(f.wheel->now());
+    };
+  }
+};
+
+TEST(TimerWheel, FiresOnTimeOnEveryLevel) {
+  sctl::TimerWheel wheel{5};
+  std::vector<std::uint64_t> log;
+  Fired a{log, wheel}, b{log, wheel}, c{log, wheel}, d{log, wheel},
+      e{log, wheel};
+
+  wheel.arm(e, sctl::TimerWheel::max_delay + 1000);
+  wheel.arm(d, 300'000);
+  wheel.arm(c, 4096);
+  wheel.arm(b, 64);
+  wheel.arm(a, 0);
+
+  wheel.advance_to(sctl::TimerWheel::max_delay + 2000);
+
+  EXPECT_THAT(log, ::testing::ElementsAre(
+                       6, 69, 4101, 300'005,
+                       5 + sctl::TimerWheel::max_delay + 1000));
+}
+
+TEST(TimerWheel, CancelledAndRearmedTimers) {
+  sctl::TimerWheel wheel;
+  std::vector<std::uint64_t> log;
+  Fired a{log, wheel}, b{log, wheel};
+
+  wheel.arm(a, 10);
+  wheel.arm(b, 200);
+  wheel.advance_to(5);
+  sctl::TimerWheel::cancel(a);
+  wheel.arm(b, 20);
+  EXPECT_FALSE(a.armed());
+
+  wheel.advance_to(1000);
+
+  EXPECT_THAT(log, ::testing::ElementsAre(25));
+  EXPECT_FALSE(b.armed());
+}
+
+} // namespace
@@ -0,0 +1,143 @@
+#include "gmock/gmock.h"
+
+#include "sctl_wire.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*
+ Wire events
+
+ pump takes Speed while Running, Halt stops it, Start has no wire id member
+ and gets one from WireId specialization
+
+*/
+
+namespace {
+
+struct Start {};
+struct Speed {
+  static constexpr std::uint32_t wire_id = 20;
+  std::uint32_t rpm;
+  double limit;
+};
+struct Halt {
+  static constexpr std::uint32_t wire_id = 3;
+  std::uint16_t reason;
+};
+// Trivially copyable, but only by assignment, so not implicit-lifetime type.
+struct Trim {
+  static constexpr std::uint32_t wire_id = 5;
+  Trim() {}
+  explicit Trim(std::int32_t o) : offset{o} {}
+  Trim(const Trim &) = delete;
+  Trim &operator=(const Trim &) = default;
+  std::int32_t offset{0};
+};
+
+static_assert(std::is_trivially_copyable<Trim>::value);
+static_assert(!sctl::details::ImplicitLifetime<Trim>);
+static_assert(sctl::details::ImplicitLifetime<Speed>);
+
+} // namespace
+
+template <> struct sctl::WireId<Start> {
+  static constexpr std::uint32_t value = 10;
+};
+
+namespace {
+
+struct Stopped;
+struct Running;
+
+struct Stopped {
+  auto handle(const Start &) { return sctl::State<Running>{}; }
+};
+struct Running {
+  const Speed *last{nullptr};
+  std::uint32_t rpm{0};
+  std::uint16_t reason{0};
+  const Trim *trim{nullptr};
+  std::int32_t offset{0};
+
+  void handle(const Speed &s) {
+    last = &s;
+    rpm = s.rpm;
+  }
+  void handle(const Trim &t) {
+    trim = &t;
+    offset = t.offset;
+  }
+  auto handle(const Halt &h) {
+    reason = h.reason;
+    return sctl::State<Stopped>{};
+  }
+};
+
+using PumpSC = sctl::StateChart<Stopped, Running>;
+using Wire = sctl::WireEvents<Speed, Halt, Start>;
+
+struct WireEvents : public ::testing::Test {
+  Stopped stopped;
+  Running running;
+  PumpSC chart{stopped, running};
+
+  WireEvents() { chart.start(); }
+};
+
+TEST_F(WireEvents, HandlesEventInPlace) {
+  ASSERT_TRUE(chart.handle_raw<Wire>(10, {}));
+  ASSERT_TRUE(chart.is_active<Running>());
+
+  const Speed speed{1200, 0.5};
+  const auto bytes = Wire::bytes(speed);
+  EXPECT_TRUE(chart.handle_raw<Wire>(20, bytes));
+
+  EXPECT_EQ(running.rpm, 1200u);
+  EXPECT_EQ(static_cast<const void *>(running.last),
+            static_cast<const void *>(bytes.data()));
+}
+
+TEST_F(WireEvents, CopiesMisalignedEvent) {
+  chart.handle(Start{});
+
+  alignas(Speed) std::array<std::byte, sizeof(Speed) + 1> buffer{};
+  const Speed speed{900, 1.5};
+  std::memcpy(buffer.data() + 1, &speed, sizeof(speed));
+
+  EXPECT_TRUE(chart.handle_raw<Wire>(
+      20, std::span<const std::byte>{buffer}.subspan(1)));
+  EXPECT_EQ(running.rpm, 900u);
+}
+
+TEST_F(WireEvents, CopiesEventThatIsNotImplicitLifetime) {
+  chart.handle(Start{});
+
+  const Trim trim{-3};
+  const auto bytes = sctl::WireEvents<Trim>::bytes(trim);
+  EXPECT_TRUE(chart.handle_raw<sctl::WireEvents<Trim>>(5, bytes));
+
+  EXPECT_EQ(running.offset, -3);
+  EXPECT_NE(static_cast<const void *>(running.trim),
+            static_cast<const void *>(bytes.data()));
+}
+
+TEST_F(WireEvents, RejectsUnknownIdAndWrongSize) {
+  chart.handle(Start{});
+  const Halt halt{7};
+  const auto bytes = Wire::bytes(halt);
+
+  EXPECT_FALSE(chart.handle_raw<Wire>(4, bytes));
+  EXPECT_FALSE(chart.handle_raw<Wire>(3, bytes.first(1)));
+  EXPECT_FALSE(chart.handle_raw<Wire>(20, bytes));
+  EXPECT_TRUE(chart.is_active<Running>());
+
+  EXPECT_TRUE(chart.handle_raw<Wire>(3, bytes));
+  EXPECT_TRUE(chart.is_active<Stopped>());
+  EXPECT_EQ(running.reason, 7);
+}
+
+} // namespace